@@ -0,0 +1,1106 @@
+#include "LibraryStorage.h"
+#include "Item.h"
+#include "ItemArena.h"
+#include "StringPool.h"
+#include "ReportWriter.h"
+#include "CommandProcessor.h"
+#include "InventoryAudit.h"
+#include "ThreadPool.h"
+#include "DueDate.h"
+#include "ConcurrentLibraryStorage.h"
+#include "CompactItemStore.h"
+#include "Snapshot.h"
+#include "CatalogLoader.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <deque>
+#include <filesystem>
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <new>
+#include <random>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+#include <unistd.h>
+
+using namespace std;
+
+/*
+ * File: Benchmark.cpp
+ * -------------------
+ * LibraryCheckout_bench: microbenchmarks for LibraryStorage on synthetic
+ * catalogs of 10^3 up to --max items (default 10^6; 10^7 needs several GB).
+ *
+ *   LibraryCheckout_bench [--min <n>] [--max <n>] [--ops <n>] [--seed <n>]
+ *                         [--filter <text>] [--json <file | ->]
+ *
+ * Each size gets a freshly generated catalog of Books, Movies and
+ * Magazines with realistic string lengths, drawn from a seeded generator so
+ * runs are comparable. Single operations (addItem, checkoutItem, ...) are
+ * timed one call at a time, at most --ops calls per size (default 10^6),
+ * and reported as mean ns/op with percentiles. Bulk operations (scans,
+ * print paths, reports, audits) are repeated and reported per item.
+ *
+ * Every global operator new in the process is counted, so each result
+ * also carries heap allocations and bytes per op. Timings include one
+ * steady_clock read per op; its cost is reported as timer_overhead_ns.
+ *
+ * The table goes to stdout; --json writes the same results in a stable
+ * machine-readable form for tracking regressions between releases.
+ *
+ * Data Table (identifier | datatype | use)
+ * ----------------------------------------------------------------------
+ * allocCount       | std::atomic<uint64_t>    | Calls of operator new so far
+ * allocBytes       | std::atomic<uint64_t>    | Bytes requested from operator new so far
+ * Options          | struct                   | Command-line settings
+ * CatalogGenerator | class                    | Seeded synthetic items
+ * Result           | struct                   | One benchmark at one size
+ * results          | std::deque<Result>       | Everything measured, in run order
+ * Recorder         | class                    | Per-op samples and allocation deltas
+ * NullBuffer       | class                    | streambuf that counts and drops bytes
+ *
+ */
+
+// ===== allocation counting =====
+
+static atomic<uint64_t> allocCount{0};
+static atomic<uint64_t> allocBytes{0};
+
+static void *countedAlloc(size_t n, size_t align) {
+    allocCount.fetch_add(1, memory_order_relaxed);
+    allocBytes.fetch_add(n, memory_order_relaxed);
+    if (n == 0) n = 1;
+    void *p = align > alignof(max_align_t) ? aligned_alloc(align, (n + align - 1) / align * align)
+                                           : malloc(n);
+    if (!p) throw bad_alloc();
+    return p;
+}
+
+void *operator new(size_t n) { return countedAlloc(n, 0); }
+void *operator new[](size_t n) { return countedAlloc(n, 0); }
+void *operator new(size_t n, align_val_t a) { return countedAlloc(n, static_cast<size_t>(a)); }
+void *operator new[](size_t n, align_val_t a) { return countedAlloc(n, static_cast<size_t>(a)); }
+void operator delete(void *p) noexcept { free(p); }
+void operator delete[](void *p) noexcept { free(p); }
+void operator delete(void *p, size_t) noexcept { free(p); }
+void operator delete[](void *p, size_t) noexcept { free(p); }
+void operator delete(void *p, align_val_t) noexcept { free(p); }
+void operator delete[](void *p, align_val_t) noexcept { free(p); }
+void operator delete(void *p, size_t, align_val_t) noexcept { free(p); }
+void operator delete[](void *p, size_t, align_val_t) noexcept { free(p); }
+
+namespace {
+
+// ===== options =====
+
+struct Options {
+    size_t minItems = 1000;
+    size_t maxItems = 1000000;
+    size_t maxOps = 1000000;
+    uint64_t seed = 42;
+    string filter;
+    string jsonPath;
+};
+
+bool parseOptions(int argc, char *argv[], Options &opt) {
+    for (int i = 1; i < argc; ++i) {
+        string arg = argv[i];
+        if (i + 1 >= argc) {
+            cerr << "Missing value for " << arg << "\n";
+            return false;
+        }
+        string value = argv[++i];
+        char *end = nullptr;
+        unsigned long long n = strtoull(value.c_str(), &end, 10);
+        bool numeric = !value.empty() && *end == '\0';
+        if (arg == "--min" && numeric && n > 0) {
+            opt.minItems = n;
+        } else if (arg == "--max" && numeric && n > 0) {
+            opt.maxItems = n;
+        } else if (arg == "--ops" && numeric && n > 0) {
+            opt.maxOps = n;
+        } else if (arg == "--seed" && numeric) {
+            opt.seed = n;
+        } else if (arg == "--filter") {
+            opt.filter = value;
+        } else if (arg == "--json") {
+            opt.jsonPath = value;
+        } else {
+            cerr << "Bad option: " << arg << " " << value << "\n";
+            return false;
+        }
+    }
+    return true;
+}
+
+// ===== synthetic catalog =====
+
+// Items whose strings are built from a fixed syllable list, with lengths
+// in the ranges real catalog records have: names and titles of a few
+// words, descriptions of a sentence or two, and people drawn from pools
+// so that authors, directors and actors repeat the way they do in a real
+// collection.
+class CatalogGenerator {
+    mt19937_64 rng;
+    vector<string> authors;
+    vector<string> directors;
+    vector<string> actors;
+
+    size_t uniform(size_t lo, size_t hi) {
+        return lo + static_cast<size_t>(rng() % (hi - lo + 1));
+    }
+
+    string word() {
+        static const char *const syllables[] = {
+            "ka", "lo", "mer", "th", "an", "ri", "son", "el", "vu", "dor", "is", "pe",
+            "gra", "no", "ul", "tes", "bri", "am", "co", "len", "fi", "ar", "que", "st"};
+        string w;
+        size_t n = uniform(1, 4);
+        for (size_t i = 0; i < n; ++i) w += syllables[rng() % size(syllables)];
+        return w;
+    }
+
+    string text(size_t minLen, size_t maxLen) {
+        size_t target = uniform(minLen, maxLen);
+        string t = word();
+        t[0] = static_cast<char>(t[0] - 'a' + 'A');
+        while (t.size() < target) {
+            t += ' ';
+            t += word();
+        }
+        return t;
+    }
+
+    string person() { return text(6, 12) + " " + text(5, 14); }
+
+public:
+    // people: size of each person pool.
+    CatalogGenerator(uint64_t seed, size_t people) : rng(seed) {
+        for (size_t i = 0; i < people; ++i) {
+            authors.push_back(person());
+            directors.push_back(person());
+            actors.push_back(person());
+        }
+    }
+
+    unique_ptr<Item> make(int id) {
+        string name = text(8, 40);
+        string description = text(40, 200);
+        switch (id % 3) {
+            case 0:
+                return make_unique<Book>(name, description, id, text(8, 60),
+                                         authors[rng() % authors.size()],
+                                         to_string(uniform(1900, 2025)));
+            case 1: {
+                vector<string> cast(uniform(2, 6));
+                for (string &a : cast) a = actors[rng() % actors.size()];
+                return make_unique<Movie>(name, description, id, text(8, 60),
+                                          directors[rng() % directors.size()], cast);
+            }
+            default:
+                return make_unique<Magazine>(name, description, id,
+                                             "Vol. " + to_string(uniform(1, 120)), text(20, 80));
+        }
+    }
+
+    size_t pick(size_t n) { return static_cast<size_t>(rng() % n); }
+    mt19937_64 &engine() { return rng; }
+};
+
+// ===== results =====
+
+struct Result {
+    string name;
+    size_t items = 0;  // library size
+    size_t ops = 0;    // timed operations (items, for bulk results)
+    double nsPerOp = 0;
+    double p50 = 0, p90 = 0, p99 = 0, p999 = 0, max = 0;
+    double allocsPerOp = 0;
+    double bytesPerOp = 0;
+    vector<pair<string, double>> metrics;  // extra figures, e.g. MB/s
+};
+
+deque<Result> results;  // a deque, so references to earlier results stay valid
+const Options *options = nullptr;
+
+bool selected(const string &name) {
+    return options->filter.empty() || name.find(options->filter) != string::npos;
+}
+
+double percentile(vector<uint64_t> &sorted, double p) {
+    if (sorted.empty()) return 0;
+    size_t idx = static_cast<size_t>(p * static_cast<double>(sorted.size() - 1) + 0.5);
+    return static_cast<double>(sorted[idx]);
+}
+
+// Collects one duration per sample plus the heap traffic between start()
+// and finish(). The sample buffer is reserved up front so it does not
+// show up in the allocation counts.
+class Recorder {
+    vector<uint64_t> samples;
+    uint64_t allocs0 = 0, bytes0 = 0;
+    chrono::steady_clock::time_point t0;
+
+public:
+    explicit Recorder(size_t expected) { samples.reserve(expected); }
+
+    void start() {
+        allocs0 = allocCount.load(memory_order_relaxed);
+        bytes0 = allocBytes.load(memory_order_relaxed);
+    }
+
+    void begin() { t0 = chrono::steady_clock::now(); }
+    void end() {
+        auto t1 = chrono::steady_clock::now();
+        samples.push_back(static_cast<uint64_t>(chrono::nanoseconds(t1 - t0).count()));
+    }
+
+    // opsPerSample: operations covered by one sample (items, for bulk runs).
+    Result &finish(const string &name, size_t items, size_t opsPerSample = 1) {
+        uint64_t allocs = allocCount.load(memory_order_relaxed) - allocs0;
+        uint64_t bytes = allocBytes.load(memory_order_relaxed) - bytes0;
+        Result r;
+        r.name = name;
+        r.items = items;
+        r.ops = samples.size() * opsPerSample;
+        double per = static_cast<double>(max<size_t>(opsPerSample, 1));
+        uint64_t total = 0;
+        for (uint64_t s : samples) total += s;
+        sort(samples.begin(), samples.end());
+        if (r.ops > 0) {
+            r.nsPerOp = static_cast<double>(total) / static_cast<double>(r.ops);
+            r.allocsPerOp = static_cast<double>(allocs) / static_cast<double>(r.ops);
+            r.bytesPerOp = static_cast<double>(bytes) / static_cast<double>(r.ops);
+        }
+        r.p50 = percentile(samples, 0.50) / per;
+        r.p90 = percentile(samples, 0.90) / per;
+        r.p99 = percentile(samples, 0.99) / per;
+        r.p999 = percentile(samples, 0.999) / per;
+        r.max = samples.empty() ? 0 : static_cast<double>(samples.back()) / per;
+        results.push_back(move(r));
+        Result &out = results.back();
+        printf("%-26s %9zu %9zu %10.1f %9.0f %9.0f %9.0f %10.0f %8.2f %9.1f\n", out.name.c_str(),
+               out.items, out.ops, out.nsPerOp, out.p50, out.p99, out.p999, out.max,
+               out.allocsPerOp, out.bytesPerOp);
+        fflush(stdout);
+        return out;
+    }
+};
+
+// Repeat a bulk operation over a library of n items and report per item.
+template <typename F>
+Result &bulk(const string &name, size_t items, size_t perRun, F run) {
+    size_t reps = max<size_t>(3, min<size_t>(30, 20000000 / max<size_t>(perRun, 1)));
+    run();  // warm up
+    Recorder rec(reps);
+    rec.start();
+    for (size_t r = 0; r < reps; ++r) {
+        rec.begin();
+        run();
+        rec.end();
+    }
+    return rec.finish(name, items, perRun);
+}
+
+void metric(Result &r, const string &key, double value) {
+    r.metrics.emplace_back(key, value);
+    printf("    %s = %.2f\n", key.c_str(), value);
+}
+
+// Throughput of a bulk result that wrote bytesPerRun for perRun items.
+double mbPerSecond(uint64_t bytesPerRun, const Result &r, size_t perRun) {
+    return static_cast<double>(bytesPerRun) / (r.nsPerOp * static_cast<double>(perRun)) * 1e3;
+}
+
+// Discards output, counting the bytes.
+class NullBuffer : public streambuf {
+    uint64_t bytes = 0;
+
+protected:
+    int overflow(int c) override {
+        ++bytes;
+        return c;
+    }
+    streamsize xsputn(const char *, streamsize n) override {
+        bytes += static_cast<uint64_t>(n);
+        return n;
+    }
+
+public:
+    uint64_t count() const { return bytes; }
+};
+
+// ===== library setup =====
+
+// Shelves for n items at about 80% fill, so moves and swaps find room.
+size_t shelvesFor(size_t n) { return n / 12 + 1; }
+
+vector<unique_ptr<Item>> makeItems(CatalogGenerator &gen, size_t n) {
+    vector<unique_ptr<Item>> items;
+    items.reserve(n);
+    for (size_t i = 0; i < n; ++i) items.push_back(gen.make(static_cast<int>(i)));
+    return items;
+}
+
+// Fill lib from items, first fit. Returns the occupied locations.
+vector<ShelfSlot> fill(LibraryStorage &lib, vector<unique_ptr<Item>> &items) {
+    vector<ShelfSlot> slots;
+    slots.reserve(items.size());
+    for (auto &item : items) {
+        if (auto at = lib.addItemAnywhere(move(item))) slots.push_back(*at);
+    }
+    items.clear();
+    return slots;
+}
+
+// k distinct occupied locations.
+vector<ShelfSlot> sample(CatalogGenerator &gen, vector<ShelfSlot> slots, size_t k) {
+    shuffle(slots.begin(), slots.end(), gen.engine());
+    slots.resize(min(k, slots.size()));
+    return slots;
+}
+
+// ===== benchmarks =====
+
+void benchAdd(size_t n, uint64_t seed) {
+    if (selected("addItem")) {
+        CatalogGenerator gen(seed, n / 20 + 50);
+        vector<unique_ptr<Item>> items = makeItems(gen, n);
+        LibraryStorage lib(shelvesFor(n));
+        Recorder rec(n);
+        rec.start();
+        for (size_t i = 0; i < n; ++i) {
+            rec.begin();
+            (void)lib.addItem(move(items[i]), i / Shelf::DEFAULT_CAPACITY,
+                              i % Shelf::DEFAULT_CAPACITY);
+            rec.end();
+        }
+        rec.finish("addItem", n);
+    }
+    if (selected("addItemAnywhere")) {
+        CatalogGenerator gen(seed, n / 20 + 50);
+        vector<unique_ptr<Item>> items = makeItems(gen, n);
+        LibraryStorage lib(shelvesFor(n));
+        Recorder rec(n);
+        rec.start();
+        for (size_t i = 0; i < n; ++i) {
+            rec.begin();
+            (void)lib.addItemAnywhere(move(items[i]));
+            rec.end();
+        }
+        rec.finish("addItemAnywhere", n);
+    }
+    // Item construction plus addItem, on the heap and in a storage arena:
+    // the allocations per op show what the arena saves.
+    for (bool arena : {false, true}) {
+        string name = arena ? "createAndAdd/arena" : "createAndAdd/heap";
+        if (!selected(name)) continue;
+        CatalogGenerator gen(seed, n / 20 + 50);
+        LibraryStorage lib(shelvesFor(n));
+        ItemArena *a = arena ? lib.enableArena() : nullptr;
+        size_t ops = min(n, options->maxOps);
+        Recorder rec(ops);
+        rec.start();
+        for (size_t i = 0; i < ops; ++i) {
+            rec.begin();
+            {
+                ItemArena::Scope scope(a);
+                (void)lib.addItemAnywhere(gen.make(static_cast<int>(i)));
+            }
+            rec.end();
+        }
+        rec.finish(name, n);
+    }
+}
+
+void benchOperations(size_t n, uint64_t seed) {
+    CatalogGenerator gen(seed, n / 20 + 50);
+    LibraryStorage lib(shelvesFor(n));
+    vector<unique_ptr<Item>> items = makeItems(gen, n);
+    vector<ShelfSlot> slots = fill(lib, items);
+
+    // Loans spread over one patron per ten loans, so the largest runs
+    // have 10^5 patrons holding 10^6 loans.
+    size_t k = min(slots.size() / 2, options->maxOps);
+    vector<ShelfSlot> loaned = sample(gen, slots, k);
+    vector<string> patrons(max<size_t>(k / 10, 1));
+    for (size_t i = 0; i < patrons.size(); ++i) patrons[i] = "Patron " + to_string(i);
+    vector<string> due(k);
+    for (size_t i = 0; i < k; ++i) due[i] = formatDueDay(20000 + static_cast<int32_t>(i % 730));
+    vector<string> who(k);
+    for (size_t i = 0; i < k; ++i) who[i] = patrons[gen.pick(patrons.size())];
+
+    auto checkoutAll = [&](Recorder *rec) {
+        for (size_t i = 0; i < k; ++i) {
+            if (rec) rec->begin();
+            (void)lib.checkoutItem(loaned[i].shelf, loaned[i].comp, move(who[i]), move(due[i]));
+            if (rec) rec->end();
+        }
+    };
+    if (selected("checkoutItem")) {
+        Recorder rec(k);
+        rec.start();
+        checkoutAll(&rec);
+        Result &r = rec.finish("checkoutItem", n);
+        metric(r, "patrons", static_cast<double>(patrons.size()));
+    } else {
+        checkoutAll(nullptr);
+    }
+
+    if (selected("loansOf")) {
+        size_t q = min<size_t>(patrons.size(), 100000);
+        Recorder rec(q);
+        rec.start();
+        size_t found = 0;
+        for (size_t i = 0; i < q; ++i) {
+            rec.begin();
+            found += lib.loansOf(patrons[i]).size();
+            rec.end();
+        }
+        Result &r = rec.finish("loansOf", n);
+        metric(r, "loans_per_patron", static_cast<double>(found) / static_cast<double>(q));
+    }
+
+    if (selected("overdueLoans")) {
+        Recorder rec(100);
+        rec.start();
+        for (int i = 0; i < 100; ++i) {
+            rec.begin();
+            lib.overdueLoans(20000 + i * 7, 100);
+            rec.end();
+        }
+        rec.finish("overdueLoans/top100", n);
+    }
+
+    // Kept for the compact store's comparison below.
+    const Result *itemsScan = nullptr;
+    const Result *magazineScan = nullptr;
+    if (selected("scan")) {
+        size_t stored = slots.size() - k;
+        Result &nested = bulk("scan/nested", n, stored, [&] {
+            size_t sum = 0;
+            for (size_t s = 0; s < lib.numShelves(); ++s) {
+                for (size_t c = 0; c < lib[s].capacity(); ++c) {
+                    const Item *item = lib[s][c].get();
+                    if (item) sum += static_cast<size_t>(item->getId());
+                }
+            }
+            asm volatile("" : : "r"(sum));
+        });
+        Result &range = bulk("scan/items", n, stored, [&] {
+            size_t sum = 0;
+            for (const ItemLocation &loc : lib.items()) {
+                sum += static_cast<size_t>(loc.item->getId());
+            }
+            asm volatile("" : : "r"(sum));
+        });
+        metric(range, "speedup_vs_nested", nested.nsPerOp / range.nsPerOp);
+        itemsScan = &range;
+        magazineScan = &bulk("scan/items(Magazine)", n, stored, [&] {
+            size_t sum = 0;
+            for (const ItemLocation &loc : lib.items(ItemType::Magazine)) {
+                sum += static_cast<size_t>(loc.item->getId());
+            }
+            asm volatile("" : : "r"(sum));
+        });
+        bulk("scan/loans", n, k, [&] {
+            size_t sum = 0;
+            for (const ItemLocation &loc : lib.loans()) sum += loc.person.size();
+            asm volatile("" : : "r"(sum));
+        });
+    }
+
+    // The same stored items in the type-segregated CompactItemStore: a
+    // full scan through the handles, and a filtered scan that walks the
+    // magazine array alone. Both are per stored item, as above.
+    if (selected("compact/scan")) {
+        CompactItemStore compact = CompactItemStore::fromStorage(lib);
+        size_t stored = compact.size();
+        Result &full = bulk("compact/scan", n, stored, [&] {
+            size_t sum = 0;
+            compact.forEachItem([&](size_t, size_t, const auto &rec) {
+                sum += static_cast<size_t>(rec.id);
+            });
+            asm volatile("" : : "r"(sum));
+        });
+        if (itemsScan) metric(full, "speedup_vs_items", itemsScan->nsPerOp / full.nsPerOp);
+        Result &filtered = bulk("compact/scan_filtered", n, stored, [&] {
+            size_t sum = 0;
+            compact.forEach<MagazineRecord>(
+                [&](const MagazineRecord &rec) { sum += static_cast<size_t>(rec.id); });
+            asm volatile("" : : "r"(sum));
+        });
+        if (magazineScan) {
+            metric(filtered, "speedup_vs_items(Magazine)",
+                   magazineScan->nsPerOp / filtered.nsPerOp);
+        }
+    }
+
+    if (selected("print")) {
+        NullBuffer sink;
+        streambuf *saved = cout.rdbuf(&sink);
+        size_t total = slots.size();
+        lib.printItemsInStorage();
+        lib.printCheckedOutItems();
+        uint64_t bytes = sink.count();
+        Result &r = bulk("print/storage+loans", n, total, [&] {
+            lib.printItemsInStorage();
+            lib.printCheckedOutItems();
+        });
+        cout.rdbuf(saved);
+        metric(r, "MB_per_s", mbPerSecond(bytes, r, total));
+    }
+
+    for (ReportFormat format : {ReportFormat::Text, ReportFormat::Json, ReportFormat::Csv}) {
+        static const char *const names[] = {"report/text", "report/json", "report/csv"};
+        string name = names[static_cast<int>(format)];
+        if (!selected(name)) continue;
+        NullBuffer sink;
+        ostream out(&sink);
+        uint64_t bytes = 0;
+        size_t total = slots.size();
+        Result &r = bulk(name, n, total, [&] {
+            ReportWriter w(out, format);
+            lib.writeItemsInStorage(w);
+            lib.writeCheckedOutItems(w);
+            w.finish();
+            bytes = w.bytesWritten();
+        });
+        metric(r, "MB_per_s", mbPerSecond(bytes, r, total));
+    }
+
+    // Symbols in the global pool (every size so far) against the bytes
+    // the people's names of this library would take as one copy each.
+    if (selected("intern")) {
+        uint64_t copied = 0;
+        auto add = [&](const Item &item) {
+            if (item.type() == ItemType::Book) {
+                copied += static_cast<const Book &>(item).getAuthor().size();
+            } else if (item.type() == ItemType::Movie) {
+                const auto &movie = static_cast<const Movie &>(item);
+                copied += movie.getDirector().size();
+                for (Symbol actor : movie.getMainActors()) copied += actor.str().size();
+            }
+        };
+        for (const ItemLocation &loc : lib.items()) add(*loc.item);
+        for (const ItemLocation &loc : lib.loans()) add(*loc.item);
+        const StringPool &pool = StringPool::global();
+        Result r;
+        r.name = "intern/footprint";
+        r.items = n;
+        results.push_back(r);
+        printf("%-26s %9zu\n", r.name.c_str(), n);
+        metric(results.back(), "symbols", static_cast<double>(pool.size()));
+        metric(results.back(), "pool_bytes", static_cast<double>(pool.memoryBytes()));
+        metric(results.back(), "copied_text_bytes", static_cast<double>(copied));
+    }
+
+    if (selected("findById")) {
+        size_t q = min(n, options->maxOps);
+        vector<int> ids(q);
+        for (int &id : ids) id = static_cast<int>(gen.pick(n));
+        Recorder rec(q);
+        rec.start();
+        for (int id : ids) {
+            rec.begin();
+            lib.findById(id);
+            rec.end();
+        }
+        rec.finish("findById", n);
+    }
+
+    if (selected("audit")) {
+        Result &serial = bulk("audit/serial", n, slots.size(), [&] { auditInventory(lib); });
+        size_t hw = max<size_t>(thread::hardware_concurrency(), 1);
+        for (size_t threads = 1;; threads = min(threads * 2, hw)) {
+            ThreadPool pool(threads);
+            Result &r = bulk("audit/threads=" + to_string(threads), n, slots.size(),
+                             [&] { auditInventory(lib, pool); });
+            metric(r, "speedup_vs_serial", serial.nsPerOp / r.nsPerOp);
+            if (threads == hw) break;
+        }
+    }
+
+    auto checkinAll = [&](Recorder *rec) {
+        for (size_t i = 0; i < k; ++i) {
+            if (rec) rec->begin();
+            (void)lib.checkinItem(loaned[i].shelf, loaned[i].comp);
+            if (rec) rec->end();
+        }
+    };
+    if (selected("checkinItem")) {
+        Recorder rec(k);
+        rec.start();
+        checkinAll(&rec);
+        rec.finish("checkinItem", n);
+    } else {
+        checkinAll(nullptr);
+    }
+
+    // Cold start: the whole storage saved to a snapshot and loaded into a
+    // fresh one, against re-ingesting the same items from a CSV catalog.
+    // Run once every loan is back, so both hold the same items. The file is
+    // in the page cache: this is the cost of rebuilding the storage, not of
+    // the disk.
+    if (selected("snapshot")) {
+        string path = (filesystem::temp_directory_path()
+                       / ("LibraryCheckout_bench_" + to_string(getpid()) + ".snap"))
+                          .string();
+        size_t total = slots.size();
+        // Whole-storage runs take seconds at 10^6 items; three are enough.
+        auto timed = [&](const string &name, auto run) -> Result & {
+            Recorder rec(3);
+            rec.start();
+            for (int i = 0; i < 3; ++i) {
+                rec.begin();
+                run();
+                rec.end();
+            }
+            return rec.finish(name, n, total);
+        };
+        Result &save = timed("snapshot/save", [&] { saveSnapshot(lib, path); });
+        uint64_t bytes = filesystem::file_size(path);
+        metric(save, "MB_per_s", mbPerSecond(bytes, save, total));
+        Result &load = timed("snapshot/load", [&] {
+            LibraryStorage fresh(0);
+            loadSnapshot(path, fresh);
+        });
+        metric(load, "cold_start_ms", load.nsPerOp * static_cast<double>(total) / 1e6);
+        metric(load, "MB_per_s", mbPerSecond(bytes, load, total));
+        filesystem::remove(path);
+
+        ostringstream catalog;
+        {
+            ReportWriter w(catalog, ReportFormat::Csv);
+            lib.writeItemsInStorage(w);
+            w.finish();
+        }
+        string csv = catalog.str();
+        Result &ingest = timed("snapshot/vs_catalog_load", [&] {
+            LibraryStorage fresh(0);
+            istringstream in(csv);
+            loadCatalog(in, fresh);
+        });
+        metric(ingest, "cold_start_ms", ingest.nsPerOp * static_cast<double>(total) / 1e6);
+        metric(ingest, "snapshot_speedup", ingest.nsPerOp / load.nsPerOp);
+    }
+
+    if (selected("swapItems")) {
+        size_t q = min(slots.size(), options->maxOps);
+        vector<pair<ShelfSlot, ShelfSlot>> pairs(q);
+        for (auto &[a, b] : pairs) {
+            a = slots[gen.pick(slots.size())];
+            b = slots[gen.pick(slots.size())];
+        }
+        Recorder rec(q);
+        rec.start();
+        for (const auto &[a, b] : pairs) {
+            rec.begin();
+            (void)lib.swapItems(a.shelf, a.comp, b.shelf, b.comp);
+            rec.end();
+        }
+        rec.finish("swapItems", n);
+    }
+
+    // Calls that are all refused: the cost of the error path itself. The
+    // reason goes nowhere, as in a batch run that only counts failures.
+    if (selected("failures")) {
+        size_t q = min(slots.size(), options->maxOps);
+        vector<ShelfSlot> at(q);
+        for (ShelfSlot &s : at) s = slots[gen.pick(slots.size())];
+        NullBuffer sink;
+        streambuf *saved = cerr.rdbuf(&sink);
+        auto refused = [&](const string &name, auto call) {
+            Recorder rec(q);
+            size_t failures = 0;
+            rec.start();
+            for (const ShelfSlot &s : at) {
+                rec.begin();
+                if (!call(s)) ++failures;
+                rec.end();
+            }
+            Result &r = rec.finish("failures/" + name, n);
+            metric(r, "refused", static_cast<double>(failures) / static_cast<double>(q));
+        };
+        refused("bad_compartment", [&](const ShelfSlot &s) {
+            return lib.checkoutItem(s.shelf, Shelf::MAX_CAPACITY, "Reader", "2026-03-01");
+        });
+        refused("not_checked_out", [&](const ShelfSlot &s) {
+            return lib.checkinItem(s.shelf, s.comp);
+        });
+        refused("occupied", [&](const ShelfSlot &s) {
+            return lib.moveItem(s.shelf, s.comp, at[0].shelf, at[0].comp);
+        });
+        refused("no_shelf", [&](const ShelfSlot &s) {
+            return lib.removeItem(lib.numShelves() + s.shelf, s.comp);
+        });
+        cerr.rdbuf(saved);
+    }
+
+    // Two holds on each of q loaned items (up to 10^6 holds), the check-ins
+    // that hand every item to its first holder, then that holder cancelling
+    // so it passes to the second. Leaves no loans or holds behind.
+    if (selected("holds")) {
+        size_t q = min(slots.size(), options->maxOps) / 2;
+        vector<ShelfSlot> held = sample(gen, slots, q);
+        for (const ShelfSlot &s : held) (void)lib.checkoutItem(s.shelf, s.comp, "Reader", "");
+        size_t np = patrons.size();
+        Recorder place(2 * q);
+        place.start();
+        for (size_t i = 0; i < 2 * q; ++i) {
+            const ShelfSlot &s = held[i % q];
+            place.begin();
+            (void)lib.placeHold(s.shelf, s.comp, patrons[(i % q + i / q) % np]);
+            place.end();
+        }
+        Result &r = place.finish("holds/placeHold", n);
+        metric(r, "holds", static_cast<double>(2 * q));
+
+        Recorder handoff(q);
+        handoff.start();
+        for (const ShelfSlot &s : held) {
+            handoff.begin();
+            (void)lib.checkinItem(s.shelf, s.comp);
+            handoff.end();
+        }
+        handoff.finish("holds/checkin_to_holder", n);
+
+        Recorder cancel(q);
+        cancel.start();
+        for (size_t i = 0; i < q; ++i) {
+            cancel.begin();
+            (void)lib.cancelHold(held[i].shelf, held[i].comp, patrons[i % np]);
+            cancel.end();
+        }
+        cancel.finish("holds/cancel_pickup", n);
+        for (size_t i = 0; i < q; ++i) {
+            (void)lib.cancelHold(held[i].shelf, held[i].comp, patrons[(i + 1) % np]);
+        }
+    }
+
+    // Transactions of 8 checkouts, then 8 check-ins of the same items.
+    if (selected("transaction")) {
+        size_t groups = min(slots.size(), options->maxOps) / 8;
+        vector<ShelfSlot> picked = sample(gen, slots, groups * 8);
+        Recorder rec(groups * 2);
+        rec.start();
+        LibraryStorage::Transaction tx;
+        for (size_t g = 0; g < groups; ++g) {
+            for (size_t i = g * 8; i < g * 8 + 8; ++i) {
+                tx.checkoutItem(picked[i].shelf, picked[i].comp, "Reader", "2026-03-01");
+            }
+            rec.begin();
+            (void)lib.commit(tx);
+            rec.end();
+            for (size_t i = g * 8; i < g * 8 + 8; ++i) {
+                tx.checkinItem(picked[i].shelf, picked[i].comp);
+            }
+            rec.begin();
+            (void)lib.commit(tx);
+            rec.end();
+        }
+        Result &r = rec.finish("transaction/commit8", n);
+        metric(r, "steps_per_s", 8e9 / r.nsPerOp);
+    }
+
+    if (selected("batch")) {
+        size_t q = min(slots.size(), options->maxOps);
+        string script;
+        for (size_t i = 0; i < q; ++i) {
+            const ShelfSlot &at = slots[gen.pick(slots.size())];
+            string where = to_string(at.shelf) + " " + to_string(at.comp);
+            switch (i % 4) {
+                case 0:
+                    script += "checkout " + where + " \"" + patrons[gen.pick(patrons.size())]
+                              + "\" 2026-04-01\n";
+                    break;
+                case 1:
+                    script += "checkin " + where + "\n";
+                    break;
+                case 2:
+                    script += "find " + to_string(gen.pick(n)) + "\n";
+                    break;
+                default:
+                    script += "swap " + where + " " + where + "\n";
+                    break;
+            }
+        }
+        CommandProcessor proc(lib);
+        NullBuffer sink;
+        ostream out(&sink);
+        Recorder rec(1);
+        istringstream in(script);
+        rec.start();
+        rec.begin();
+        BatchResult br = proc.run(in, out);
+        rec.end();
+        Result &r = rec.finish("batch/commands", n, br.commands);
+        metric(r, "commands_per_s", br.commandsPerSecond());
+    }
+
+    if (selected("removeItem")) {
+        // The batch may have left loans; only stored items can be removed.
+        // Half of them go, so the search below still has a catalog.
+        vector<ShelfSlot> stored;
+        for (const ItemLocation &loc : lib.items()) stored.push_back({loc.shelf, loc.comp});
+        vector<ShelfSlot> gone = sample(gen, stored, min(stored.size() / 2, options->maxOps));
+        Recorder rec(gone.size());
+        rec.start();
+        for (const ShelfSlot &at : gone) {
+            rec.begin();
+            (void)lib.removeItem(at.shelf, at.comp);
+            rec.end();
+        }
+        rec.finish("removeItem", n);
+    }
+
+    if (selected("search")) {
+        vector<const Item *> stored;
+        for (const ItemLocation &loc : lib.items()) stored.push_back(loc.item);
+        Recorder build(1);
+        build.start();
+        build.begin();
+        lib.enableSearch();
+        build.end();
+        build.finish("search/build", n, stored.size() + lib.checkedOutRecords().size());
+
+        size_t q = min<size_t>(n, 100000);
+        vector<string> queries(q);
+        for (size_t i = 0; i < q; ++i) {
+            // Two words of one stored item, so every query has hits.
+            string_view name = stored[gen.pick(stored.size())]->getName();
+            size_t space = name.find(' ');
+            queries[i] = string(name.substr(0, space));
+            if (space != string_view::npos) {
+                size_t next = name.find(' ', space + 1);
+                queries[i] += " " + string(name.substr(space + 1, next - space - 1));
+            }
+        }
+        Recorder rec(q);
+        rec.start();
+        for (const string &query : queries) {
+            rec.begin();
+            lib.search(query, 10);
+            rec.end();
+        }
+        rec.finish("search/top10", n);
+    }
+}
+
+// ConcurrentLibraryStorage at about 80% fill, stocked with n items.
+unique_ptr<ConcurrentLibraryStorage> concurrentStore(size_t n, uint64_t seed,
+                                                     ConcurrentLibraryStorage::ReadMode mode) {
+    CatalogGenerator gen(seed, n / 20 + 50);
+    auto lib = make_unique<ConcurrentLibraryStorage>(shelvesFor(n), mode);
+    size_t cap = lib->shelfCapacity();
+    for (size_t i = 0, placed = 0; placed < n; ++i) {
+        if (i % 5 == 4) continue;
+        (void)lib->addItem(gen.make(static_cast<int>(placed)), i / cap, i % cap);
+        ++placed;
+    }
+    return lib;
+}
+
+// ops operations split over threads, each thread calling op(rng, thread)
+// with its own generator. One sample covers the whole run, start of the
+// first thread to the end of the last.
+template <typename Op>
+Result &threadedRun(const string &name, size_t n, size_t threads, size_t ops, Op op) {
+    Recorder rec(1);
+    vector<thread> pool;
+    rec.start();
+    rec.begin();
+    for (size_t t = 0; t < threads; ++t) {
+        size_t share = ops / threads + (t < ops % threads);
+        pool.emplace_back([&op, t, share] {
+            mt19937_64 rng(options->seed + t);
+            for (size_t i = 0; i < share; ++i) op(rng, t);
+        });
+    }
+    for (thread &th : pool) th.join();
+    rec.end();
+    Result &r = rec.finish(name, n, ops);
+    metric(r, "ops_per_s", 1e9 / r.nsPerOp);
+    return r;
+}
+
+// Thread counts 1, 2, 4, ... up to the hardware's, and at least 4 so the
+// contended paths run even on small machines (oversubscribed there).
+vector<size_t> threadCounts() {
+    size_t hw = max<size_t>(thread::hardware_concurrency(), 4);
+    vector<size_t> counts;
+    for (size_t t = 1; t < hw; t *= 2) counts.push_back(t);
+    counts.push_back(hw);
+    return counts;
+}
+
+void benchConcurrent(size_t n, uint64_t seed) {
+    // Throughput against threads for the write path: check-outs and
+    // check-ins at random locations with a swap in every ten, so threads
+    // meet on shelf locks and ledger stripes about as often as desks would.
+    if (selected("concurrent/threads")) {
+        auto lib = concurrentStore(n, seed, ConcurrentLibraryStorage::ReadMode::Locked);
+        size_t shelves = lib->numShelves(), cap = lib->shelfCapacity();
+        size_t ops = min(max<size_t>(n, 100000), options->maxOps);
+        vector<string> readers;
+        for (size_t t : threadCounts()) readers.resize(max(readers.size(), t));
+        for (size_t t = 0; t < readers.size(); ++t) readers[t] = "Reader " + to_string(t);
+        double single = 0;
+        for (size_t threads : threadCounts()) {
+            Result &r = threadedRun(
+                "concurrent/threads=" + to_string(threads), n, threads, ops,
+                [&](mt19937_64 &rng, size_t t) {
+                    size_t s = rng() % shelves, c = rng() % cap;
+                    switch (rng() % 10) {
+                        case 9:
+                            (void)lib->swapItems(s, c, rng() % shelves, rng() % cap);
+                            break;
+                        default:
+                            if (!lib->checkoutItem(s, c, readers[t], "2026-04-01")) {
+                                (void)lib->checkinItem(s, c);
+                            }
+                            break;
+                    }
+                });
+            if (threads == 1) single = r.nsPerOp;
+            metric(r, "speedup_vs_1", single / r.nsPerOp);
+        }
+    }
+
+    // 95% reads (withItem, touching the item's name) and 5% check-outs or
+    // check-ins, with readers taking the shelf lock (mutex) against the
+    // lock-free epoch path, at each thread count.
+    if (selected("read95")) {
+        using Mode = ConcurrentLibraryStorage::ReadMode;
+        size_t ops = min(max<size_t>(n, 100000), options->maxOps);
+        for (size_t threads : threadCounts()) {
+            double locked = 0;
+            for (Mode mode : {Mode::Locked, Mode::EpochBased}) {
+                auto lib = concurrentStore(n, seed, mode);
+                size_t shelves = lib->numShelves(), cap = lib->shelfCapacity();
+                string name = string("read95/")
+                              + (mode == Mode::Locked ? "mutex" : "epoch")
+                              + "/threads=" + to_string(threads);
+                Result &r = threadedRun(name, n, threads, ops, [&](mt19937_64 &rng, size_t) {
+                    size_t s = rng() % shelves, c = rng() % cap;
+                    if (rng() % 100 < 95) {
+                        size_t len = 0;
+                        lib->withItem(s, c, [&](const Item *item) {
+                            if (item) len = item->getName().size();
+                        });
+                        asm volatile("" : : "r"(len));
+                    } else if (!lib->checkoutItem(s, c, "Reader", "2026-04-01")) {
+                        (void)lib->checkinItem(s, c);
+                    }
+                });
+                if (mode == Mode::Locked) {
+                    locked = r.nsPerOp;
+                } else {
+                    metric(r, "speedup_vs_mutex", locked / r.nsPerOp);
+                }
+            }
+        }
+    }
+}
+
+double timerOverhead() {
+    constexpr int N = 1000000;
+    auto t0 = chrono::steady_clock::now();
+    for (int i = 0; i < N; ++i) {
+        auto t = chrono::steady_clock::now();
+        asm volatile("" : : "r"(&t) : "memory");
+    }
+    return static_cast<double>(chrono::nanoseconds(chrono::steady_clock::now() - t0).count()) / N;
+}
+
+void jsonString(ostream &os, const string &s) {
+    os << '"';
+    for (char c : s) {
+        if (c == '"' || c == '\\') os << '\\';
+        os << c;
+    }
+    os << '"';
+}
+
+void writeJson(ostream &os, double overhead) {
+    char when[32];
+    time_t now = time(nullptr);
+    strftime(when, sizeof(when), "%Y-%m-%dT%H:%M:%SZ", gmtime(&now));
+    os << "{\n  \"benchmark\": \"LibraryCheckout_bench\",\n  \"schema\": 1,\n";
+    os << "  \"timestamp\": \"" << when << "\",\n";
+    os << "  \"compiler\": ";
+    jsonString(os, __VERSION__);
+#ifdef NDEBUG
+    os << ",\n  \"assertions\": false";
+#else
+    os << ",\n  \"assertions\": true";
+#endif
+    os << ",\n  \"hardware_concurrency\": " << thread::hardware_concurrency();
+    os << ",\n  \"seed\": " << options->seed;
+    os << ",\n  \"timer_overhead_ns\": " << overhead;
+    os << ",\n  \"results\": [";
+    for (size_t i = 0; i < results.size(); ++i) {
+        const Result &r = results[i];
+        os << (i ? ",\n    {" : "\n    {") << "\"name\": ";
+        jsonString(os, r.name);
+        os << ", \"items\": " << r.items << ", \"ops\": " << r.ops
+           << ", \"ns_per_op\": " << r.nsPerOp << ", \"p50_ns\": " << r.p50
+           << ", \"p90_ns\": " << r.p90 << ", \"p99_ns\": " << r.p99
+           << ", \"p999_ns\": " << r.p999 << ", \"max_ns\": " << r.max
+           << ", \"allocs_per_op\": " << r.allocsPerOp << ", \"bytes_per_op\": " << r.bytesPerOp
+           << ", \"metrics\": {";
+        for (size_t m = 0; m < r.metrics.size(); ++m) {
+            os << (m ? ", " : "");
+            jsonString(os, r.metrics[m].first);
+            os << ": " << r.metrics[m].second;
+        }
+        os << "}}";
+    }
+    os << "\n  ]\n}\n";
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+    Options opt;
+    if (!parseOptions(argc, argv, opt)) {
+        cerr << "Usage: " << argv[0]
+             << " [--min <items>] [--max <items>] [--ops <n>] [--seed <n>] [--filter <text>]"
+                " [--json <file | ->]\n";
+        return 1;
+    }
+    options = &opt;
+
+    double overhead = timerOverhead();
+    printf("timer overhead: %.1f ns per sample\n", overhead);
+    printf("%-26s %9s %9s %10s %9s %9s %9s %10s %8s %9s\n", "benchmark", "items", "ops", "ns/op",
+           "p50", "p99", "p99.9", "max", "allocs", "bytes");
+
+    for (size_t n = opt.minItems; n <= opt.maxItems; n *= 10) {
+        benchAdd(n, opt.seed);
+        benchOperations(n, opt.seed);
+        benchConcurrent(n, opt.seed);
+        if (n > opt.maxItems / 10) break;
+    }
+
+    if (!opt.jsonPath.empty()) {
+        if (opt.jsonPath == "-") {
+            writeJson(cout, overhead);
+        } else {
+            ofstream out(opt.jsonPath);
+            if (!out) {
+                cerr << "Cannot write " << opt.jsonPath << "\n";
+                return 1;
+            }
+            writeJson(out, overhead);
+        }
+    }
+    return 0;
+}
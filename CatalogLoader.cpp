@@ -0,0 +1,195 @@
+#include "CatalogLoader.h"
+#include <algorithm>
+#include <cctype>
+#include <charconv>
+#include <chrono>
+#include <fstream>
+#include <string_view>
+
+using namespace std;
+
+/*
+ * File: CatalogLoader.cpp
+ * -----------------------
+ * Implements the catalog loader declared in CatalogLoader.h. Each line is
+ * split into fields in place, converted into an Item, and queued; full
+ * batches go to LibraryStorage::addItems, whose per-row errors are mapped
+ * back to source line numbers.
+ */
+
+double LoadResult::rowsPerSecond() const {
+    return seconds > 0.0 ? static_cast<double>(rowsRead) / seconds : 0.0;
+}
+
+// Split line on delim. Quoted fields (CSV only) may contain the delimiter.
+static void splitFields(const string &line, char delim, vector<string> &out) {
+    out.clear();
+    string field;
+    bool quoted = false;
+    for (size_t i = 0; i < line.size(); ++i) {
+        char ch = line[i];
+        if (quoted) {
+            if (ch == '"' && i + 1 < line.size() && line[i + 1] == '"') {
+                field.push_back('"');
+                ++i;
+            } else if (ch == '"') {
+                quoted = false;
+            } else {
+                field.push_back(ch);
+            }
+        } else if (ch == '"' && delim == ',' && field.empty()) {
+            quoted = true;
+        } else if (ch == delim) {
+            out.push_back(move(field));
+            field.clear();
+        } else {
+            field.push_back(ch);
+        }
+    }
+    out.push_back(move(field));
+}
+
+static string_view trimView(string_view s) {
+    size_t start = s.find_first_not_of(" \t\r");
+    if (start == string_view::npos) return {};
+    size_t end = s.find_last_not_of(" \t\r");
+    return s.substr(start, end - start + 1);
+}
+
+template <typename T>
+static bool parseNumber(string_view s, T &value) {
+    s = trimView(s);
+    auto [ptr, ec] = from_chars(s.data(), s.data() + s.size(), value);
+    return ec == errc() && ptr == s.data() + s.size();
+}
+
+static string lowerCase(string_view s) {
+    string r(trimView(s));
+    transform(r.begin(), r.end(), r.begin(),
+              [](unsigned char ch) { return static_cast<char>(tolower(ch)); });
+    return r;
+}
+
+static vector<string> splitList(string_view s) {
+    vector<string> result;
+    while (!s.empty()) {
+        size_t pos = s.find(';');
+        string_view part = trimView(s.substr(0, pos));
+        if (!part.empty()) result.emplace_back(part);
+        if (pos == string_view::npos) break;
+        s.remove_prefix(pos + 1);
+    }
+    return result;
+}
+
+// Build the item for one row, or return an error message.
+static string parseRow(vector<string> &f, PlacedItem &out) {
+    if (f.size() < 4) return "Expected at least 4 fields, got " + to_string(f.size());
+
+    string type = lowerCase(f[0]);
+    int id = 0;
+    if (trimView(f[1]) == "*") {
+        out.shelf = PlacedItem::ANYWHERE;
+        out.comp = 0;
+    } else if (!parseNumber(f[1], out.shelf)) {
+        return "Invalid shelf index \"" + f[1] + "\"";
+    } else if (!parseNumber(f[2], out.comp)) {
+        return "Invalid compartment index \"" + f[2] + "\"";
+    }
+    if (!parseNumber(f[3], id)) return "Invalid item id \"" + f[3] + "\"";
+
+    if (type == "book") {
+        if (f.size() != 9) return "Book rows need 9 fields, got " + to_string(f.size());
+        out.item = make_unique<Book>(move(f[4]), move(f[5]), id, move(f[6]), move(f[7]),
+                                     move(f[8]));
+    } else if (type == "movie") {
+        if (f.size() != 9) return "Movie rows need 9 fields, got " + to_string(f.size());
+        out.item = make_unique<Movie>(move(f[4]), move(f[5]), id, move(f[6]), move(f[7]),
+                                      splitList(f[8]));
+    } else if (type == "magazine") {
+        if (f.size() != 8) return "Magazine rows need 8 fields, got " + to_string(f.size());
+        out.item = make_unique<Magazine>(move(f[4]), move(f[5]), id, move(f[6]),
+                                         move(f[7]));
+    } else {
+        return "Unknown item type \"" + f[0] + "\"";
+    }
+    return "";
+}
+
+static void flushBatch(LibraryStorage &lib, vector<PlacedItem> &batch,
+                       vector<size_t> &lines, LoadResult &result) {
+    if (batch.empty()) return;
+
+    size_t maxShelf = 0;
+    for (const PlacedItem &p : batch) {
+        if (p.shelf != PlacedItem::ANYWHERE) maxShelf = max(maxShelf, p.shelf);
+    }
+    lib.reserveShelves(maxShelf + 1);
+
+    vector<IngestError> errors = lib.addItems(batch);
+    result.rowsLoaded += batch.size() - errors.size();
+    for (IngestError &e : errors) {
+        e.row = lines[e.row];
+        result.errors.push_back(move(e));
+    }
+    batch.clear();
+    lines.clear();
+}
+
+LoadResult loadCatalog(istream &in, LibraryStorage &lib, size_t batchSize, size_t maxShelves) {
+    auto start = chrono::steady_clock::now();
+    LoadResult result;
+    ItemArena::Scope scope(lib.itemArena());
+
+    vector<PlacedItem> batch;
+    vector<size_t> lines;
+    batch.reserve(batchSize);
+    lines.reserve(batchSize);
+
+    string line;
+    vector<string> fields;
+    char delim = 0;
+    size_t lineNo = 0;
+
+    while (getline(in, line)) {
+        ++lineNo;
+        string_view content = trimView(line);
+        if (content.empty() || content.front() == '#') continue;
+        if (delim == 0) delim = line.find('\t') != string::npos ? '\t' : ',';
+        if (lowerCase(content.substr(0, 4)) == "type") continue;
+
+        ++result.rowsRead;
+        splitFields(line, delim, fields);
+        PlacedItem p;
+        string err = parseRow(fields, p);
+        if (err.empty() && p.shelf != PlacedItem::ANYWHERE && p.shelf >= maxShelves
+            && p.shelf >= lib.numShelves()) {
+            err = "Shelf index " + to_string(p.shelf) + " is beyond the limit of "
+                  + to_string(maxShelves) + " shelves";
+        }
+        if (!err.empty()) {
+            result.errors.push_back({lineNo, move(err)});
+            continue;
+        }
+        batch.push_back(move(p));
+        lines.push_back(lineNo);
+        if (batch.size() >= batchSize) flushBatch(lib, batch, lines, result);
+    }
+    flushBatch(lib, batch, lines, result);
+    sort(result.errors.begin(), result.errors.end(),
+         [](const IngestError &a, const IngestError &b) { return a.row < b.row; });
+
+    result.seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    return result;
+}
+
+LoadResult loadCatalogFile(const string &path, LibraryStorage &lib, size_t batchSize,
+                           size_t maxShelves) {
+    ifstream in(path);
+    if (!in) {
+        LoadResult result;
+        result.errors.push_back({0, "Cannot open file \"" + path + "\""});
+        return result;
+    }
+    return loadCatalog(in, lib, batchSize, maxShelves);
+}
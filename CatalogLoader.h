@@ -0,0 +1,63 @@
+#pragma once
+#include "LibraryStorage.h"
+#include <istream>
+#include <string>
+#include <vector>
+
+/*
+ * File: CatalogLoader.h
+ * ---------------------
+ * Streaming loader for catalog files. Each row describes one Book, Movie
+ * or Magazine and the location it is stored at. Rows are parsed in
+ * batches and handed to LibraryStorage::addItems.
+ *
+ * Row layout (comma- or tab-separated; the delimiter is taken from the
+ * first data line). CSV fields may be double-quoted, with "" for a quote.
+ *
+ *   book,     shelf, comp, id, name, description, title, author, copyright
+ *   movie,    shelf, comp, id, name, description, title, director, actors
+ *   magazine, shelf, comp, id, name, description, edition, mainArticle
+ *
+ * A shelf of "*" (compartment ignored) stores the item in the first free
+ * compartment. Movie actors are separated by ';'. Blank lines, lines starting with '#'
+ * and a header line starting with "type" are skipped.
+ *
+ * Missing shelves up to the highest one a batch names are created with the
+ * default capacity. A row naming a shelf at or beyond maxShelves is
+ * rejected instead, so one mistyped index cannot grow the storage to
+ * billions of shelves.
+ *
+ * Data Table (identifier | datatype | use)
+ * ----------------------------------------------------------------------
+ * LoadResult  | struct                   | Summary of one load
+ * rowsRead    | size_t                   | Data rows seen (excludes skipped lines)
+ * rowsLoaded  | size_t                   | Rows stored in the library
+ * errors      | std::vector<IngestError> | Rejected rows; row = 1-based line number
+ * seconds     | double                   | Wall time spent loading
+ * batchSize   | size_t                   | Rows parsed before each addItems call
+ * maxShelves  | size_t                   | Shelves a load may grow the storage to
+ * DEFAULT_MAX_SHELVES | constexpr size_t | Default maxShelves (2^20)
+ *
+ */
+
+struct LoadResult {
+    size_t rowsRead = 0;
+    size_t rowsLoaded = 0;
+    std::vector<IngestError> errors;
+    double seconds = 0.0;
+
+    double rowsPerSecond() const;
+};
+
+constexpr size_t DEFAULT_MAX_SHELVES = size_t{1} << 20;
+
+// Load every row from in. Shelves referenced by a batch are created before
+// the batch is stored; rows naming shelf maxShelves or beyond are errors.
+LoadResult loadCatalog(std::istream &in, LibraryStorage &lib, size_t batchSize = 65536,
+                       size_t maxShelves = DEFAULT_MAX_SHELVES);
+
+// Open path and load it. A file that cannot be opened is reported as an
+// error on row 0.
+LoadResult loadCatalogFile(const std::string &path, LibraryStorage &lib,
+                           size_t batchSize = 65536,
+                           size_t maxShelves = DEFAULT_MAX_SHELVES);
@@ -0,0 +1,403 @@
+#include "CommandProcessor.h"
+#include "DueDate.h"
+#include "Journal.h"
+#include "StorageStats.h"
+#include <charconv>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <sstream>
+#include <thread>
+
+using namespace std;
+
+/*
+ * File: CommandProcessor.cpp
+ * --------------------------
+ * Implements the batch command interpreter declared in
+ * CommandProcessor.h. A refused operation's StorageError becomes the
+ * reply text.
+ */
+
+namespace {
+
+// Split line into words, honouring double quotes. Returns false on an
+// unterminated quote.
+bool splitWords(string_view line, vector<string> &out) {
+    out.clear();
+    size_t i = 0;
+    while (true) {
+        while (i < line.size() && (line[i] == ' ' || line[i] == '\t' || line[i] == '\r')) ++i;
+        if (i == line.size()) return true;
+        string &word = out.emplace_back();
+        if (line[i] != '"') {
+            size_t start = i;
+            while (i < line.size() && line[i] != ' ' && line[i] != '\t' && line[i] != '\r') ++i;
+            word.assign(line.substr(start, i - start));
+            continue;
+        }
+        ++i;
+        while (true) {
+            if (i == line.size()) return false;
+            if (line[i] == '"') {
+                if (i + 1 < line.size() && line[i + 1] == '"') {
+                    word += '"';
+                    i += 2;
+                    continue;
+                }
+                ++i;
+                break;
+            }
+            word += line[i++];
+        }
+    }
+}
+
+template <typename T>
+bool parseNumber(const string &s, T &value) {
+    auto [end, ec] = from_chars(s.data(), s.data() + s.size(), value);
+    return ec == errc() && end == s.data() + s.size();
+}
+
+// A shelf or compartment number: refused unless it fits a storage
+// location at all (see LoanIndex::MAX_INDEX), so nothing past that reaches
+// the storage from a batch file or a network client.
+bool parseIndex(const string &s, size_t &value) {
+    return parseNumber(s, value) && value <= LoanIndex::MAX_INDEX;
+}
+
+vector<string> splitActors(const string &s) {
+    vector<string> actors;
+    size_t start = 0;
+    while (true) {
+        size_t pos = s.find(';', start);
+        actors.push_back(s.substr(start, pos - start));
+        if (pos == string::npos) return actors;
+        start = pos + 1;
+    }
+}
+
+bool fail(string &out, string_view message) {
+    out += "error: ";
+    out += message;
+    out += '\n';
+    return false;
+}
+
+bool fail(string &out, StorageError error) { return fail(out, storageErrorName(error)); }
+
+bool ok(string &out) {
+    out += "ok\n";
+    return true;
+}
+
+void appendLocation(string &out, const ItemLocation &loc) {
+    ostringstream line;
+    line << "  " << loc.shelf << ' ' << loc.comp;
+    if (loc.checkedOut) line << " out " << loc.person << ' ' << loc.dueDate;
+    line << ' ' << *loc.item << '\n';
+    out += line.str();
+}
+
+void appendLocations(string &out, const vector<ItemLocation> &locs) {
+    out += "ok " + to_string(locs.size()) + '\n';
+    for (const ItemLocation &loc : locs) appendLocation(out, loc);
+}
+
+} // namespace
+
+double BatchResult::commandsPerSecond() const {
+    return seconds > 0 ? static_cast<double>(commands) / seconds : 0.0;
+}
+
+CommandProcessor::CommandProcessor(LibraryStorage &lib_, Journal *journal_)
+    : lib(lib_), journal(journal_) {}
+
+bool CommandProcessor::execute(string_view line, string &out) {
+    if (!splitWords(line, words)) return fail(out, "unterminated quote");
+    if (words.empty() || words[0][0] == '#') return true;
+
+    return dispatch(out);
+}
+
+bool CommandProcessor::dispatch(string &out) {
+    const string &cmd = words[0];
+
+    if (cmd == "add") return addCommand(out);
+    if (cmd == "remove" || cmd == "checkout" || cmd == "checkin" || cmd == "swap"
+        || cmd == "move") {
+        return locationCommand(cmd, out);
+    }
+    if (cmd == "find" || cmd == "search" || cmd == "overdue" || cmd == "loans"
+        || cmd == "stats" || cmd == "opstats") {
+        return queryCommand(cmd, out);
+    }
+    if (cmd == "hold" || cmd == "unhold" || cmd == "pickups") return holdCommand(cmd, out);
+    if (cmd == "addshelf") {
+        if (tx) return fail(out, "addshelf is not allowed in a transaction");
+        size_t capacity = Shelf::DEFAULT_CAPACITY;
+        if (words.size() > 2 || (words.size() == 2 && !parseNumber(words[1], capacity))) {
+            return fail(out, "usage: addshelf [capacity]");
+        }
+        Result<size_t> idx = lib.addShelf(capacity);
+        if (!idx) return fail(out, "invalid shelf capacity");
+        out += "ok " + to_string(*idx) + '\n';
+        return true;
+    }
+    if (cmd == "begin") {
+        if (tx) return fail(out, "a transaction is already open");
+        tx.emplace();
+        return ok(out);
+    }
+    if (cmd == "commit" || cmd == "abort") {
+        if (!tx) return fail(out, "no transaction is open");
+        if (cmd == "abort") {
+            tx.reset();
+            return ok(out);
+        }
+        Result<void, IngestError> done = lib.commit(*tx);
+        tx.reset();
+        if (!done) {
+            return fail(out, "step " + to_string(done.error().row) + ": " + done.error().message);
+        }
+        return ok(out);
+    }
+    return fail(out, "unknown command \"" + cmd + "\"");
+}
+
+bool CommandProcessor::addCommand(string &out) {
+    static const char *usage = "usage: add book|movie|magazine <shelf|*> <comp> <id> ...";
+    if (words.size() < 5) return fail(out, usage);
+    const string &type = words[1];
+    size_t fields = type == "book" || type == "movie" ? 10 : type == "magazine" ? 9 : 0;
+    if (words.size() != fields) return fail(out, usage);
+
+    bool anywhere = words[2] == "*";
+    size_t shelf = 0, comp = 0;
+    int id = 0;
+    if ((!anywhere && (!parseIndex(words[2], shelf) || !parseIndex(words[3], comp)))
+        || !parseNumber(words[4], id)) {
+        return fail(out, "invalid location or id");
+    }
+    if (anywhere && tx) return fail(out, "a transaction needs a fixed location");
+
+    ItemArena::Scope scope(lib.itemArena());
+    unique_ptr<Item> item;
+    if (type == "book") {
+        item = make_unique<Book>(words[5], words[6], id, words[7], words[8], words[9]);
+    } else if (type == "movie") {
+        item = make_unique<Movie>(words[5], words[6], id, words[7], words[8],
+                                  splitActors(words[9]));
+    } else {
+        item = make_unique<Magazine>(words[5], words[6], id, words[7], words[8]);
+    }
+
+    if (tx) {
+        tx->addItem(move(item), shelf, comp);
+        return ok(out);
+    }
+    if (anywhere) {
+        Result<ShelfSlot> slot = lib.addItemAnywhere(move(item));
+        if (!slot) return fail(out, slot.error());
+        out += "ok " + to_string(slot->shelf) + ' ' + to_string(slot->comp) + '\n';
+        return true;
+    }
+    Result<void> added = lib.addItem(move(item), shelf, comp);
+    return added ? ok(out) : fail(out, added.error());
+}
+
+bool CommandProcessor::locationCommand(const string &cmd, string &out) {
+    size_t argc = cmd == "swap" || cmd == "move" || cmd == "checkout" ? 5 : 3;
+    if (words.size() != argc) return fail(out, "wrong number of arguments for " + cmd);
+    size_t s1 = 0, c1 = 0, s2 = 0, c2 = 0;
+    if (!parseIndex(words[1], s1) || !parseIndex(words[2], c1)) {
+        return fail(out, "invalid location");
+    }
+    if ((cmd == "swap" || cmd == "move")
+        && (!parseIndex(words[3], s2) || !parseIndex(words[4], c2))) {
+        return fail(out, "invalid location");
+    }
+
+    if (tx) {
+        if (cmd == "remove") {
+            tx->removeItem(s1, c1);
+        } else if (cmd == "checkout") {
+            tx->checkoutItem(s1, c1, move(words[3]), move(words[4]));
+        } else if (cmd == "checkin") {
+            tx->checkinItem(s1, c1);
+        } else if (cmd == "move") {
+            tx->moveItem(s1, c1, s2, c2);
+        } else {
+            return fail(out, "swap is not allowed in a transaction");
+        }
+        return ok(out);
+    }
+
+    Result<void> done;
+    if (cmd == "remove") {
+        done = lib.removeItem(s1, c1);
+    } else if (cmd == "checkout") {
+        done = lib.checkoutItem(s1, c1, move(words[3]), move(words[4]));
+    } else if (cmd == "checkin") {
+        done = lib.checkinItem(s1, c1);
+        optional<string_view> holder = done ? lib.pickupFor(s1, c1) : nullopt;
+        if (holder) {
+            out += "ok for ";
+            out += *holder;
+            out += '\n';
+            return true;
+        }
+    } else if (cmd == "swap") {
+        done = lib.swapItems(s1, c1, s2, c2);
+    } else {
+        done = lib.moveItem(s1, c1, s2, c2);
+    }
+    return done ? ok(out) : fail(out, done.error());
+}
+
+bool CommandProcessor::holdCommand(const string &cmd, string &out) {
+    if (tx) return fail(out, cmd + " is not allowed in a transaction");
+    if (cmd == "pickups") {
+        if (words.size() != 1) return fail(out, "usage: pickups");
+        vector<ItemLocation> waiting = lib.awaitingPickup();
+        out += "ok " + to_string(waiting.size()) + '\n';
+        for (const ItemLocation &loc : waiting) {
+            ostringstream line;
+            line << "  " << loc.shelf << ' ' << loc.comp << " for " << loc.person << ' '
+                 << *loc.item << '\n';
+            out += line.str();
+        }
+        return true;
+    }
+    size_t shelf = 0, comp = 0;
+    if (words.size() != 4) return fail(out, "usage: " + cmd + " <shelf> <comp> <person>");
+    if (!parseIndex(words[1], shelf) || !parseIndex(words[2], comp)) {
+        return fail(out, "invalid location");
+    }
+    if (cmd == "unhold") {
+        Result<void> done = lib.cancelHold(shelf, comp, words[3]);
+        return done ? ok(out) : fail(out, done.error());
+    }
+    Result<size_t> position = lib.placeHold(shelf, comp, move(words[3]));
+    if (!position) return fail(out, position.error());
+    out += "ok " + to_string(*position) + '\n';
+    return true;
+}
+
+bool CommandProcessor::queryCommand(const string &cmd, string &out) {
+    if (cmd == "find") {
+        int id = 0;
+        if (words.size() != 2 || !parseNumber(words[1], id)) return fail(out, "usage: find <id>");
+        optional<ItemLocation> loc = lib.findById(id);
+        if (!loc) return fail(out, "no item with id " + words[1]);
+        out += "ok\n";
+        appendLocation(out, *loc);
+        return true;
+    }
+    if (cmd == "search") {
+        string query;
+        for (size_t i = 1; i < words.size(); ++i) (query += words[i]) += ' ';
+        vector<SearchResult> results = lib.search(query);
+        out += "ok " + to_string(results.size()) + '\n';
+        for (const SearchResult &r : results) appendLocation(out, r.location);
+        return true;
+    }
+    if (cmd == "overdue") {
+        int32_t day = todayDueDay();
+        if (words.size() > 2) return fail(out, "usage: overdue [YYYY-MM-DD]");
+        if (words.size() == 2) {
+            optional<int32_t> parsed = parseDueDay(words[1]);
+            if (!parsed) return fail(out, "not a date: " + words[1]);
+            day = *parsed;
+        }
+        appendLocations(out, lib.overdueLoans(day));
+        return true;
+    }
+    if (cmd == "loans") {
+        if (words.size() != 2) return fail(out, "usage: loans <person>");
+        appendLocations(out, lib.loansOf(words[1]));
+        return true;
+    }
+    if (cmd == "opstats") {
+        StorageStatsSnapshot stats = collectStorageStats();
+        if (!stats.enabled) return fail(out, "operation statistics are not compiled in");
+        ostringstream lines;
+        writeStorageStats(lines, stats, "  ");
+        out += "ok threads " + to_string(stats.threads) + '\n';
+        out += lines.str();
+        return true;
+    }
+    OccupancyStats stats = lib.occupancyStats();
+    out += "ok shelves " + to_string(stats.shelves) + " compartments "
+           + to_string(stats.compartments) + " used " + to_string(stats.used) + " full "
+           + to_string(stats.fullShelves) + " empty " + to_string(stats.emptyShelves) + '\n';
+    return true;
+}
+
+BatchResult CommandProcessor::run(istream &in, ostream &out, size_t batchSize) {
+    BatchResult result;
+    if (batchSize == 0) batchSize = 1;
+    auto start = chrono::steady_clock::now();
+
+    // Two-stage pipeline: the reader thread fills the next batch of lines
+    // while this thread executes the current one. At most two batches wait.
+    mutex m;
+    condition_variable cv;
+    deque<vector<string>> ready;
+    bool eof = false;
+    thread reader([&] {
+        vector<string> batch;
+        string line;
+        while (true) {
+            bool more = static_cast<bool>(getline(in, line));
+            if (more) batch.push_back(move(line));
+            if (batch.size() == batchSize || (!more && !batch.empty())) {
+                unique_lock<mutex> lock(m);
+                cv.wait(lock, [&] { return ready.size() < 2; });
+                ready.push_back(move(batch));
+                batch.clear();
+                cv.notify_all();
+            }
+            if (!more) break;
+        }
+        lock_guard<mutex> lock(m);
+        eof = true;
+        cv.notify_all();
+    });
+
+    string replies;
+    while (true) {
+        vector<string> batch;
+        {
+            unique_lock<mutex> lock(m);
+            cv.wait(lock, [&] { return !ready.empty() || eof; });
+            if (ready.empty()) break;
+            batch = move(ready.front());
+            ready.pop_front();
+            cv.notify_all();
+        }
+        if (result.unsynced) continue;  // drain the reader
+        replies.clear();
+        for (const string &line : batch) {
+            size_t before = replies.size();
+            bool done = execute(line, replies);
+            if (replies.size() == before) continue;  // blank or comment
+            ++result.commands;
+            if (!done) ++result.failed;
+        }
+        // Replies promise their changes are durable; without the sync they
+        // would be a lie, so none are written from here on.
+        if (journal && journal->isOpen() && !journal->sync()) {
+            result.unsynced = true;
+            continue;
+        }
+        out.write(replies.data(), static_cast<streamsize>(replies.size()));
+        out.flush();
+    }
+    reader.join();
+    tx.reset();
+
+    result.seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    return result;
+}
@@ -0,0 +1,106 @@
+#pragma once
+#include "LibraryStorage.h"
+#include <istream>
+#include <optional>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+/*
+ * File: CommandProcessor.h
+ * ------------------------
+ * Non-interactive driver for LibraryStorage. Reads one command per line,
+ * with no prompts, so a day's desk traffic can be replayed from a file or
+ * piped in from another program.
+ *
+ * Words are separated by blanks. A word may be double-quoted to include
+ * blanks, with "" for a quote. Blank lines and lines starting with '#'
+ * are skipped.
+ *
+ *   add book     <shelf|*> <comp> <id> <name> <description> <title> <author> <copyright>
+ *   add movie    <shelf|*> <comp> <id> <name> <description> <title> <director> <actors>
+ *   add magazine <shelf|*> <comp> <id> <name> <description> <edition> <mainArticle>
+ *   remove   <shelf> <comp>
+ *   checkout <shelf> <comp> <person> <due date>
+ *   checkin  <shelf> <comp>             (replies "ok for <person>" if a holder is next)
+ *   swap     <shelf> <comp> <shelf> <comp>
+ *   move     <shelf> <comp> <shelf> <comp>
+ *   hold     <shelf> <comp> <person>    (replies "ok <place in queue>")
+ *   unhold   <shelf> <comp> <person>
+ *   pickups  (items set aside for a holder)
+ *   addshelf [capacity]
+ *   find     <id>
+ *   search   <words...>
+ *   overdue  [YYYY-MM-DD]
+ *   loans    <person>
+ *   stats
+ *   opstats  (per-operation counts and latencies, see StorageStats.h)
+ *   begin | commit | abort
+ *
+ * Shelf and compartment numbers are decimal; one too large for any
+ * storage is refused as "invalid location" before it reaches the storage.
+ * Movie actors are separated by ';'. A shelf of '*' stores the item in
+ * the first free compartment. Between begin and commit, add (at a fixed
+ * location), remove, checkout, checkin and move are collected into one
+ * LibraryStorage::Transaction and applied all-or-nothing by commit.
+ *
+ * Every command appends a reply whose first line starts with "ok" or
+ * "error: <reason>"; lookups follow it with one indented line per result.
+ * A refused storage operation's reason is its storageErrorName.
+ *
+ * run() reads the next batch of lines on a second thread while the
+ * current batch executes. Each batch's replies are written with one call
+ * and the journal, if any, is synced once per batch, before the replies.
+ * If that sync fails, the batch is not acknowledged: its replies are
+ * dropped and the rest of the input is read but not executed.
+ *
+ * Data Table (identifier | datatype | use)
+ * ----------------------------------------------------------------------
+ * BatchResult   | struct                                     | Summary of one run
+ * commands      | size_t                                     | Command lines executed
+ * failed        | size_t                                     | Commands whose reply was an error
+ * unsynced      | bool                                       | A journal sync failed; run stopped
+ * seconds       | double                                     | Wall time of the run
+ * lib           | LibraryStorage&                            | Storage the commands act on
+ * journal       | Journal*                                   | Synced after each batch; may be null
+ * tx            | std::optional<LibraryStorage::Transaction> | Steps since begin
+ * words         | std::vector<std::string>                   | Scratch: words of the current line
+ *
+ */
+
+struct BatchResult {
+    size_t commands = 0;
+    size_t failed = 0;
+    bool unsynced = false;
+    double seconds = 0.0;
+
+    double commandsPerSecond() const;
+};
+
+class Journal;
+
+class CommandProcessor {
+    LibraryStorage &lib;
+    Journal *journal;
+    std::optional<LibraryStorage::Transaction> tx;
+    std::vector<std::string> words;
+
+    bool dispatch(std::string &out);
+    bool addCommand(std::string &out);
+    bool locationCommand(const std::string &cmd, std::string &out);
+    bool holdCommand(const std::string &cmd, std::string &out);
+    bool queryCommand(const std::string &cmd, std::string &out);
+
+public:
+    explicit CommandProcessor(LibraryStorage &lib, Journal *journal = nullptr);
+
+    // Execute one line and append its reply to out. Returns false if the
+    // reply is an error. Blank and comment lines append nothing.
+    bool execute(std::string_view line, std::string &out);
+
+    // Execute every line of in, writing replies to out batchSize lines at
+    // a time. A transaction still open at the end is abandoned. Stops
+    // answering at the first batch whose journal sync fails (unsynced).
+    BatchResult run(std::istream &in, std::ostream &out, size_t batchSize = 4096);
+};
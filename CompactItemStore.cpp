@@ -0,0 +1,228 @@
+#include "CompactItemStore.h"
+#include "LibraryStorage.h"
+#include <algorithm>
+#include <utility>
+
+using namespace std;
+
+/*
+ * File: CompactItemStore.cpp
+ * --------------------------
+ * Implements the type-segregated item store declared in
+ * CompactItemStore.h. Error reporting mirrors LibraryStorage.
+ */
+
+ItemHandle ItemHandle::make(ItemType type, uint32_t index) {
+    return ItemHandle{(static_cast<uint32_t>(type) << INDEX_BITS) | (index & INDEX_MASK)};
+}
+
+// ------------------ Printing ------------------
+
+ostream &operator<<(ostream &os, const BookRecord &r) {
+    return os << "Book[id=" << r.id
+              << ", name=\"" << r.name << "\""
+              << ", title=\"" << r.title << "\""
+              << ", author=\"" << r.author << "\""
+              << ", copyright=\"" << r.copyrightDate << "\""
+              << ", desc=\"" << r.description << "\"]";
+}
+
+ostream &operator<<(ostream &os, const MovieRecord &r) {
+    os << "Movie[id=" << r.id
+       << ", name=\"" << r.name << "\""
+       << ", title=\"" << r.title << "\""
+       << ", director=\"" << r.director << "\""
+       << ", actors=[";
+    for (size_t i = 0; i < r.mainActors.size(); ++i) {
+        if (i) os << ", ";
+        os << r.mainActors[i];
+    }
+    return os << "], desc=\"" << r.description << "\"]";
+}
+
+ostream &operator<<(ostream &os, const MagazineRecord &r) {
+    return os << "Magazine[id=" << r.id
+              << ", name=\"" << r.name << "\""
+              << ", edition=\"" << r.edition << "\""
+              << ", mainArticle=\"" << r.mainArticleTitle << "\""
+              << ", desc=\"" << r.description << "\"]";
+}
+
+// ------------------ CompactItemStore ------------------
+
+CompactItemStore::CompactItemStore(size_t numShelves, size_t shelfCapacity)
+    : shelfCap(shelfCapacity), comps(numShelves * shelfCap) {}
+
+CompactItemStore CompactItemStore::fromStorage(const LibraryStorage &lib) {
+    size_t cap = 1;
+    for (size_t s = 0; s < lib.numShelves(); ++s) cap = max(cap, lib[s].capacity());
+    CompactItemStore store(lib.numShelves(), cap);
+    for (const ItemLocation &loc : lib.items()) store.addItem(*loc.item, loc.shelf, loc.comp);
+    return store;
+}
+
+size_t CompactItemStore::numShelves() const { return comps.size() / shelfCap; }
+size_t CompactItemStore::shelfCapacity() const { return shelfCap; }
+size_t CompactItemStore::size() const { return books.size() + movies.size() + magazines.size(); }
+
+void CompactItemStore::reserve(size_t numBooks, size_t numMovies, size_t numMagazines) {
+    books.reserve(numBooks);
+    movies.reserve(numMovies);
+    magazines.reserve(numMagazines);
+}
+
+bool CompactItemStore::checkSlot(size_t shelfIdx, size_t compIdx, bool wantOccupied) const {
+    if (shelfIdx >= numShelves()) {
+        cerr << "Error: Shelf " << shelfIdx << " does not exist.\n";
+        return false;
+    }
+    if (compIdx >= shelfCap) {
+        cerr << "Error: Compartment index out of range\n";
+        return false;
+    }
+    bool occupied = !comps[shelfIdx * shelfCap + compIdx].empty();
+    if (occupied && !wantOccupied) {
+        cerr << "Error: Compartment " << compIdx << " on shelf " << shelfIdx
+             << " is already occupied.\n";
+        return false;
+    }
+    if (!occupied && wantOccupied) {
+        cerr << "Error: Compartment (" << shelfIdx << ", " << compIdx << ") is empty.\n";
+        return false;
+    }
+    return true;
+}
+
+bool CompactItemStore::addBook(BookRecord rec, size_t shelfIdx, size_t compIdx) {
+    if (!checkSlot(shelfIdx, compIdx, false)) return false;
+    rec.slot = static_cast<uint32_t>(shelfIdx * shelfCap + compIdx);
+    comps[rec.slot] = ItemHandle::make(ItemType::Book, static_cast<uint32_t>(books.size()));
+    books.push_back(move(rec));
+    return true;
+}
+
+bool CompactItemStore::addMovie(MovieRecord rec, size_t shelfIdx, size_t compIdx) {
+    if (!checkSlot(shelfIdx, compIdx, false)) return false;
+    rec.slot = static_cast<uint32_t>(shelfIdx * shelfCap + compIdx);
+    comps[rec.slot] = ItemHandle::make(ItemType::Movie, static_cast<uint32_t>(movies.size()));
+    movies.push_back(move(rec));
+    return true;
+}
+
+bool CompactItemStore::addMagazine(MagazineRecord rec, size_t shelfIdx, size_t compIdx) {
+    if (!checkSlot(shelfIdx, compIdx, false)) return false;
+    rec.slot = static_cast<uint32_t>(shelfIdx * shelfCap + compIdx);
+    comps[rec.slot] = ItemHandle::make(ItemType::Magazine,
+                                       static_cast<uint32_t>(magazines.size()));
+    magazines.push_back(move(rec));
+    return true;
+}
+
+bool CompactItemStore::addItem(const Item &item, size_t shelfIdx, size_t compIdx) {
+    switch (item.type()) {
+        case ItemType::Book: {
+            const auto &b = static_cast<const Book &>(item);
+            return addBook({b.getId(), 0, string(b.getName()), string(b.getDescription()),
+                            string(b.getTitle()), string(b.getAuthor()),
+                            string(b.getCopyrightDate())},
+                           shelfIdx, compIdx);
+        }
+        case ItemType::Movie: {
+            const auto &m = static_cast<const Movie &>(item);
+            const auto &actors = m.getMainActors();
+            return addMovie({m.getId(), 0, string(m.getName()), string(m.getDescription()),
+                             string(m.getTitle()), string(m.getDirector()),
+                             vector<string>(actors.begin(), actors.end())},
+                            shelfIdx, compIdx);
+        }
+        case ItemType::Magazine: {
+            const auto &m = static_cast<const Magazine &>(item);
+            return addMagazine({m.getId(), 0, string(m.getName()), string(m.getDescription()),
+                                string(m.getEdition()), string(m.getMainArticleTitle())},
+                               shelfIdx, compIdx);
+        }
+        case ItemType::Item:
+            break;
+    }
+    cerr << "Error: Only Book, Movie and Magazine items can be stored compactly.\n";
+    return false;
+}
+
+template <typename R>
+void CompactItemStore::eraseRecord(vector<R> &records, uint32_t index) {
+    if (index + 1 != records.size()) {
+        records[index] = move(records.back());
+        ItemHandle &moved = comps[records[index].slot];
+        moved = ItemHandle::make(moved.type(), index);
+    }
+    records.pop_back();
+}
+
+bool CompactItemStore::removeItem(size_t shelfIdx, size_t compIdx) {
+    if (!checkSlot(shelfIdx, compIdx, true)) return false;
+    ItemHandle &h = comps[shelfIdx * shelfCap + compIdx];
+    switch (h.type()) {
+        case ItemType::Book:
+            eraseRecord(books, h.index());
+            break;
+        case ItemType::Movie:
+            eraseRecord(movies, h.index());
+            break;
+        default:
+            eraseRecord(magazines, h.index());
+            break;
+    }
+    h = ItemHandle{};
+    return true;
+}
+
+uint32_t &CompactItemStore::slotOf(ItemHandle h) {
+    switch (h.type()) {
+        case ItemType::Book:
+            return books[h.index()].slot;
+        case ItemType::Movie:
+            return movies[h.index()].slot;
+        default:
+            return magazines[h.index()].slot;
+    }
+}
+
+bool CompactItemStore::swapItems(size_t s1, size_t c1, size_t s2, size_t c2) {
+    if (s1 >= numShelves() || s2 >= numShelves()) {
+        cerr << "Error: One of the shelves does not exist.\n";
+        return false;
+    }
+    if (c1 >= shelfCap || c2 >= shelfCap) {
+        cerr << "Error: Compartment index out of range\n";
+        return false;
+    }
+    uint32_t a = static_cast<uint32_t>(s1 * shelfCap + c1);
+    uint32_t b = static_cast<uint32_t>(s2 * shelfCap + c2);
+    if (comps[a].empty() || comps[b].empty()) {
+        cerr << "Error: Both compartments must contain an item to swap.\n";
+        return false;
+    }
+    swap(comps[a], comps[b]);
+    slotOf(comps[a]) = a;
+    slotOf(comps[b]) = b;
+    return true;
+}
+
+ItemHandle CompactItemStore::handleAt(size_t shelfIdx, size_t compIdx) const {
+    if (shelfIdx >= numShelves() || compIdx >= shelfCap) return ItemHandle{};
+    return comps[shelfIdx * shelfCap + compIdx];
+}
+
+void CompactItemStore::printItemsInStorage(ostream &os) const {
+    os << "Items currently in storage:\n";
+    bool any = false;
+
+    forEachItem([&](size_t s, size_t c, const auto &rec) {
+        any = true;
+        os << "  Shelf " << s << ", Compartment " << c << ": " << rec << "\n";
+    });
+
+    if (!any) {
+        os << "  (none)\n";
+    }
+}
@@ -0,0 +1,169 @@
+#pragma once
+#include "Item.h"
+#include "LibraryStorage.h"
+#include <cstdint>
+#include <iostream>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+/*
+ * File: CompactItemStore.h
+ * ------------------------
+ * Alternative, cache-friendly storage backend for shelf contents. Books,
+ * Movies and Magazines are kept by value in three contiguous arrays, one
+ * per type, instead of one heap object per item. A compartment holds a
+ * 4-byte ItemHandle (type + array index), and visit() dispatches on the
+ * handle's type instead of a virtual call.
+ *
+ * Removal moves the last record of the same type into the hole, so each
+ * array stays dense and a filtered scan (forEach<BookRecord>) is a plain
+ * linear walk. Every record remembers its compartment so the handle of
+ * the moved record can be fixed up.
+ *
+ * Data Table (identifier | datatype | use)
+ * ----------------------------------------------------------------------
+ * BookRecord     | struct                     | Book fields + owning slot
+ * MovieRecord    | struct                     | Movie fields + owning slot
+ * MagazineRecord | struct                     | Magazine fields + owning slot
+ * ItemHandle     | struct                     | 2-bit type + 30-bit index, or empty
+ * books          | std::vector<BookRecord>    | All stored books, dense
+ * movies         | std::vector<MovieRecord>   | All stored movies, dense
+ * magazines      | std::vector<MagazineRecord>| All stored magazines, dense
+ * comps          | std::vector<ItemHandle>    | Handle per compartment, shelf-major
+ * shelfCap       | size_t                     | Compartments per shelf (uniform)
+ *
+ */
+
+struct BookRecord {
+    int id;
+    uint32_t slot;
+    std::string name;
+    std::string description;
+    std::string title;
+    std::string author;
+    std::string copyrightDate;
+};
+
+struct MovieRecord {
+    int id;
+    uint32_t slot;
+    std::string name;
+    std::string description;
+    std::string title;
+    std::string director;
+    std::vector<std::string> mainActors;
+};
+
+struct MagazineRecord {
+    int id;
+    uint32_t slot;
+    std::string name;
+    std::string description;
+    std::string edition;
+    std::string mainArticleTitle;
+};
+
+struct ItemHandle {
+    static constexpr uint32_t EMPTY = ~uint32_t{0};
+    static constexpr uint32_t INDEX_BITS = 30;
+    static constexpr uint32_t INDEX_MASK = (uint32_t{1} << INDEX_BITS) - 1;
+
+    uint32_t bits = EMPTY;
+
+    static ItemHandle make(ItemType type, uint32_t index);
+    bool empty() const { return bits == EMPTY; }
+    ItemType type() const { return static_cast<ItemType>(bits >> INDEX_BITS); }
+    uint32_t index() const { return bits & INDEX_MASK; }
+};
+
+// Same text as the corresponding Item::print.
+std::ostream &operator<<(std::ostream &os, const BookRecord &r);
+std::ostream &operator<<(std::ostream &os, const MovieRecord &r);
+std::ostream &operator<<(std::ostream &os, const MagazineRecord &r);
+
+class CompactItemStore {
+    size_t shelfCap;
+    std::vector<ItemHandle> comps;
+    std::vector<BookRecord> books;
+    std::vector<MovieRecord> movies;
+    std::vector<MagazineRecord> magazines;
+
+    bool checkSlot(size_t shelfIdx, size_t compIdx, bool wantOccupied) const;
+    uint32_t &slotOf(ItemHandle h);
+    template <typename R>
+    void eraseRecord(std::vector<R> &records, uint32_t index);
+
+public:
+    explicit CompactItemStore(size_t numShelves = 3,
+                              size_t shelfCapacity = Shelf::DEFAULT_CAPACITY);
+
+    // Copy every item currently on lib's shelves (loans are not included).
+    // Every shelf gets the capacity of lib's largest one.
+    static CompactItemStore fromStorage(const LibraryStorage &lib);
+
+    size_t numShelves() const;
+    size_t shelfCapacity() const;
+    size_t size() const;
+    void reserve(size_t numBooks, size_t numMovies, size_t numMagazines);
+
+    bool addBook(BookRecord rec, size_t shelfIdx, size_t compIdx);
+    bool addMovie(MovieRecord rec, size_t shelfIdx, size_t compIdx);
+    bool addMagazine(MagazineRecord rec, size_t shelfIdx, size_t compIdx);
+    // Convert a polymorphic Item (plain Item objects are not supported).
+    bool addItem(const Item &item, size_t shelfIdx, size_t compIdx);
+
+    bool removeItem(size_t shelfIdx, size_t compIdx);
+    bool swapItems(size_t s1, size_t c1, size_t s2, size_t c2);
+
+    // Handle for a compartment; empty() if there is no item or no such slot.
+    ItemHandle handleAt(size_t shelfIdx, size_t compIdx) const;
+
+    // Call v with the record the handle refers to. The handle must be valid.
+    template <typename V>
+    decltype(auto) visit(ItemHandle h, V &&v) const;
+
+    // Full scan in shelf/compartment order: fn(shelf, comp, record).
+    template <typename F>
+    void forEachItem(F &&fn) const;
+
+    // Filtered scan over one type, in storage order: fn(record).
+    template <typename R, typename F>
+    void forEach(F &&fn) const;
+
+    void printItemsInStorage(std::ostream &os = std::cout) const;
+};
+
+template <typename V>
+decltype(auto) CompactItemStore::visit(ItemHandle h, V &&v) const {
+    switch (h.type()) {
+        case ItemType::Book:
+            return v(books[h.index()]);
+        case ItemType::Movie:
+            return v(movies[h.index()]);
+        default:
+            return v(magazines[h.index()]);
+    }
+}
+
+template <typename F>
+void CompactItemStore::forEachItem(F &&fn) const {
+    for (size_t i = 0; i < comps.size(); ++i) {
+        if (comps[i].empty()) continue;
+        size_t s = i / shelfCap;
+        size_t c = i % shelfCap;
+        visit(comps[i], [&](const auto &rec) { fn(s, c, rec); });
+    }
+}
+
+template <typename R, typename F>
+void CompactItemStore::forEach(F &&fn) const {
+    if constexpr (std::is_same_v<R, BookRecord>) {
+        for (const BookRecord &r : books) fn(r);
+    } else if constexpr (std::is_same_v<R, MovieRecord>) {
+        for (const MovieRecord &r : movies) fn(r);
+    } else {
+        static_assert(std::is_same_v<R, MagazineRecord>, "unknown record type");
+        for (const MagazineRecord &r : magazines) fn(r);
+    }
+}
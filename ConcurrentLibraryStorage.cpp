@@ -0,0 +1,270 @@
+#include "ConcurrentLibraryStorage.h"
+#include "StorageStats.h"
+#include <algorithm>
+#include <map>
+#include <optional>
+
+using namespace std;
+
+/*
+ * File: ConcurrentLibraryStorage.cpp
+ * ----------------------------------
+ * Implements the per-shelf locked storage declared in
+ * ConcurrentLibraryStorage.h. Validation of indices happens before any
+ * lock is taken; the slot table never changes size, so it can be read
+ * without a lock.
+ */
+
+ConcurrentLibraryStorage::ConcurrentLibraryStorage(size_t numShelves, ReadMode mode)
+    : readMode(mode),
+      shelfCount(numShelves),
+      shelfCap(Shelf::DEFAULT_CAPACITY),
+      slots(make_unique<atomic<Item *>[]>(numShelves * shelfCap)),
+      shelfLocks(make_unique<ShelfLock[]>(numShelves)) {
+    for (size_t i = 0; i < shelfCount * shelfCap; ++i) slots[i].store(nullptr);
+}
+
+ConcurrentLibraryStorage::~ConcurrentLibraryStorage() {
+    for (size_t i = 0; i < shelfCount * shelfCap; ++i) delete slots[i].load();
+}
+
+ConcurrentLibraryStorage::ReadMode ConcurrentLibraryStorage::mode() const { return readMode; }
+size_t ConcurrentLibraryStorage::shelfCapacity() const { return shelfCap; }
+size_t ConcurrentLibraryStorage::numShelves() const { return shelfCount; }
+
+size_t ConcurrentLibraryStorage::numCheckedOut() const {
+    size_t n = 0;
+    for (const LoanStripe &stripe : ledger) {
+        lock_guard<mutex> lock(stripe.m);
+        n += stripe.loans.size();
+    }
+    return n;
+}
+
+ConcurrentLibraryStorage::LoanStripe &ConcurrentLibraryStorage::stripeFor(size_t shelfIdx) {
+    return ledger[shelfIdx % LOAN_STRIPES];
+}
+
+bool ConcurrentLibraryStorage::validLocation(size_t shelfIdx, size_t compIdx) const {
+    return shelfIdx < shelfCount && compIdx < shelfCap;
+}
+
+atomic<Item *> &ConcurrentLibraryStorage::slot(size_t shelfIdx, size_t compIdx) const {
+    return slots[shelfIdx * shelfCap + compIdx];
+}
+
+Result<void> ConcurrentLibraryStorage::addItem(unique_ptr<Item> item, size_t shelfIdx,
+                                               size_t compIdx) {
+    STORAGE_OP_SCOPE(StorageOp::AddItem);
+    if (!validLocation(shelfIdx, compIdx)) return STORAGE_OP_FAIL(StorageError::NoSuchCompartment);
+    lock_guard<mutex> lock(shelfLocks[shelfIdx].m);
+    atomic<Item *> &c = slot(shelfIdx, compIdx);
+    if (c.load(memory_order_relaxed)) return STORAGE_OP_FAIL(StorageError::Occupied);
+    // The compartment of a loaned item is kept for its return.
+    LoanStripe &stripe = stripeFor(shelfIdx);
+    lock_guard<mutex> ledgerLock(stripe.m);
+    if (stripe.loans.count(LoanIndex::makeKey(shelfIdx, compIdx))) {
+        return STORAGE_OP_FAIL(StorageError::Occupied);
+    }
+    c.store(item.release());
+    return {};
+}
+
+Result<void> ConcurrentLibraryStorage::checkoutItem(size_t shelfIdx, size_t compIdx,
+                                                    string person, string dueDate) {
+    STORAGE_OP_SCOPE(StorageOp::CheckoutItem);
+    if (!validLocation(shelfIdx, compIdx)) return STORAGE_OP_FAIL(StorageError::NoSuchCompartment);
+    lock_guard<mutex> lock(shelfLocks[shelfIdx].m);
+    atomic<Item *> &c = slot(shelfIdx, compIdx);
+    if (!c.load(memory_order_relaxed)) return STORAGE_OP_FAIL(StorageError::Empty);
+
+    LoanStripe &stripe = stripeFor(shelfIdx);
+    lock_guard<mutex> ledgerLock(stripe.m);
+    auto [it, inserted] = stripe.loans.try_emplace(LoanIndex::makeKey(shelfIdx, compIdx));
+    if (!inserted) return STORAGE_OP_FAIL(StorageError::AlreadyCheckedOut);
+    // The item stays alive in the ledger, so readers still holding it are safe.
+    it->second = LoanRecord{unique_ptr<Item>(c.exchange(nullptr)), move(person),
+                            move(dueDate)};
+    return {};
+}
+
+Result<void> ConcurrentLibraryStorage::checkinItem(size_t shelfIdx, size_t compIdx) {
+    STORAGE_OP_SCOPE(StorageOp::CheckinItem);
+    if (!validLocation(shelfIdx, compIdx)) return STORAGE_OP_FAIL(StorageError::NoSuchCompartment);
+    lock_guard<mutex> lock(shelfLocks[shelfIdx].m);
+    LoanStripe &stripe = stripeFor(shelfIdx);
+    lock_guard<mutex> ledgerLock(stripe.m);
+
+    auto it = stripe.loans.find(LoanIndex::makeKey(shelfIdx, compIdx));
+    if (it == stripe.loans.end()) return STORAGE_OP_FAIL(StorageError::NotCheckedOut);
+    atomic<Item *> &c = slot(shelfIdx, compIdx);
+    if (c.load(memory_order_relaxed)) return STORAGE_OP_FAIL(StorageError::Occupied);
+    c.store(it->second.item.release());
+    stripe.loans.erase(it);
+    return {};
+}
+
+Result<void> ConcurrentLibraryStorage::removeItem(size_t shelfIdx, size_t compIdx) {
+    STORAGE_OP_SCOPE(StorageOp::RemoveItem);
+    if (!validLocation(shelfIdx, compIdx)) return STORAGE_OP_FAIL(StorageError::NoSuchCompartment);
+    Item *discarded = nullptr;
+    {
+        lock_guard<mutex> lock(shelfLocks[shelfIdx].m);
+        atomic<Item *> &c = slot(shelfIdx, compIdx);
+        if (!c.load(memory_order_relaxed)) return STORAGE_OP_FAIL(StorageError::Empty);
+        discarded = c.exchange(nullptr);
+    }
+    // Lock-free readers may still hold the item; let the epochs decide when
+    // it can go. Locked readers cannot, so it is freed right away.
+    if (readMode == ReadMode::EpochBased) {
+        epochs.retire(discarded);
+    } else {
+        delete discarded;
+    }
+    return {};
+}
+
+Result<void> ConcurrentLibraryStorage::swapItems(size_t s1, size_t c1, size_t s2, size_t c2) {
+    STORAGE_OP_SCOPE(StorageOp::SwapItems);
+    if (!validLocation(s1, c1) || !validLocation(s2, c2)) {
+        return STORAGE_OP_FAIL(StorageError::NoSuchCompartment);
+    }
+
+    // Fixed order: lower shelf index first; a single lock for one shelf.
+    unique_lock<mutex> first(shelfLocks[min(s1, s2)].m);
+    unique_lock<mutex> second;
+    if (s1 != s2) second = unique_lock<mutex>(shelfLocks[max(s1, s2)].m);
+
+    atomic<Item *> &a = slot(s1, c1);
+    atomic<Item *> &b = slot(s2, c2);
+    Item *pa = a.load(memory_order_relaxed);
+    Item *pb = b.load(memory_order_relaxed);
+    if (!pa || !pb) return STORAGE_OP_FAIL(StorageError::Empty);
+    a.store(pb);
+    b.store(pa);
+    return {};
+}
+
+Result<void, IngestError> ConcurrentLibraryStorage::commit(LibraryStorage::Transaction &tx) {
+    STORAGE_OP_SCOPE(StorageOp::Commit);
+    using Transaction = LibraryStorage::Transaction;
+    using Kind = Transaction::Kind;
+
+    // Lock every shelf a step names, then their ledger stripes, each set
+    // in ascending order. Steps naming a location that does not exist are
+    // left for check() to report.
+    vector<size_t> shelfIds, stripeIds;
+    for (const Transaction::Step &step : tx.steps()) {
+        if (step.shelf < shelfCount) shelfIds.push_back(step.shelf);
+        if (step.kind == Kind::Move && step.toShelf < shelfCount) {
+            shelfIds.push_back(step.toShelf);
+        }
+    }
+    sort(shelfIds.begin(), shelfIds.end());
+    shelfIds.erase(unique(shelfIds.begin(), shelfIds.end()), shelfIds.end());
+    for (size_t s : shelfIds) stripeIds.push_back(s % LOAN_STRIPES);
+    sort(stripeIds.begin(), stripeIds.end());
+    stripeIds.erase(unique(stripeIds.begin(), stripeIds.end()), stripeIds.end());
+
+    vector<Item *> discarded;
+    {
+        vector<unique_lock<mutex>> locks;
+        locks.reserve(shelfIds.size() + stripeIds.size());
+        for (size_t s : shelfIds) locks.emplace_back(shelfLocks[s].m);
+        for (size_t t : stripeIds) locks.emplace_back(ledger[t].m);
+
+        auto initial = [this](size_t s, size_t c) -> optional<Transaction::SlotState> {
+            if (!validLocation(s, c)) return nullopt;
+            Transaction::SlotState st;
+            st.item = slot(s, c).load(memory_order_relaxed) != nullptr;
+            st.loan = stripeFor(s).loans.count(LoanIndex::makeKey(s, c)) != 0;
+            return st;
+        };
+        if (optional<IngestError> err = tx.check(initial, nullptr)) {
+            (void)STORAGE_OP_FAIL(StorageError::TransactionStep);
+            return move(*err);
+        }
+
+        for (Transaction::Step &step : tx.ops) {
+            atomic<Item *> &c = slot(step.shelf, step.comp);
+            uint64_t key = LoanIndex::makeKey(step.shelf, step.comp);
+            switch (step.kind) {
+                case Kind::Add:
+                    c.store(step.item.release());
+                    break;
+                case Kind::Remove:
+                    discarded.push_back(c.exchange(nullptr));
+                    break;
+                case Kind::Move:
+                    slot(step.toShelf, step.toComp).store(c.exchange(nullptr));
+                    break;
+                case Kind::Checkout:
+                    stripeFor(step.shelf).loans[key] =
+                        LoanRecord{unique_ptr<Item>(c.exchange(nullptr)), move(step.person),
+                                   move(step.dueDate)};
+                    break;
+                case Kind::Checkin: {
+                    LoanStripe &stripe = stripeFor(step.shelf);
+                    auto it = stripe.loans.find(key);
+                    c.store(it->second.item.release());
+                    stripe.loans.erase(it);
+                    break;
+                }
+            }
+        }
+    }
+    tx.clear();
+
+    // As in removeItem: lock-free readers may still hold removed items.
+    for (Item *item : discarded) {
+        if (readMode == ReadMode::EpochBased) {
+            epochs.retire(item);
+        } else {
+            delete item;
+        }
+    }
+    return {};
+}
+
+void ConcurrentLibraryStorage::printItemsInStorage() const {
+    cout << "Items currently in storage:\n";
+    bool any = false;
+
+    for (size_t s = 0; s < shelfCount; ++s) {
+        for (size_t c = 0; c < shelfCap; ++c) {
+            withItem(s, c, [&](const Item *item) {
+                if (!item) return;
+                any = true;
+                cout << "  Shelf " << s << ", Compartment " << c << ": " << *item << "\n";
+            });
+        }
+    }
+
+    if (!any) {
+        cout << "  (none)\n";
+    }
+}
+
+void ConcurrentLibraryStorage::printCheckedOutItems() const {
+    cout << "Items currently checked out:\n";
+    bool any = false;
+
+    for (const LoanStripe &stripe : ledger) {
+        lock_guard<mutex> lock(stripe.m);
+        // Sort each stripe by location for a stable listing.
+        map<uint64_t, const LoanRecord *> sorted;
+        for (const auto &[key, rec] : stripe.loans) sorted.emplace(key, &rec);
+        for (const auto &[key, rec] : sorted) {
+            any = true;
+            cout << "  From shelf " << LoanIndex::keyShelf(key)
+                 << ", compartment " << LoanIndex::keyComp(key) << ": "
+                 << *rec->item << "\n"
+                 << "    Checked out by: " << rec->person
+                 << " (due: " << rec->dueDate << ")\n";
+        }
+    }
+
+    if (!any) {
+        cout << "  (none)\n";
+    }
+}
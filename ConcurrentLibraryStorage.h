@@ -0,0 +1,138 @@
+#pragma once
+#include "LibraryStorage.h"
+#include "EpochManager.h"
+#include <array>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+/*
+ * File: ConcurrentLibraryStorage.h
+ * --------------------------------
+ * Thread-safe variant of LibraryStorage for several desk terminals
+ * sharing one store. Every shelf has its own mutex, so operations on
+ * different shelves run in parallel. The checked-out ledger is split into
+ * lock-striped hash maps, one stripe per group of shelves.
+ *
+ * Lock order: shelf locks in ascending shelf index, then ledger stripes
+ * in ascending index. Single operations take at most one stripe;
+ * swapItems across two shelves and commit follow the same order, so no
+ * two operations can wait on each other in a cycle.
+ *
+ * Compartments are atomically published Item pointers. Writers always
+ * take the shelf lock. Readers (withItem, printItemsInStorage) follow the
+ * ReadMode chosen at construction:
+ *   Locked     - take the shelf lock, like the writers.
+ *   EpochBased - no lock: pin an epoch, load the pointer, read. Items a
+ *                writer removes are retired to the EpochManager and freed
+ *                only after every reader that could see them has left.
+ * Checkout, checkin and swap move pointers without freeing anything, so
+ * a reader always sees either the old or the new item.
+ *
+ * The number of shelves is fixed at construction.
+ *
+ * Data Table (identifier | datatype | use)
+ * ----------------------------------------------------------------------
+ * ReadMode     | enum class                            | How readers access compartments
+ * slots        | std::unique_ptr<std::atomic<Item*>[]> | Owned item per compartment
+ * shelfCap     | size_t                                | Compartments per shelf
+ * shelfCount   | size_t                                | Number of shelves
+ * epochs       | EpochManager                          | Reclaims items removed by writers
+ * ShelfLock    | struct                                | Cache-line aligned mutex
+ * shelfLocks   | std::unique_ptr<ShelfLock[]>          | One lock per shelf
+ * LoanRecord   | struct                                | A checked-out item
+ * LoanStripe   | struct                                | Mutex + map of loans
+ * ledger       | std::array<LoanStripe, LOAN_STRIPES>  | Checked-out items by location
+ * LOAN_STRIPES | constexpr size_t                      | Number of ledger stripes
+ *
+ */
+
+class ConcurrentLibraryStorage {
+public:
+    enum class ReadMode { Locked, EpochBased };
+
+private:
+    struct alignas(64) ShelfLock {
+        std::mutex m;
+    };
+
+    struct LoanRecord {
+        std::unique_ptr<Item> item;
+        std::string person;
+        std::string dueDate;
+    };
+
+    struct alignas(64) LoanStripe {
+        mutable std::mutex m;
+        std::unordered_map<uint64_t, LoanRecord> loans;
+    };
+
+    static constexpr size_t LOAN_STRIPES = 64;
+
+    ReadMode readMode;
+    size_t shelfCount;
+    size_t shelfCap;
+    std::unique_ptr<std::atomic<Item *>[]> slots;
+    std::unique_ptr<ShelfLock[]> shelfLocks;
+    std::array<LoanStripe, LOAN_STRIPES> ledger;
+    mutable EpochManager epochs;
+
+    LoanStripe &stripeFor(size_t shelfIdx);
+    bool validLocation(size_t shelfIdx, size_t compIdx) const;
+    std::atomic<Item *> &slot(size_t shelfIdx, size_t compIdx) const;
+
+public:
+    explicit ConcurrentLibraryStorage(size_t numShelves = 3,
+                                      ReadMode mode = ReadMode::Locked);
+    ~ConcurrentLibraryStorage();
+    ConcurrentLibraryStorage(const ConcurrentLibraryStorage &) = delete;
+    ConcurrentLibraryStorage &operator=(const ConcurrentLibraryStorage &) = delete;
+
+    ReadMode mode() const;
+    size_t shelfCapacity() const;
+
+    size_t numShelves() const;
+    size_t numCheckedOut() const;
+
+    // Refusals return a StorageError as in LibraryStorage; a location
+    // that does not exist is NoSuchCompartment.
+    Result<void> addItem(std::unique_ptr<Item> item, size_t shelfIdx, size_t compIdx);
+    Result<void> checkoutItem(size_t shelfIdx, size_t compIdx, std::string person,
+                              std::string dueDate);
+    Result<void> checkinItem(size_t shelfIdx, size_t compIdx);
+    Result<void> removeItem(size_t shelfIdx, size_t compIdx);
+    Result<void> swapItems(size_t s1, size_t c1, size_t s2, size_t c2);
+
+    // All-or-nothing, as LibraryStorage::commit (there is no loan limit
+    // here). Every shelf and stripe the steps touch is locked once, up
+    // front. Locked-mode readers see all of the steps or none; EpochBased
+    // readers can see a commit part way through.
+    Result<void, IngestError> commit(LibraryStorage::Transaction &tx);
+
+    // Call fn(const Item *) for the compartment's item (null if empty). The
+    // pointer is valid only inside fn. Returns false if the location does
+    // not exist.
+    template <typename F>
+    bool withItem(size_t shelfIdx, size_t compIdx, F &&fn) const;
+
+    // In Locked mode each shelf (and ledger stripe) is locked in turn, so
+    // the listing is consistent per shelf but not across the whole store.
+    void printItemsInStorage() const;
+    void printCheckedOutItems() const;
+};
+
+template <typename F>
+bool ConcurrentLibraryStorage::withItem(size_t shelfIdx, size_t compIdx, F &&fn) const {
+    if (!validLocation(shelfIdx, compIdx)) return false;
+    if (readMode == ReadMode::EpochBased) {
+        EpochManager::Guard guard = epochs.pin();
+        fn(static_cast<const Item *>(slot(shelfIdx, compIdx).load()));
+    } else {
+        std::lock_guard<std::mutex> lock(shelfLocks[shelfIdx].m);
+        fn(static_cast<const Item *>(slot(shelfIdx, compIdx).load(std::memory_order_relaxed)));
+    }
+    return true;
+}
@@ -0,0 +1,186 @@
+#include "ConcurrentLibraryStorage.h"
+#include "TestCheck.h"
+#include <atomic>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+/*
+ * File: ConcurrentStressTest.cpp
+ * ------------------------------
+ * LibraryCheckout_concurrent_test: multi-threaded stress run of
+ * ConcurrentLibraryStorage (run by ctest), once per ReadMode. Writer
+ * threads check items out and in, swap them across shelves and commit
+ * transactions that move one item and check out another, all at random
+ * locations, while reader threads look at random compartments and list the
+ * whole store. Nothing is added or removed, so afterwards the items on the
+ * shelves plus the loans must still be the items the run started with:
+ * checking every loan back in must leave each id exactly once.
+ *
+ *   LibraryCheckout_concurrent_test [writers] [readers] [ops per writer]
+ *
+ * Data Table (identifier | datatype | use)
+ * ----------------------------------------------------------------------
+ * Config     | struct              | Threads and operations per run
+ * readErrors | std::atomic<size_t> | Reads that saw an item that was never stocked
+ *
+ */
+
+namespace {
+
+struct Config {
+    size_t writers = 4;
+    size_t readers = 4;
+    size_t opsPerWriter = 100000;
+    size_t shelves = 64;
+};
+
+// Compartments in lib; compartment i is (i / capacity, i % capacity).
+size_t compartments(const ConcurrentLibraryStorage &lib) {
+    return lib.numShelves() * lib.shelfCapacity();
+}
+
+void writer(ConcurrentLibraryStorage &lib, uint64_t seed, size_t ops) {
+    mt19937_64 rng(seed);
+    size_t shelves = lib.numShelves(), cap = lib.shelfCapacity();
+    string reader = "Reader " + to_string(seed);
+    LibraryStorage::Transaction tx;
+    for (size_t i = 0; i < ops; ++i) {
+        size_t s = rng() % shelves, c = rng() % cap;
+        size_t s2 = rng() % shelves, c2 = rng() % cap;
+        switch (rng() % 8) {
+            case 0:
+            case 1:
+            case 2:
+                (void)lib.checkoutItem(s, c, reader, "2026-06-01");
+                break;
+            case 3:
+            case 4:
+            case 5:
+                (void)lib.checkinItem(s, c);
+                break;
+            case 6:
+                (void)lib.swapItems(s, c, s2, c2);
+                break;
+            default:
+                // Two shelves and their stripes locked together.
+                tx.moveItem(s, c, s2, c2);
+                tx.checkoutItem(s2, (c2 + 1) % cap, reader, "");
+                (void)lib.commit(tx);
+                tx.clear();
+                break;
+        }
+    }
+}
+
+// lists: also print full listings (to cout, so one reader only).
+void reader(const ConcurrentLibraryStorage &lib, uint64_t seed, int stocked, bool lists,
+            const atomic<bool> &done, atomic<size_t> &readErrors) {
+    mt19937_64 rng(seed);
+    size_t shelves = lib.numShelves(), cap = lib.shelfCapacity();
+    size_t reads = 0;
+    while (!done.load(memory_order_relaxed)) {
+        lib.withItem(rng() % shelves, rng() % cap, [&](const Item *item) {
+            // Touch the strings too: a freed item would not survive this.
+            if (item && (item->getId() < 0 || item->getId() >= stocked
+                         || item->getName() != "Item " + to_string(item->getId()))) {
+                readErrors.fetch_add(1);
+            }
+        });
+        // Now and then a full listing, which visits every compartment.
+        if (lists && ++reads % 20000 == 0) {
+            lib.printItemsInStorage();
+            lib.printCheckedOutItems();
+        }
+    }
+}
+
+void run(ConcurrentLibraryStorage::ReadMode mode, const Config &cfg) {
+    ConcurrentLibraryStorage lib(cfg.shelves, mode);
+    // About 80% full, so moves find free compartments.
+    int stocked = 0;
+    for (size_t i = 0; i < compartments(lib); ++i) {
+        if (i % 5 == 4) continue;
+        CHECK(lib.addItem(make_unique<Book>("Item " + to_string(stocked), "Stress", stocked,
+                                            "Title", "Author", "2000"),
+                          i / lib.shelfCapacity(), i % lib.shelfCapacity()));
+        ++stocked;
+    }
+
+    // The listings go nowhere; cout is only redirected while nothing else
+    // uses it.
+    ostringstream sink;
+    streambuf *saved = cout.rdbuf(sink.rdbuf());
+    atomic<bool> done{false};
+    atomic<size_t> readErrors{0};
+    vector<thread> readers, writers;
+    for (size_t r = 0; r < cfg.readers; ++r) {
+        readers.emplace_back(reader, cref(lib), 1000 + r, stocked, r == 0, cref(done),
+                             ref(readErrors));
+    }
+    for (size_t w = 0; w < cfg.writers; ++w) {
+        writers.emplace_back(writer, ref(lib), w + 1, cfg.opsPerWriter);
+    }
+    for (thread &t : writers) t.join();
+    done = true;
+    for (thread &t : readers) t.join();
+    cout.rdbuf(saved);
+    CHECK(readErrors == 0);
+
+    // Conservation: stored + loaned is what was stocked ...
+    size_t stored = 0;
+    for (size_t i = 0; i < compartments(lib); ++i) {
+        lib.withItem(i / lib.shelfCapacity(), i % lib.shelfCapacity(),
+                     [&](const Item *item) { stored += item != nullptr; });
+    }
+    size_t loaned = lib.numCheckedOut();
+    CHECK(stored + loaned == static_cast<size_t>(stocked));
+
+    // ... and once every loan is back, each id is on a shelf exactly once.
+    size_t returned = 0;
+    for (size_t i = 0; i < compartments(lib); ++i) {
+        if (lib.checkinItem(i / lib.shelfCapacity(), i % lib.shelfCapacity())) ++returned;
+    }
+    CHECK(returned == loaned);
+    // Past the end is refused as it is by LibraryStorage, not mistaken for
+    // a compartment with nothing checked out.
+    for (auto [s, c] : {pair{cfg.shelves, size_t{0}}, pair{size_t{0}, lib.shelfCapacity()}}) {
+        Result<void> r = lib.checkinItem(s, c);
+        CHECK(!r && r.error() == StorageError::NoSuchCompartment);
+    }
+    CHECK(lib.numCheckedOut() == 0);
+    vector<int> seen(static_cast<size_t>(stocked), 0);
+    for (size_t i = 0; i < compartments(lib); ++i) {
+        lib.withItem(i / lib.shelfCapacity(), i % lib.shelfCapacity(), [&](const Item *item) {
+            if (item && item->getId() >= 0 && item->getId() < stocked) {
+                ++seen[static_cast<size_t>(item->getId())];
+            }
+        });
+    }
+    size_t once = 0;
+    for (int n : seen) once += n == 1;
+    CHECK(once == static_cast<size_t>(stocked));
+
+    cout << (mode == ConcurrentLibraryStorage::ReadMode::Locked ? "Locked" : "EpochBased")
+         << ": " << cfg.writers << " writers x " << cfg.opsPerWriter << " ops, "
+         << cfg.readers << " readers; " << stocked << " items, " << loaned
+         << " on loan at the end.\n";
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+    Config cfg;
+    size_t *fields[] = {&cfg.writers, &cfg.readers, &cfg.opsPerWriter};
+    for (int i = 1; i < argc && i <= 3; ++i) *fields[i - 1] = stoul(argv[i]);
+
+    run(ConcurrentLibraryStorage::ReadMode::Locked, cfg);
+    run(ConcurrentLibraryStorage::ReadMode::EpochBased, cfg);
+
+    return testSummary("concurrent stress");
+}
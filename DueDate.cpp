@@ -0,0 +1,126 @@
+#include "DueDate.h"
+#include <charconv>
+#include <ctime>
+
+using namespace std;
+
+/*
+ * File: DueDate.cpp
+ * -----------------
+ * Implements the due-date helpers declared in DueDate.h. The conversions
+ * are the proleptic Gregorian days-from-civil / civil-from-days formulas,
+ * which need no tables and no time zone.
+ */
+
+namespace {
+
+int32_t daysFromCivil(int y, unsigned m, unsigned d) {
+    y -= m <= 2;
+    const int era = (y >= 0 ? y : y - 399) / 400;
+    const unsigned yoe = static_cast<unsigned>(y - era * 400);
+    const unsigned doy = (153 * (m + (m > 2 ? -3 : 9)) + 2) / 5 + d - 1;
+    const unsigned doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+    return era * 146097 + static_cast<int>(doe) - 719468;
+}
+
+struct Civil {
+    int y;
+    unsigned m;
+    unsigned d;
+};
+
+Civil civilFromDays(int32_t day) {
+    const int z = day + 719468;
+    const int era = (z >= 0 ? z : z - 146096) / 146097;
+    const unsigned doe = static_cast<unsigned>(z - era * 146097);
+    const unsigned yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+    const unsigned doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+    const unsigned mp = (5 * doy + 2) / 153;
+    const unsigned d = doy - (153 * mp + 2) / 5 + 1;
+    const unsigned m = mp < 10 ? mp + 3 : mp - 9;
+    return {static_cast<int>(yoe) + era * 400 + (m <= 2), m, d};
+}
+
+bool isLeap(int y) { return (y % 4 == 0 && y % 100 != 0) || y % 400 == 0; }
+
+unsigned daysInMonth(int y, unsigned m) {
+    static const unsigned days[] = {31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31};
+    return m == 2 && isLeap(y) ? 29 : days[m - 1];
+}
+
+bool readDigits(string_view s, size_t pos, size_t count, int &out) {
+    out = 0;
+    for (size_t i = pos; i < pos + count; ++i) {
+        if (s[i] < '0' || s[i] > '9') return false;
+        out = out * 10 + (s[i] - '0');
+    }
+    return true;
+}
+
+// Append value with at least width digits, zero-padded after any sign.
+// to_chars into a buffer sized for any int64_t, so nothing can truncate.
+void appendPadded(string &out, int64_t value, size_t width) {
+    char digits[24];
+    uint64_t magnitude = static_cast<uint64_t>(value);
+    if (value < 0) magnitude = 0 - magnitude;
+    char *end = to_chars(digits, digits + sizeof(digits), magnitude).ptr;
+    size_t len = static_cast<size_t>(end - digits);
+    if (value < 0) out += '-';
+    if (len < width) out.append(width - len, '0');
+    out.append(digits, len);
+}
+
+} // namespace
+
+optional<int32_t> parseDueDay(string_view text) {
+    size_t start = text.find_first_not_of(" \t");
+    if (start == string_view::npos) return nullopt;
+    size_t end = text.find_last_not_of(" \t");
+    text = text.substr(start, end - start + 1);
+
+    int y = 0, m = 0, d = 0;
+    if (text.size() != 10 || text[4] != '-' || text[7] != '-' || !readDigits(text, 0, 4, y)
+        || !readDigits(text, 5, 2, m) || !readDigits(text, 8, 2, d)) {
+        return nullopt;
+    }
+    if (m < 1 || m > 12 || d < 1 || static_cast<unsigned>(d) > daysInMonth(y, m)) {
+        return nullopt;
+    }
+    return daysFromCivil(y, static_cast<unsigned>(m), static_cast<unsigned>(d));
+}
+
+string formatDueDay(int32_t day) {
+    Civil c = civilFromDays(day);
+    string out;
+    out.reserve(10);
+    appendPadded(out, c.y, 4);
+    out += '-';
+    appendPadded(out, c.m, 2);
+    out += '-';
+    appendPadded(out, c.d, 2);
+    return out;
+}
+
+int32_t dueMonth(int32_t day) {
+    Civil c = civilFromDays(day);
+    return c.y * 12 + static_cast<int>(c.m) - 1;
+}
+
+string formatDueMonth(int32_t month) {
+    // Floor division, so months before year 0 still format sensibly.
+    int64_t y = month >= 0 ? month / 12 : (int64_t{month} - 11) / 12;
+    string out;
+    out.reserve(7);
+    appendPadded(out, y, 4);
+    out += '-';
+    appendPadded(out, month - y * 12 + 1, 2);
+    return out;
+}
+
+int32_t todayDueDay() {
+    time_t now = time(nullptr);
+    tm local{};
+    localtime_r(&now, &local);
+    return daysFromCivil(local.tm_year + 1900, static_cast<unsigned>(local.tm_mon + 1),
+                         static_cast<unsigned>(local.tm_mday));
+}
@@ -0,0 +1,38 @@
+#pragma once
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+
+/*
+ * File: DueDate.h
+ * ---------------
+ * Day numbers for due dates. A due date entered as YYYY-MM-DD is turned
+ * into the number of days since 1970-01-01, so comparing two dates is an
+ * integer compare. Other text is still accepted as a due date by the
+ * storage; it just has no day number and never counts as overdue.
+ *
+ * Data Table (identifier | datatype | use)
+ * ----------------------------------------------------------------------
+ * NO_DUE_DAY | constexpr int32_t | Day number of an unparsed due date
+ *
+ */
+
+constexpr int32_t NO_DUE_DAY = INT32_MIN;
+
+// Day number for "YYYY-MM-DD" (surrounding blanks allowed), or nullopt if
+// text is not a valid calendar date in that form.
+std::optional<int32_t> parseDueDay(std::string_view text);
+
+// Day number -> "YYYY-MM-DD".
+std::string formatDueDay(int32_t day);
+
+// Month of a day number as year * 12 + (month - 1), so months sort and
+// subtract as integers.
+int32_t dueMonth(int32_t day);
+
+// Month number from dueMonth -> "YYYY-MM".
+std::string formatDueMonth(int32_t month);
+
+// Today's day number in local time.
+int32_t todayDueDay();
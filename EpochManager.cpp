@@ -0,0 +1,84 @@
+#include "EpochManager.h"
+#include <algorithm>
+#include <functional>
+#include <thread>
+
+using namespace std;
+
+/*
+ * File: EpochManager.cpp
+ * ----------------------
+ * Implements the epoch-based reclamation declared in EpochManager.h. All
+ * epoch and slot accesses are sequentially consistent: a reader that
+ * pins after a retire is ordered after the unlink that preceded it and
+ * therefore cannot load the retired pointer.
+ */
+
+// Retired objects are scanned once this many are pending.
+static constexpr size_t RECLAIM_THRESHOLD = 64;
+
+EpochManager::Guard::Guard(EpochManager &m, size_t s) : mgr(&m), slot(s) {}
+
+EpochManager::Guard::~Guard() {
+    ReaderSlot &r = mgr->readers[slot];
+    r.epoch.store(IDLE);
+    r.inUse.store(false, memory_order_release);
+}
+
+EpochManager::EpochManager() : globalEpoch(1) {}
+
+EpochManager::~EpochManager() {
+    for (const Retired &r : retired) r.deleter(r.obj);
+}
+
+EpochManager::Guard EpochManager::pin() {
+    // Each thread starts from its own preferred slot, so uncontended pins
+    // never share a cache line with another thread.
+    static thread_local size_t hint = hash<thread::id>{}(this_thread::get_id()) % MAX_READERS;
+
+    for (size_t n = 0;; ++n) {
+        size_t i = (hint + n) % MAX_READERS;
+        ReaderSlot &r = readers[i];
+        bool expected = false;
+        if (!r.inUse.load(memory_order_relaxed)
+            && r.inUse.compare_exchange_strong(expected, true, memory_order_acquire)) {
+            hint = i;
+            r.epoch.store(globalEpoch.load());
+            return Guard(*this, i);
+        }
+        // Every slot taken: more pinned readers than MAX_READERS.
+        if (n % MAX_READERS == MAX_READERS - 1) this_thread::yield();
+    }
+}
+
+void EpochManager::retire(void *obj, void (*deleter)(void *)) {
+    lock_guard<mutex> lock(retireMutex);
+    retired.push_back({obj, deleter, globalEpoch.fetch_add(1)});
+    if (retired.size() >= RECLAIM_THRESHOLD) reclaimLocked();
+}
+
+void EpochManager::reclaim() {
+    lock_guard<mutex> lock(retireMutex);
+    reclaimLocked();
+}
+
+void EpochManager::reclaimLocked() {
+    uint64_t oldest = minPinnedEpoch();
+    auto keep = partition(retired.begin(), retired.end(),
+                          [&](const Retired &r) { return r.epoch >= oldest; });
+    for (auto it = keep; it != retired.end(); ++it) it->deleter(it->obj);
+    retired.erase(keep, retired.end());
+}
+
+size_t EpochManager::pendingCount() const {
+    lock_guard<mutex> lock(retireMutex);
+    return retired.size();
+}
+
+uint64_t EpochManager::minPinnedEpoch() const {
+    uint64_t oldest = globalEpoch.load();
+    for (const ReaderSlot &r : readers) {
+        oldest = min(oldest, r.epoch.load());
+    }
+    return oldest;
+}
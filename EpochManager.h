@@ -0,0 +1,91 @@
+#pragma once
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+/*
+ * File: EpochManager.h
+ * --------------------
+ * Epoch-based memory reclamation for lock-free readers. A reader pins
+ * the current epoch for the duration of its read; a writer that unlinks
+ * an object retires it instead of deleting it. A retired object is freed
+ * once every pinned reader has moved past the epoch it was retired in,
+ * so no reader can still hold a pointer to it.
+ *
+ * Readers claim a slot from a fixed table (preferring the same slot on
+ * every call from a thread), so pinning touches only that slot's cache
+ * line and the shared, read-mostly epoch counter.
+ *
+ * Data Table (identifier | datatype | use)
+ * ----------------------------------------------------------------------
+ * MAX_READERS  | constexpr size_t             | Concurrent pinned readers supported
+ * IDLE         | constexpr uint64_t           | Slot epoch value of an unpinned reader
+ * ReaderSlot   | struct                       | Cache-line aligned (inUse, epoch)
+ * globalEpoch  | std::atomic<uint64_t>        | Advanced by every retire
+ * readers      | std::array<ReaderSlot, ...>  | Pinned epochs, one per active reader
+ * Retired      | struct                       | Object, its deleter and retire epoch
+ * retired      | std::vector<Retired>         | Objects waiting to be freed
+ *
+ */
+
+class EpochManager {
+public:
+    static constexpr size_t MAX_READERS = 256;
+
+    // RAII pin; readers may dereference shared pointers while it lives.
+    class Guard {
+        EpochManager *mgr;
+        size_t slot;
+    public:
+        Guard(EpochManager &m, size_t s);
+        ~Guard();
+        Guard(const Guard &) = delete;
+        Guard &operator=(const Guard &) = delete;
+    };
+
+    EpochManager();
+    ~EpochManager();  // frees everything still retired
+    EpochManager(const EpochManager &) = delete;
+    EpochManager &operator=(const EpochManager &) = delete;
+
+    Guard pin();
+
+    // Free obj with deleter once no pinned reader can still see it. The
+    // caller must already have unlinked obj from every shared location.
+    void retire(void *obj, void (*deleter)(void *));
+
+    template <typename T>
+    void retire(T *obj) {
+        retire(obj, [](void *p) { delete static_cast<T *>(p); });
+    }
+
+    // Free every retired object older than all pinned readers.
+    void reclaim();
+
+    size_t pendingCount() const;
+
+private:
+    static constexpr uint64_t IDLE = ~uint64_t{0};
+
+    struct alignas(64) ReaderSlot {
+        std::atomic<bool> inUse{false};
+        std::atomic<uint64_t> epoch{IDLE};
+    };
+
+    struct Retired {
+        void *obj;
+        void (*deleter)(void *);
+        uint64_t epoch;
+    };
+
+    std::atomic<uint64_t> globalEpoch;
+    std::array<ReaderSlot, MAX_READERS> readers;
+
+    mutable std::mutex retireMutex;
+    std::vector<Retired> retired;
+
+    uint64_t minPinnedEpoch() const;
+    void reclaimLocked();  // retireMutex held
+};
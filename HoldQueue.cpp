@@ -0,0 +1,174 @@
+#include "HoldQueue.h"
+
+using namespace std;
+
+/*
+ * File: HoldQueue.cpp
+ * -------------------
+ * Implements the pooled hold queues declared in HoldQueue.h. A location
+ * left with no pickup and no holds is dropped by moving the last queue
+ * into its place, so queues only ever holds locations in use.
+ */
+
+uint32_t HoldQueues::allocNode(uint32_t patron) {
+    uint32_t n = freeNode;
+    if (n != NIL) {
+        freeNode = nodes[n].next;
+        nodes[n] = Node{patron, NIL};
+    } else {
+        n = static_cast<uint32_t>(nodes.size());
+        nodes.push_back(Node{patron, NIL});
+    }
+    return n;
+}
+
+void HoldQueues::freeNodeAt(uint32_t n) {
+    nodes[n].next = freeNode;
+    freeNode = n;
+}
+
+const HoldQueues::Queue *HoldQueues::find(uint64_t key) const {
+    size_t q = queueOf.find(key);
+    return q == LoanIndex::NPOS ? nullptr : &queues[q];
+}
+
+HoldQueues::Queue &HoldQueues::findOrAdd(uint64_t key) {
+    size_t q = queueOf.find(key);
+    if (q != LoanIndex::NPOS) return queues[q];
+    queueOf.insert(key, queues.size());
+    queues.push_back(Queue{key, NIL, NIL, NIL, 0});
+    return queues.back();
+}
+
+uint32_t HoldQueues::popHead(Queue &q) {
+    uint32_t n = q.head;
+    uint32_t patron = nodes[n].patron;
+    q.head = nodes[n].next;
+    if (q.tail == n) q.tail = NIL;
+    freeNodeAt(n);
+    --q.length;
+    --total;
+    return patron;
+}
+
+void HoldQueues::removeIfUnused(size_t q) {
+    if (queues[q].length > 0 || queues[q].pickup != NIL) return;
+    queueOf.erase(queues[q].key);
+    if (q + 1 != queues.size()) {
+        queues[q] = queues.back();
+        queueOf.insert(queues[q].key, q);
+    }
+    queues.pop_back();
+}
+
+void HoldQueues::push(uint64_t key, uint32_t patron) {
+    uint32_t n = allocNode(patron);
+    Queue &q = findOrAdd(key);
+    if (q.length == 0) {
+        q.head = n;
+    } else {
+        nodes[q.tail].next = n;
+    }
+    q.tail = n;
+    ++q.length;
+    ++total;
+}
+
+bool HoldQueues::erase(uint64_t key, uint32_t patron) {
+    size_t qi = queueOf.find(key);
+    if (qi == LoanIndex::NPOS) return false;
+    Queue &q = queues[qi];
+    uint32_t prev = NIL;
+    for (uint32_t n = q.length > 0 ? q.head : NIL; n != NIL; prev = n, n = nodes[n].next) {
+        if (nodes[n].patron != patron) continue;
+        if (prev == NIL) {
+            q.head = nodes[n].next;
+        } else {
+            nodes[prev].next = nodes[n].next;
+        }
+        if (q.tail == n) q.tail = prev;
+        freeNodeAt(n);
+        --q.length;
+        --total;
+        removeIfUnused(qi);
+        return true;
+    }
+    return false;
+}
+
+void HoldQueues::drop(uint64_t key) {
+    size_t qi = queueOf.find(key);
+    if (qi == LoanIndex::NPOS) return;
+    Queue &q = queues[qi];
+    while (q.length > 0) popHead(q);
+    q.pickup = NIL;
+    removeIfUnused(qi);
+}
+
+uint32_t HoldQueues::pickup(uint64_t key) const {
+    const Queue *q = find(key);
+    return q ? q->pickup : NIL;
+}
+
+uint32_t HoldQueues::advance(uint64_t key) {
+    size_t qi = queueOf.find(key);
+    if (qi == LoanIndex::NPOS) return NIL;
+    Queue &q = queues[qi];
+    uint32_t next = q.length > 0 ? popHead(q) : NIL;
+    q.pickup = next;
+    removeIfUnused(qi);
+    return next;
+}
+
+void HoldQueues::setPickup(uint64_t key, uint32_t patron) {
+    if (patron != NIL) {
+        findOrAdd(key).pickup = patron;
+        return;
+    }
+    size_t qi = queueOf.find(key);
+    if (qi == LoanIndex::NPOS) return;
+    queues[qi].pickup = NIL;
+    removeIfUnused(qi);
+}
+
+size_t HoldQueues::position(uint64_t key, uint32_t patron) const {
+    const Queue *q = find(key);
+    if (!q) return 0;
+    size_t pos = 1;
+    for (uint32_t n = q->length > 0 ? q->head : NIL; n != NIL; n = nodes[n].next, ++pos) {
+        if (nodes[n].patron == patron) return pos;
+    }
+    return 0;
+}
+
+size_t HoldQueues::size(uint64_t key) const {
+    const Queue *q = find(key);
+    return q ? q->length : 0;
+}
+
+vector<uint32_t> HoldQueues::holders(uint64_t key) const {
+    vector<uint32_t> result;
+    const Queue *q = find(key);
+    if (!q || q->length == 0) return result;
+    result.reserve(q->length);
+    for (uint32_t n = q->head; n != NIL; n = nodes[n].next) result.push_back(nodes[n].patron);
+    return result;
+}
+
+vector<uint64_t> HoldQueues::keys() const {
+    vector<uint64_t> result;
+    result.reserve(queues.size());
+    for (const Queue &q : queues) result.push_back(q.key);
+    return result;
+}
+
+size_t HoldQueues::size() const { return total; }
+bool HoldQueues::empty() const { return queues.empty(); }
+
+void HoldQueues::clear() {
+    nodes.clear();
+    freeNode = NIL;
+    queues.clear();
+    queueOf.clear();
+    total = 0;
+}
@@ -0,0 +1,94 @@
+#pragma once
+#include "LoanIndex.h"
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/*
+ * File: HoldQueue.h
+ * -----------------
+ * FIFO queues of patrons waiting for an item, one per storage location
+ * (packed the same way as LoanIndex keys), each with the patron the item
+ * is currently set aside for, if any (its pickup). Every queue is an
+ * intrusive singly linked list threaded through one shared node pool: a
+ * hold costs 8 bytes, freed nodes are chained on a free list and reused,
+ * and nothing is allocated per hold once the pool and the table have
+ * grown. Appending, advancing the head to the pickup and the
+ * per-location count are O(1); removing a holder from the middle of a
+ * queue is O(k) in the length of that queue.
+ *
+ * Data Table (identifier | datatype | use)
+ * ----------------------------------------------------------------------
+ * NIL       | constexpr uint32_t    | End of a list / "no patron"
+ * Node      | struct                | One hold: patron id + next node
+ * nodes     | std::vector<Node>     | Node pool shared by every queue
+ * freeNode  | uint32_t              | Head of the list of unused nodes
+ * Queue     | struct                | Pickup, head, tail and length at one location
+ * queues    | std::vector<Queue>    | Locations with a pickup or holds, packed
+ * queueOf   | LoanIndex             | Location key -> position in queues
+ * total     | size_t                | Holds in all queues (pickups not counted)
+ *
+ */
+
+class HoldQueues {
+public:
+    static constexpr uint32_t NIL = UINT32_MAX;
+
+    // Append patron to the queue for key.
+    void push(uint64_t key, uint32_t patron);
+    // Remove patron from key's queue; false if they are not in it.
+    bool erase(uint64_t key, uint32_t patron);
+    // Drop key's pickup and whole queue.
+    void drop(uint64_t key);
+
+    // Patron the item at key is set aside for, or NIL.
+    uint32_t pickup(uint64_t key) const;
+    // Replace key's pickup with the head of its queue (NIL if the queue is
+    // empty) and return the new pickup.
+    uint32_t advance(uint64_t key);
+    // Set key's pickup directly, e.g. when restoring saved state.
+    void setPickup(uint64_t key, uint32_t patron);
+
+    // 1-based place of patron in key's queue, or 0 if absent.
+    size_t position(uint64_t key, uint32_t patron) const;
+    size_t size(uint64_t key) const;
+    // Patrons waiting for key, head first.
+    std::vector<uint32_t> holders(uint64_t key) const;
+    // Keys with a pickup or a non-empty queue, in unspecified order.
+    std::vector<uint64_t> keys() const;
+
+    // Queued holds over all keys.
+    size_t size() const;
+    // True if no key has a pickup or a queue.
+    bool empty() const;
+    void clear();
+
+private:
+    struct Node {
+        uint32_t patron;
+        uint32_t next;
+    };
+
+    struct Queue {
+        uint64_t key;
+        uint32_t pickup;
+        uint32_t head;
+        uint32_t tail;
+        uint32_t length;
+    };
+
+    std::vector<Node> nodes;
+    uint32_t freeNode = NIL;
+    std::vector<Queue> queues;
+    LoanIndex queueOf;
+    size_t total = 0;
+
+    uint32_t allocNode(uint32_t patron);
+    void freeNodeAt(uint32_t n);
+    const Queue *find(uint64_t key) const;
+    Queue &findOrAdd(uint64_t key);
+    // Unlink and free the head of q (q.length > 0); returns its patron.
+    uint32_t popHead(Queue &q);
+    // Forget queues[q] if it has neither a pickup nor holds.
+    void removeIfUnused(size_t q);
+};
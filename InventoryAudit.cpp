@@ -0,0 +1,160 @@
+#include "InventoryAudit.h"
+#include "DueDate.h"
+#include "ThreadPool.h"
+#include <algorithm>
+#include <unordered_map>
+
+using namespace std;
+
+/*
+ * File: InventoryAudit.cpp
+ * ------------------------
+ * Implements the audit declared in InventoryAudit.h. Both entry points
+ * build the same task list and call the same Accumulator code; they only
+ * differ in how many accumulators there are and who runs the tasks.
+ */
+
+namespace {
+
+constexpr size_t SHELVES_PER_TASK = 256;
+constexpr size_t LOANS_PER_TASK = 4096;
+// Also the task count of the duplicate pass; small buckets sort in cache.
+constexpr size_t ID_BUCKETS = 64;
+
+// Bucket in [0, buckets) for an id, from the high bits of a
+// multiplicative hash so consecutive ids spread evenly.
+size_t idBucket(int id, size_t buckets) {
+    uint32_t h = static_cast<uint32_t>(id) * 2654435761u;
+    return static_cast<size_t>((uint64_t{h} * buckets) >> 32);
+}
+
+// Counts gathered by one thread. Aligned so two threads' counters never
+// share a cache line.
+struct alignas(64) Accumulator {
+    array<size_t, 4> types{};
+    size_t stored = 0;
+    size_t loans = 0;
+    size_t undated = 0;
+    unordered_map<uint32_t, size_t> authors;  // author symbol id -> books
+    unordered_map<int32_t, size_t> months;    // dueMonth -> loans
+    vector<vector<int>> ids;                  // ids by idBucket
+
+    explicit Accumulator(size_t buckets) : ids(buckets) {}
+
+    void addItem(const Item &item) {
+        ++types[static_cast<size_t>(item.type())];
+        if (item.type() == ItemType::Book) {
+            Symbol author = static_cast<const Book &>(item).getAuthorSymbol();
+            ++authors[author.id()];
+        }
+        ids[idBucket(item.getId(), ids.size())].push_back(item.getId());
+    }
+
+    void addShelves(const LibraryStorage &lib, size_t first, size_t last,
+                    vector<uint32_t> &perShelf) {
+        for (const ItemLocation &loc : lib.itemsOnShelves(first, last)) {
+            addItem(*loc.item);
+            ++perShelf[loc.shelf];
+            ++stored;
+        }
+    }
+
+    void addLoans(const vector<LibraryStorage::CheckedOutRecord> &records, size_t first,
+                  size_t last) {
+        for (size_t i = first; i < last; ++i) {
+            const LibraryStorage::CheckedOutRecord &rec = records[i];
+            addItem(*rec.item);
+            if (rec.dueDay == NO_DUE_DAY) {
+                ++undated;
+            } else {
+                ++months[dueMonth(rec.dueDay)];
+            }
+            ++loans;
+        }
+    }
+};
+
+// Run fn(task, worker) for every task, on pool if there is one.
+void forEachTask(ThreadPool *pool, size_t tasks, const ThreadPool::Task &fn) {
+    if (pool) {
+        pool->run(tasks, fn);
+    } else {
+        for (size_t t = 0; t < tasks; ++t) fn(t, 0);
+    }
+}
+
+InventoryAudit audit(const LibraryStorage &lib, ThreadPool *pool) {
+    const size_t workers = pool ? pool->size() : 1;
+    const auto &records = lib.checkedOutRecords();
+
+    InventoryAudit result;
+    result.itemsPerShelf.assign(lib.numShelves(), 0);
+
+    // Pass 1: counts, and every id into its bucket.
+    vector<Accumulator> acc(workers, Accumulator(ID_BUCKETS));
+    const size_t shelfTasks = (lib.numShelves() + SHELVES_PER_TASK - 1) / SHELVES_PER_TASK;
+    const size_t loanTasks = (records.size() + LOANS_PER_TASK - 1) / LOANS_PER_TASK;
+    forEachTask(pool, shelfTasks + loanTasks, [&](size_t task, size_t worker) {
+        if (task < shelfTasks) {
+            size_t first = task * SHELVES_PER_TASK;
+            acc[worker].addShelves(lib, first, first + SHELVES_PER_TASK, result.itemsPerShelf);
+        } else {
+            size_t first = (task - shelfTasks) * LOANS_PER_TASK;
+            acc[worker].addLoans(records, first, min(first + LOANS_PER_TASK, records.size()));
+        }
+    });
+
+    // Pass 2: each bucket, gathered from every accumulator, is sorted on
+    // its own; equal ids are then adjacent.
+    vector<vector<int>> duplicates(ID_BUCKETS);
+    forEachTask(pool, ID_BUCKETS, [&](size_t bucket, size_t) {
+        vector<int> ids;
+        size_t total = 0;
+        for (const Accumulator &a : acc) total += a.ids[bucket].size();
+        ids.reserve(total);
+        for (const Accumulator &a : acc) {
+            ids.insert(ids.end(), a.ids[bucket].begin(), a.ids[bucket].end());
+        }
+        sort(ids.begin(), ids.end());
+        vector<int> &found = duplicates[bucket];
+        for (size_t i = 1; i < ids.size(); ++i) {
+            if (ids[i] == ids[i - 1] && (found.empty() || found.back() != ids[i])) {
+                found.push_back(ids[i]);
+            }
+        }
+    });
+
+    unordered_map<uint32_t, size_t> authors;
+    for (const Accumulator &a : acc) {
+        for (size_t t = 0; t < a.types.size(); ++t) result.itemsPerType[t] += a.types[t];
+        result.storedItems += a.stored;
+        result.loans += a.loans;
+        result.undatedLoans += a.undated;
+        for (const auto &[author, count] : a.authors) authors[author] += count;
+        for (const auto &[month, count] : a.months) result.loansPerDueMonth[month] += count;
+    }
+    result.items = result.storedItems + result.loans;
+
+    result.itemsPerAuthor.reserve(authors.size());
+    for (const auto &[author, count] : authors) {
+        result.itemsPerAuthor.emplace_back(Symbol(author), count);
+    }
+    sort(result.itemsPerAuthor.begin(), result.itemsPerAuthor.end(),
+         [](const auto &a, const auto &b) {
+             return a.second != b.second ? a.second > b.second : a.first.id() < b.first.id();
+         });
+
+    for (const vector<int> &d : duplicates) {
+        result.duplicateIds.insert(result.duplicateIds.end(), d.begin(), d.end());
+    }
+    sort(result.duplicateIds.begin(), result.duplicateIds.end());
+    return result;
+}
+
+} // namespace
+
+InventoryAudit auditInventory(const LibraryStorage &lib) { return audit(lib, nullptr); }
+
+InventoryAudit auditInventory(const LibraryStorage &lib, ThreadPool &pool) {
+    return audit(lib, &pool);
+}
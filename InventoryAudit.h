@@ -0,0 +1,62 @@
+#pragma once
+#include "LibraryStorage.h"
+#include "StringPool.h"
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <utility>
+#include <vector>
+
+class ThreadPool;
+
+/*
+ * File: InventoryAudit.h
+ * ----------------------
+ * Whole-inventory counts for audits: items per type, per shelf and per
+ * book author, loans per due month, and item ids that occur more than
+ * once. "Items" are the stored items plus the checked-out ones.
+ *
+ * The scan is split into tasks (a run of shelves, or a run of loan
+ * records), each added into the accumulator of the thread running it;
+ * the accumulators are merged at the end. Ids are spread over a fixed
+ * number of buckets by hash, so the duplicate search is a second parallel
+ * pass that sorts each bucket on its own. Without a pool the same tasks and
+ * merge run on the calling thread, so both forms give the same result.
+ *
+ * The storage must not change during an audit.
+ *
+ * Data Table (identifier | datatype | use)
+ * ----------------------------------------------------------------------
+ * items            | size_t                            | Stored plus checked-out items
+ * storedItems      | size_t                            | Items in compartments
+ * loans            | size_t                            | Checked-out items
+ * itemsPerType     | std::array<size_t, 4>             | Items by ItemType value
+ * itemsPerShelf    | std::vector<uint32_t>             | Stored items on each shelf
+ * itemsPerAuthor   | std::vector<pair<Symbol, size_t>> | Books per author, most first
+ * loansPerDueMonth | std::map<int32_t, size_t>         | Loans by dueMonth() of the due date
+ * undatedLoans     | size_t                            | Loans whose due date has no day number
+ * duplicateIds     | std::vector<int>                  | Ids of more than one item, ascending
+ *
+ */
+
+struct InventoryAudit {
+    size_t items = 0;
+    size_t storedItems = 0;
+    size_t loans = 0;
+    std::array<size_t, 4> itemsPerType{};
+    std::vector<uint32_t> itemsPerShelf;
+    // Ties are ordered by symbol id.
+    std::vector<std::pair<Symbol, size_t>> itemsPerAuthor;
+    std::map<int32_t, size_t> loansPerDueMonth;
+    size_t undatedLoans = 0;
+    std::vector<int> duplicateIds;
+
+    bool operator==(const InventoryAudit &other) const = default;
+};
+
+// Audit on the calling thread.
+InventoryAudit auditInventory(const LibraryStorage &lib);
+
+// Audit on every thread of pool.
+InventoryAudit auditInventory(const LibraryStorage &lib, ThreadPool &pool);
@@ -5,30 +5,60 @@
  *
  * Data Table (identifier | datatype | use)
  * ---------------------------------------------------------------
- * name             | std::string              | Item name (moved into object)
- * description      | std::string              | Item description (moved into object)
- * id               | int                      | ID Number
- * title            | std::string              | Title for Book/Movie (moved)
- * author           | std::string              | Book author (moved)
- * copyrightDate    | std::string              | Book copyright date (moved)
- * director         | std::string              | Movie director (moved)
- * mainActors       | std::vector<std::string> | Movie actor list (moved)
- * edition          | std::string              | Magazine edition (moved)
- * mainArticleTitle | std::string              | Magazine main article (moved)
+ * name             | std::pmr::string              | Item name (copied into arena)
+ * description      | std::pmr::string              | Item description (copied into arena)
+ * id               | int                           | ID Number
+ * title            | std::pmr::string              | Title for Book/Movie (copied)
+ * author           | Symbol                        | Book author (interned)
+ * copyrightDate    | std::pmr::string              | Book copyright date (copied)
+ * director         | Symbol                        | Movie director (interned)
+ * mainActors       | std::pmr::vector<Symbol>      | Movie actor list (interned)
+ * edition          | std::pmr::string              | Magazine edition (copied)
+ * mainArticleTitle | std::pmr::string              | Magazine main article (copied)
+ * AllocHeader      | struct                        | Resource an Item was allocated from
  */
 
 #include "Item.h"
-#include <utility>
+#include "ItemArena.h"
+#include <new>
 
 using namespace std;
 
-Item::Item(string name_, string description_, int id_)
-    : name(move(name_)), description(move(description_)), id(id_) {}
+// Stored in front of every Item so operator delete can return the memory
+// to the resource it came from (nullptr: global heap).
+struct alignas(max_align_t) AllocHeader {
+    pmr::memory_resource *resource;
+};
+
+void *Item::operator new(size_t size) {
+    pmr::memory_resource *res = ItemArena::current();
+    size_t total = size + sizeof(AllocHeader);
+    void *p = res ? res->allocate(total, alignof(AllocHeader)) : ::operator new(total);
+    static_cast<AllocHeader *>(p)->resource = res;
+    return static_cast<char *>(p) + sizeof(AllocHeader);
+}
+
+void Item::operator delete(void *p, size_t size) {
+    if (!p) return;
+    auto *h = reinterpret_cast<AllocHeader *>(static_cast<char *>(p) - sizeof(AllocHeader));
+    if (h->resource) {
+        h->resource->deallocate(h, size + sizeof(AllocHeader), alignof(AllocHeader));
+    } else {
+        ::operator delete(h);
+    }
+}
+
+Item::Item(string_view name_, string_view description_, int id_)
+    : name(name_, ItemArena::currentOrDefault()),
+      description(description_, ItemArena::currentOrDefault()),
+      id(id_) {}
 
 Item::~Item() = default;
 
 int Item::getId() const { return id; }
-string Item::getName() const { return name; }
+string_view Item::getName() const { return name; }
+string_view Item::getDescription() const { return description; }
+ItemType Item::type() const { return ItemType::Item; }
 
 void Item::print(ostream &os) const {
     os << "Item[id=" << id
@@ -36,14 +66,20 @@ void Item::print(ostream &os) const {
        << ", desc=\"" << description << "\"]";
 }
 
-Book::Book(string name_, string description_, int id_,
-           string title_, string author_, string copyrightDate_)
-    : Item(move(name_), move(description_), id_),
-      title(move(title_)),
-      author(move(author_)),
-      copyrightDate(move(copyrightDate_))
+Book::Book(string_view name_, string_view description_, int id_,
+           string_view title_, string_view author_, string_view copyrightDate_)
+    : Item(name_, description_, id_),
+      title(title_, ItemArena::currentOrDefault()),
+      author(StringPool::global().intern(author_)),
+      copyrightDate(copyrightDate_, ItemArena::currentOrDefault())
 {}
 
+ItemType Book::type() const { return ItemType::Book; }
+string_view Book::getTitle() const { return title; }
+string_view Book::getAuthor() const { return author.str(); }
+Symbol Book::getAuthorSymbol() const { return author; }
+string_view Book::getCopyrightDate() const { return copyrightDate; }
+
 void Book::print(ostream &os) const {
     os << "Book[id=" << id
        << ", name=\"" << name << "\""
@@ -53,13 +89,23 @@ void Book::print(ostream &os) const {
        << ", desc=\"" << description << "\"]";
 }
 
-Movie::Movie(string name_, string description_, int id_,
-             string title_, string director_, vector<string> actors)
-    : Item(move(name_), move(description_), id_),
-      title(move(title_)),
-      director(move(director_)),
-      mainActors(move(actors))
-{}
+Movie::Movie(string_view name_, string_view description_, int id_,
+             string_view title_, string_view director_, const vector<string> &actors)
+    : Item(name_, description_, id_),
+      title(title_, ItemArena::currentOrDefault()),
+      director(StringPool::global().intern(director_)),
+      mainActors(ItemArena::currentOrDefault())
+{
+    StringPool &pool = StringPool::global();
+    mainActors.reserve(actors.size());
+    for (const string &a : actors) mainActors.push_back(pool.intern(a));
+}
+
+ItemType Movie::type() const { return ItemType::Movie; }
+string_view Movie::getTitle() const { return title; }
+string_view Movie::getDirector() const { return director.str(); }
+Symbol Movie::getDirectorSymbol() const { return director; }
+const pmr::vector<Symbol> &Movie::getMainActors() const { return mainActors; }
 
 void Movie::print(ostream &os) const {
     os << "Movie[id=" << id
@@ -74,13 +120,17 @@ void Movie::print(ostream &os) const {
     os << "], desc=\"" << description << "\"]";
 }
 
-Magazine::Magazine(string name_, string description_, int id_,
-                   string edition_, string mainArticleTitle_)
-    : Item(move(name_), move(description_), id_),
-      edition(move(edition_)),
-      mainArticleTitle(move(mainArticleTitle_))
+Magazine::Magazine(string_view name_, string_view description_, int id_,
+                   string_view edition_, string_view mainArticleTitle_)
+    : Item(name_, description_, id_),
+      edition(edition_, ItemArena::currentOrDefault()),
+      mainArticleTitle(mainArticleTitle_, ItemArena::currentOrDefault())
 {}
 
+ItemType Magazine::type() const { return ItemType::Magazine; }
+string_view Magazine::getEdition() const { return edition; }
+string_view Magazine::getMainArticleTitle() const { return mainArticleTitle; }
+
 void Magazine::print(ostream &os) const {
     os << "Magazine[id=" << id
        << ", name=\"" << name << "\""
@@ -1,7 +1,12 @@
 #pragma once
+#include <cstddef>
+#include <cstdint>
+#include <memory_resource>
 #include <string>
+#include <string_view>
 #include <vector>
 #include <iostream>
+#include "StringPool.h"
 
 /*
  * File: Item.h
@@ -9,34 +14,50 @@
  * Includes: Item (base), Book, Movie, Magazine. Each derived type
  * provides additional fields and overrides a virtual print method.
  *
+ * Items and their strings are allocated from the ItemArena that is
+ * current when the item is created (see ItemArena.h), or from the global
+ * heap when there is none. Authors, directors and actors repeat across
+ * many items and are interned in StringPool::global() instead.
+ *
  * Data Table (identifier | datatype | use)
  * ------------------------------------------------------------------------------
- * name             | std::string              | Item name
- * description      | std::string              | Item description
- * id               | int                      | ID Number
- * title            | std::string              | Title (Book/Movie)
- * author           | std::string              | Book author
- * copyrightDate    | std::string              | Book copyright date
- * director         | std::string              | Movie director
- * mainActors       | std::vector<std::string> | Movie main actors
- * edition          | std::string              | Magazine edition
- * mainArticleTitle | std::string              | Magazine article title
+ * name             | std::pmr::string              | Item name
+ * description      | std::pmr::string              | Item description
+ * id               | int                           | ID Number
+ * title            | std::pmr::string              | Title (Book/Movie)
+ * author           | Symbol                        | Book author (interned)
+ * copyrightDate    | std::pmr::string              | Book copyright date
+ * director         | Symbol                        | Movie director (interned)
+ * mainActors       | std::pmr::vector<Symbol>      | Movie main actors (interned)
+ * edition          | std::pmr::string              | Magazine edition
+ * mainArticleTitle | std::pmr::string              | Magazine article title
  *
  */
 
+// Concrete type of an Item, for code that needs the derived fields
+// (persistence, reports) without a dynamic_cast chain.
+enum class ItemType : std::uint8_t { Item, Book, Movie, Magazine };
+
 // Base class representing a generic library item. Stores the common
 // attributes shared by all items and declares a polymorphic print.
 class Item {
 protected:
-    std::string name;         // Item name
-    std::string description;  // Item description
-    int id;                   // ID number for the item
+    std::pmr::string name;         // Item name
+    std::pmr::string description;  // Item description
+    int id;                        // ID number for the item
 public:
-    Item(std::string name, std::string description, int id);
+    Item(std::string_view name, std::string_view description, int id);
     virtual ~Item();
 
+    // Allocate from the current ItemArena, if any.
+    static void *operator new(std::size_t size);
+    static void operator delete(void *p, std::size_t size);
+
     int getId() const;
-    std::string getName() const;
+    std::string_view getName() const;
+    std::string_view getDescription() const;
+
+    virtual ItemType type() const;
 
     // Polymorphic print
     virtual void print(std::ostream &os) const;
@@ -44,35 +65,51 @@ public:
 
 // Book: derived from Item, adds title/author/copyrightDate
 class Book : public Item {
-    std::string title;         // Book title
-    std::string author;        // Book author
-    std::string copyrightDate; // Copyright date for the book
+    std::pmr::string title;         // Book title
+    Symbol author;                  // Book author
+    std::pmr::string copyrightDate; // Copyright date for the book
 public:
-    Book(std::string name, std::string description, int id, std::string title,
-         std::string author, std::string copyrightDate);
+    Book(std::string_view name, std::string_view description, int id, std::string_view title,
+         std::string_view author, std::string_view copyrightDate);
+
+    ItemType type() const override;
+    std::string_view getTitle() const;
+    std::string_view getAuthor() const;
+    Symbol getAuthorSymbol() const;
+    std::string_view getCopyrightDate() const;
 
     void print(std::ostream &os) const override;
 };
 
 // Movie: derived from Item, adds title/director/actors
 class Movie : public Item {
-    std::string title;                   // Movie title
-    std::string director;                // Movie director
-    std::vector<std::string> mainActors; // List of actors
+    std::pmr::string title;                        // Movie title
+    Symbol director;                               // Movie director
+    std::pmr::vector<Symbol> mainActors;           // List of actors
 public:
-    Movie(std::string name, std::string description, int id, std::string title,
-          std::string director, std::vector<std::string> actors);
+    Movie(std::string_view name, std::string_view description, int id, std::string_view title,
+          std::string_view director, const std::vector<std::string> &actors);
+
+    ItemType type() const override;
+    std::string_view getTitle() const;
+    std::string_view getDirector() const;
+    Symbol getDirectorSymbol() const;
+    const std::pmr::vector<Symbol> &getMainActors() const;
 
     void print(std::ostream &os) const override;
 };
 
 // Magazine: derived from Item, adds edition/article title
 class Magazine : public Item {
-    std::string edition;          // Magazine edition
-    std::string mainArticleTitle; // Title of article
+    std::pmr::string edition;          // Magazine edition
+    std::pmr::string mainArticleTitle; // Title of article
 public:
-    Magazine(std::string name, std::string description, int id, std::string edition,
-             std::string mainArticleTitle);
+    Magazine(std::string_view name, std::string_view description, int id,
+             std::string_view edition, std::string_view mainArticleTitle);
+
+    ItemType type() const override;
+    std::string_view getEdition() const;
+    std::string_view getMainArticleTitle() const;
 
     void print(std::ostream &os) const override;
 };
@@ -0,0 +1,58 @@
+#include "ItemArena.h"
+#include <new>
+
+using namespace std;
+
+/*
+ * File: ItemArena.cpp
+ * -------------------
+ * Implements the item arena declared in ItemArena.h.
+ */
+
+static thread_local pmr::memory_resource *activeArena = nullptr;
+
+void *ItemArena::CountingResource::do_allocate(size_t n, size_t align) {
+    void *p = ::operator new(n, align_val_t(align));
+    ++allocations;
+    bytes += n;
+    if (bytes > peakBytes) peakBytes = bytes;
+    return p;
+}
+
+void ItemArena::CountingResource::do_deallocate(void *p, size_t n, size_t align) {
+    ::operator delete(p, n, align_val_t(align));
+    bytes -= n;
+}
+
+bool ItemArena::CountingResource::do_is_equal(const pmr::memory_resource &other) const noexcept {
+    return this == &other;
+}
+
+// Large chunks and blocks up to 4 KiB pooled: items and most strings are
+// far smaller than that.
+static pmr::pool_options arenaOptions() {
+    pmr::pool_options opts;
+    opts.max_blocks_per_chunk = 4096;
+    opts.largest_required_pool_block = 4096;
+    return opts;
+}
+
+ItemArena::ItemArena() : pool(arenaOptions(), &upstream) {}
+
+pmr::memory_resource *ItemArena::resource() { return &pool; }
+
+size_t ItemArena::upstreamAllocations() const { return upstream.allocationCount(); }
+size_t ItemArena::upstreamBytes() const { return upstream.bytesInUse(); }
+size_t ItemArena::upstreamPeakBytes() const { return upstream.peakBytesInUse(); }
+
+pmr::memory_resource *ItemArena::current() { return activeArena; }
+
+pmr::memory_resource *ItemArena::currentOrDefault() {
+    return activeArena ? activeArena : pmr::get_default_resource();
+}
+
+ItemArena::Scope::Scope(ItemArena *arena) : prev(activeArena) {
+    activeArena = arena ? arena->resource() : nullptr;
+}
+
+ItemArena::Scope::~Scope() { activeArena = prev; }
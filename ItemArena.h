@@ -0,0 +1,77 @@
+#pragma once
+#include <cstddef>
+#include <memory_resource>
+
+/*
+ * File: ItemArena.h
+ * -----------------
+ * Memory arena for Item objects and their strings. An arena is a pool
+ * resource (free lists per block size, so removed items are reused) on
+ * top of a counting upstream that hands out large chunks. All memory goes
+ * back in one step when the arena is destroyed.
+ *
+ * Items do not take an allocator argument. Instead, code that creates
+ * items opens an ItemArena::Scope; while it is active on a thread, Item's
+ * operator new and the Item string members allocate from that arena.
+ * Outside any scope they use the global heap as before.
+ *
+ * An arena is not thread-safe; create and destroy its items on one thread.
+ * Every item allocated from an arena must be destroyed before the arena.
+ *
+ * Data Table (identifier | datatype | use)
+ * ----------------------------------------------------------------------
+ * CountingResource | class                               | Upstream; counts chunk allocations
+ * upstream         | CountingResource                    | Source of the pool's chunks
+ * pool             | std::pmr::unsynchronized_pool_resource | Serves items and strings
+ * Scope            | class                               | RAII "allocate from this arena"
+ *
+ */
+
+class ItemArena {
+    class CountingResource : public std::pmr::memory_resource {
+        size_t allocations = 0;
+        size_t bytes = 0;
+        size_t peakBytes = 0;
+
+        void *do_allocate(size_t n, size_t align) override;
+        void do_deallocate(void *p, size_t n, size_t align) override;
+        bool do_is_equal(const std::pmr::memory_resource &other) const noexcept override;
+
+    public:
+        size_t allocationCount() const { return allocations; }
+        size_t bytesInUse() const { return bytes; }
+        size_t peakBytesInUse() const { return peakBytes; }
+    };
+
+    CountingResource upstream;
+    std::pmr::unsynchronized_pool_resource pool;
+
+public:
+    ItemArena();
+    ItemArena(const ItemArena &) = delete;
+    ItemArena &operator=(const ItemArena &) = delete;
+
+    std::pmr::memory_resource *resource();
+
+    // Chunks requested from the system heap so far, and bytes held.
+    size_t upstreamAllocations() const;
+    size_t upstreamBytes() const;
+    size_t upstreamPeakBytes() const;
+
+    // Arena resource active on this thread, or nullptr outside any Scope.
+    static std::pmr::memory_resource *current();
+
+    // Resource to use for item memory: current() or the default resource.
+    static std::pmr::memory_resource *currentOrDefault();
+
+    // Make arena current on this thread until the Scope ends. A null
+    // arena makes allocations use the global heap.
+    class Scope {
+        std::pmr::memory_resource *prev;
+    public:
+        explicit Scope(ItemArena *arena);
+        ~Scope();
+        Scope(const Scope &) = delete;
+        Scope &operator=(const Scope &) = delete;
+    };
+};
@@ -0,0 +1,535 @@
+#include "Journal.h"
+#include "Snapshot.h"
+#include <algorithm>
+#include <array>
+#include <cerrno>
+#include <cstring>
+#include <string_view>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using namespace std;
+
+/*
+ * File: Journal.cpp
+ * -----------------
+ * Implements the write-ahead journal declared in Journal.h. Payloads are
+ * little more than the arguments of the logged call: fixed-width integers
+ * and length-prefixed strings. Items are written out in full so replay
+ * does not depend on any earlier snapshot.
+ */
+
+namespace {
+
+constexpr size_t FRAME_HEADER = 2 * sizeof(uint32_t);
+
+array<uint32_t, 256> makeCrcTable() {
+    array<uint32_t, 256> table{};
+    for (uint32_t i = 0; i < 256; ++i) {
+        uint32_t c = i;
+        for (int k = 0; k < 8; ++k) c = (c & 1) ? 0xedb88320u ^ (c >> 1) : c >> 1;
+        table[i] = c;
+    }
+    return table;
+}
+
+uint32_t crc32(const char *data, size_t len) {
+    static const array<uint32_t, 256> table = makeCrcTable();
+    uint32_t c = 0xffffffffu;
+    for (size_t i = 0; i < len; ++i) {
+        c = table[(c ^ static_cast<uint8_t>(data[i])) & 0xff] ^ (c >> 8);
+    }
+    return c ^ 0xffffffffu;
+}
+
+template <typename T>
+void put(string &out, T value) {
+    out.append(reinterpret_cast<const char *>(&value), sizeof(value));
+}
+
+void putString(string &out, string_view s) {
+    put<uint32_t>(out, static_cast<uint32_t>(s.size()));
+    out.append(s);
+}
+
+// Bounds-checked reader over one payload.
+class Reader {
+    const char *p;
+    const char *end;
+
+public:
+    Reader(const char *data, size_t len) : p(data), end(data + len) {}
+
+    template <typename T>
+    bool get(T &value) {
+        if (static_cast<size_t>(end - p) < sizeof(T)) return false;
+        memcpy(&value, p, sizeof(T));
+        p += sizeof(T);
+        return true;
+    }
+
+    bool getString(string &s) {
+        uint32_t len = 0;
+        if (!get(len) || static_cast<size_t>(end - p) < len) return false;
+        s.assign(p, len);
+        p += len;
+        return true;
+    }
+
+    bool getLocation(size_t &shelf, size_t &comp) {
+        uint32_t s = 0, c = 0;
+        if (!get(s) || !get(c)) return false;
+        shelf = s;
+        comp = c;
+        return true;
+    }
+};
+
+void putLocation(string &out, size_t shelfIdx, size_t compIdx) {
+    put<uint32_t>(out, static_cast<uint32_t>(shelfIdx));
+    put<uint32_t>(out, static_cast<uint32_t>(compIdx));
+}
+
+void putItem(string &out, const Item &item) {
+    put<uint8_t>(out, static_cast<uint8_t>(item.type()));
+    put<int32_t>(out, item.getId());
+    putString(out, item.getName());
+    putString(out, item.getDescription());
+    switch (item.type()) {
+        case ItemType::Book: {
+            const auto &b = static_cast<const Book &>(item);
+            putString(out, b.getTitle());
+            putString(out, b.getAuthor());
+            putString(out, b.getCopyrightDate());
+            break;
+        }
+        case ItemType::Movie: {
+            const auto &m = static_cast<const Movie &>(item);
+            putString(out, m.getTitle());
+            putString(out, m.getDirector());
+            put<uint32_t>(out, static_cast<uint32_t>(m.getMainActors().size()));
+            for (const auto &a : m.getMainActors()) putString(out, a);
+            break;
+        }
+        case ItemType::Magazine: {
+            const auto &m = static_cast<const Magazine &>(item);
+            putString(out, m.getEdition());
+            putString(out, m.getMainArticleTitle());
+            break;
+        }
+        case ItemType::Item:
+            break;
+    }
+}
+
+unique_ptr<Item> getItem(Reader &r) {
+    uint8_t type = 0;
+    int32_t id = 0;
+    string name, description, f1, f2, f3;
+    if (!r.get(type) || !r.get(id) || !r.getString(name) || !r.getString(description)) {
+        return nullptr;
+    }
+    switch (static_cast<ItemType>(type)) {
+        case ItemType::Book:
+            if (!r.getString(f1) || !r.getString(f2) || !r.getString(f3)) return nullptr;
+            return make_unique<Book>(move(name), move(description), id, move(f1), move(f2),
+                                     move(f3));
+        case ItemType::Movie: {
+            uint32_t n = 0;
+            if (!r.getString(f1) || !r.getString(f2) || !r.get(n)) return nullptr;
+            vector<string> actors;
+            for (uint32_t i = 0; i < n; ++i) {
+                string a;
+                if (!r.getString(a)) return nullptr;
+                actors.push_back(move(a));
+            }
+            return make_unique<Movie>(move(name), move(description), id, move(f1), move(f2),
+                                      move(actors));
+        }
+        case ItemType::Magazine:
+            if (!r.getString(f1) || !r.getString(f2)) return nullptr;
+            return make_unique<Magazine>(move(name), move(description), id, move(f1),
+                                         move(f2));
+        case ItemType::Item:
+            return make_unique<Item>(move(name), move(description), id);
+    }
+    return nullptr;
+}
+
+// Read the steps of a Batch payload into tx.
+bool getTransaction(Reader &r, LibraryStorage::Transaction &tx) {
+    uint32_t n = 0;
+    if (!r.get(n)) return false;
+    for (uint32_t i = 0; i < n; ++i) {
+        uint8_t op = 0;
+        size_t s1 = 0, c1 = 0, s2 = 0, c2 = 0;
+        if (!r.get(op) || !r.getLocation(s1, c1)) return false;
+        switch (static_cast<JournalOp>(op)) {
+            case JournalOp::AddItem: {
+                unique_ptr<Item> item = getItem(r);
+                if (!item) return false;
+                tx.addItem(move(item), s1, c1);
+                break;
+            }
+            case JournalOp::RemoveItem:
+                tx.removeItem(s1, c1);
+                break;
+            case JournalOp::Move:
+                if (!r.getLocation(s2, c2)) return false;
+                tx.moveItem(s1, c1, s2, c2);
+                break;
+            case JournalOp::Checkout: {
+                string person, dueDate;
+                if (!r.getString(person) || !r.getString(dueDate)) return false;
+                tx.checkoutItem(s1, c1, move(person), move(dueDate));
+                break;
+            }
+            case JournalOp::Checkin:
+                tx.checkinItem(s1, c1);
+                break;
+            default:
+                return false;
+        }
+    }
+    return true;
+}
+
+// Apply one payload. Returns false if the payload is malformed or the
+// operation no longer applies to the storage.
+bool applyPayload(Reader &r, LibraryStorage &lib) {
+    uint8_t op = 0;
+    if (!r.get(op)) return false;
+    size_t s1 = 0, c1 = 0, s2 = 0, c2 = 0;
+
+    switch (static_cast<JournalOp>(op)) {
+        case JournalOp::AddItem: {
+            if (!r.getLocation(s1, c1)) return false;
+            unique_ptr<Item> item = getItem(r);
+            return item && lib.addItem(move(item), s1, c1);
+        }
+        case JournalOp::RemoveItem:
+            return r.getLocation(s1, c1) && lib.removeItem(s1, c1);
+        case JournalOp::Checkout: {
+            string person, dueDate;
+            return r.getLocation(s1, c1) && r.getString(person) && r.getString(dueDate)
+                   && lib.checkoutItem(s1, c1, move(person), move(dueDate));
+        }
+        case JournalOp::Checkin:
+            return r.getLocation(s1, c1) && lib.checkinItem(s1, c1);
+        case JournalOp::Swap:
+            return r.getLocation(s1, c1) && r.getLocation(s2, c2)
+                   && lib.swapItems(s1, c1, s2, c2);
+        case JournalOp::ReserveShelves: {
+            uint64_t n = 0;
+            if (!r.get(n)) return false;
+            lib.reserveShelves(n);
+            return true;
+        }
+        case JournalOp::AddShelf: {
+            uint32_t capacity = 0;
+            return r.get(capacity) && lib.addShelf(capacity);
+        }
+        case JournalOp::Move:
+            return r.getLocation(s1, c1) && r.getLocation(s2, c2)
+                   && lib.moveItem(s1, c1, s2, c2);
+        case JournalOp::Batch: {
+            LibraryStorage::Transaction tx;
+            return getTransaction(r, tx) && lib.commit(tx);
+        }
+        case JournalOp::PlaceHold: {
+            string person;
+            return r.getLocation(s1, c1) && r.getString(person)
+                   && lib.placeHold(s1, c1, move(person));
+        }
+        case JournalOp::CancelHold: {
+            string person;
+            return r.getLocation(s1, c1) && r.getString(person)
+                   && lib.cancelHold(s1, c1, person);
+        }
+    }
+    return false;
+}
+
+} // namespace
+
+// ------------------ Journal ------------------
+
+Journal::Journal(size_t groupSize_)
+    : fd(-1), groupSize(groupSize_ ? groupSize_ : 1), seq(0) {}
+
+Journal::~Journal() { close(); }
+
+bool Journal::open(const string &path_, uint64_t lastSeq, uint64_t validBytes) {
+    close();
+    fd = ::open(path_.c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        cerr << "Error: Could not open journal \"" << path_ << "\": " << strerror(errno)
+             << "\n";
+        return false;
+    }
+    if (ftruncate(fd, static_cast<off_t>(validBytes)) != 0) {
+        cerr << "Error: Could not trim journal \"" << path_ << "\".\n";
+        ::close(fd);
+        fd = -1;
+        return false;
+    }
+    path = path_;
+    seq = lastSeq;
+    return true;
+}
+
+void Journal::close() {
+    if (fd < 0) return;
+    sync();
+    ::close(fd);
+    fd = -1;
+}
+
+bool Journal::isOpen() const { return fd >= 0; }
+uint64_t Journal::lastSeq() const { return seq; }
+size_t Journal::pending() const { return frameEnds.size(); }
+
+void Journal::beginRecord(JournalOp op) {
+    payload.clear();
+    put<uint64_t>(payload, seq + 1);
+    put<uint8_t>(payload, static_cast<uint8_t>(op));
+}
+
+void Journal::commitRecord() {
+    if (fd < 0) return;
+    ++seq;
+    put<uint32_t>(buffer, static_cast<uint32_t>(payload.size()));
+    put<uint32_t>(buffer, crc32(payload.data(), payload.size()));
+    buffer.append(payload);
+    frameEnds.push_back(buffer.size());
+    if (frameEnds.size() >= groupSize) sync();
+}
+
+void Journal::logAddItem(const Item &item, size_t shelfIdx, size_t compIdx) {
+    beginRecord(JournalOp::AddItem);
+    put<uint32_t>(payload, static_cast<uint32_t>(shelfIdx));
+    put<uint32_t>(payload, static_cast<uint32_t>(compIdx));
+    putItem(payload, item);
+    commitRecord();
+}
+
+void Journal::logRemoveItem(size_t shelfIdx, size_t compIdx) {
+    beginRecord(JournalOp::RemoveItem);
+    put<uint32_t>(payload, static_cast<uint32_t>(shelfIdx));
+    put<uint32_t>(payload, static_cast<uint32_t>(compIdx));
+    commitRecord();
+}
+
+void Journal::logCheckout(size_t shelfIdx, size_t compIdx, string_view person,
+                          const string &dueDate) {
+    beginRecord(JournalOp::Checkout);
+    put<uint32_t>(payload, static_cast<uint32_t>(shelfIdx));
+    put<uint32_t>(payload, static_cast<uint32_t>(compIdx));
+    putString(payload, person);
+    putString(payload, dueDate);
+    commitRecord();
+}
+
+void Journal::logCheckin(size_t shelfIdx, size_t compIdx) {
+    beginRecord(JournalOp::Checkin);
+    put<uint32_t>(payload, static_cast<uint32_t>(shelfIdx));
+    put<uint32_t>(payload, static_cast<uint32_t>(compIdx));
+    commitRecord();
+}
+
+void Journal::logSwap(size_t s1, size_t c1, size_t s2, size_t c2) {
+    beginRecord(JournalOp::Swap);
+    put<uint32_t>(payload, static_cast<uint32_t>(s1));
+    put<uint32_t>(payload, static_cast<uint32_t>(c1));
+    put<uint32_t>(payload, static_cast<uint32_t>(s2));
+    put<uint32_t>(payload, static_cast<uint32_t>(c2));
+    commitRecord();
+}
+
+void Journal::logReserveShelves(size_t n) {
+    beginRecord(JournalOp::ReserveShelves);
+    put<uint64_t>(payload, n);
+    commitRecord();
+}
+
+void Journal::logAddShelf(size_t capacity) {
+    beginRecord(JournalOp::AddShelf);
+    put<uint32_t>(payload, static_cast<uint32_t>(capacity));
+    commitRecord();
+}
+
+void Journal::logMove(size_t s1, size_t c1, size_t s2, size_t c2) {
+    beginRecord(JournalOp::Move);
+    putLocation(payload, s1, c1);
+    putLocation(payload, s2, c2);
+    commitRecord();
+}
+
+void Journal::logPlaceHold(size_t shelfIdx, size_t compIdx, string_view person) {
+    beginRecord(JournalOp::PlaceHold);
+    putLocation(payload, shelfIdx, compIdx);
+    putString(payload, person);
+    commitRecord();
+}
+
+void Journal::logCancelHold(size_t shelfIdx, size_t compIdx, string_view person) {
+    beginRecord(JournalOp::CancelHold);
+    putLocation(payload, shelfIdx, compIdx);
+    putString(payload, person);
+    commitRecord();
+}
+
+void Journal::logTransaction(const LibraryStorage::Transaction &tx) {
+    using Kind = LibraryStorage::Transaction::Kind;
+    beginRecord(JournalOp::Batch);
+    put<uint32_t>(payload, static_cast<uint32_t>(tx.size()));
+    for (const LibraryStorage::Transaction::Step &step : tx.steps()) {
+        switch (step.kind) {
+            case Kind::Add:
+                put<uint8_t>(payload, static_cast<uint8_t>(JournalOp::AddItem));
+                putLocation(payload, step.shelf, step.comp);
+                putItem(payload, *step.item);
+                break;
+            case Kind::Remove:
+                put<uint8_t>(payload, static_cast<uint8_t>(JournalOp::RemoveItem));
+                putLocation(payload, step.shelf, step.comp);
+                break;
+            case Kind::Move:
+                put<uint8_t>(payload, static_cast<uint8_t>(JournalOp::Move));
+                putLocation(payload, step.shelf, step.comp);
+                putLocation(payload, step.toShelf, step.toComp);
+                break;
+            case Kind::Checkout:
+                put<uint8_t>(payload, static_cast<uint8_t>(JournalOp::Checkout));
+                putLocation(payload, step.shelf, step.comp);
+                putString(payload, step.person);
+                putString(payload, step.dueDate);
+                break;
+            case Kind::Checkin:
+                put<uint8_t>(payload, static_cast<uint8_t>(JournalOp::Checkin));
+                putLocation(payload, step.shelf, step.comp);
+                break;
+        }
+    }
+    commitRecord();
+}
+
+bool Journal::sync() {
+    if (fd < 0) return false;
+    const char *p = buffer.data();
+    size_t left = buffer.size();
+    while (left > 0) {
+        ssize_t n = ::write(fd, p, left);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            cerr << "Error: Journal write failed: " << strerror(errno) << "\n";
+            // What reached the file must not be written again by the next
+            // sync; frames that reached it whole are no longer pending.
+            size_t written = static_cast<size_t>(p - buffer.data());
+            buffer.erase(0, written);
+            frameEnds.erase(frameEnds.begin(),
+                            upper_bound(frameEnds.begin(), frameEnds.end(), written));
+            for (size_t &end : frameEnds) end -= written;
+            return false;
+        }
+        p += n;
+        left -= static_cast<size_t>(n);
+    }
+    buffer.clear();
+    frameEnds.clear();
+    if (fdatasync(fd) != 0) {
+        cerr << "Error: Journal sync failed: " << strerror(errno) << "\n";
+        return false;
+    }
+    return true;
+}
+
+bool Journal::truncate() {
+    if (fd < 0) return false;
+    buffer.clear();
+    frameEnds.clear();
+    if (ftruncate(fd, 0) != 0 || fdatasync(fd) != 0) {
+        cerr << "Error: Could not truncate journal \"" << path << "\".\n";
+        return false;
+    }
+    return true;
+}
+
+// ------------------ Replay / compaction ------------------
+
+ReplayResult replayJournal(const string &path, LibraryStorage &lib, uint64_t afterSeq,
+                           bool skipFailed) {
+    ReplayResult result;
+    result.lastSeq = afterSeq;
+
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        result.ok = (errno == ENOENT);
+        if (!result.ok) cerr << "Error: Could not read journal \"" << path << "\".\n";
+        return result;
+    }
+    struct stat st {};
+    if (fstat(fd, &st) != 0) {
+        ::close(fd);
+        result.ok = false;
+        return result;
+    }
+    size_t size = static_cast<size_t>(st.st_size);
+    if (size == 0) {
+        ::close(fd);
+        return result;
+    }
+    void *addr = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (addr == MAP_FAILED) {
+        result.ok = false;
+        return result;
+    }
+
+    ItemArena::Scope scope(lib.itemArena());
+    const char *data = static_cast<const char *>(addr);
+    size_t pos = 0;
+    while (size - pos >= FRAME_HEADER) {
+        uint32_t len = 0, crc = 0;
+        memcpy(&len, data + pos, sizeof(len));
+        memcpy(&crc, data + pos + sizeof(len), sizeof(crc));
+        const char *body = data + pos + FRAME_HEADER;
+        if (len < sizeof(uint64_t) || size - pos - FRAME_HEADER < len
+            || crc32(body, len) != crc) {
+            break;
+        }
+
+        Reader r(body, len);
+        uint64_t frameSeq = 0;
+        r.get(frameSeq);
+        if (frameSeq > afterSeq) {
+            if (applyPayload(r, lib)) {
+                ++result.applied;
+            } else if (skipFailed) {
+                cerr << "Warning: Skipping journal frame " << frameSeq
+                     << ", which could not be applied.\n";
+                ++result.skipped;
+            } else {
+                cerr << "Error: Journal frame " << frameSeq << " could not be applied.\n";
+                result.ok = false;
+                result.failedSeq = frameSeq;
+                break;
+            }
+        }
+        result.lastSeq = max(result.lastSeq, frameSeq);
+        pos += FRAME_HEADER + len;
+    }
+    result.validBytes = pos;
+    result.tornTail = pos != size;
+
+    munmap(addr, size);
+    return result;
+}
+
+bool compactJournal(const LibraryStorage &lib, Journal &journal, const string &snapshotPath) {
+    if (!journal.sync()) return false;
+    if (!saveSnapshot(lib, snapshotPath, journal.lastSeq())) return false;
+    return journal.truncate();
+}
@@ -0,0 +1,127 @@
+#pragma once
+#include "LibraryStorage.h"
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+/*
+ * File: Journal.h
+ * ---------------
+ * Append-only write-ahead journal of LibraryStorage mutations. Each
+ * successful mutation is appended as one frame:
+ *
+ *   uint32_t length | uint32_t crc32 | uint64_t seq | payload
+ *
+ * where length counts seq + payload and the CRC covers the same bytes.
+ * Frames are buffered and written with one write() + fdatasync() per group
+ * of operations (group commit), so a crash loses at most the current
+ * group. Replay stops at the first torn or corrupt frame. A frame that is
+ * intact but does not apply to the storage stops it too, as a failure:
+ * carrying on would leave a store that matches neither the journal nor
+ * any earlier state. Only an explicit skipFailed carries on past it.
+ *
+ * Snapshots record the sequence number of the last journaled operation
+ * they contain; replay skips frames at or below it, so a crash between
+ * writing a snapshot and truncating the journal is harmless.
+ *
+ * Data Table (identifier | datatype | use)
+ * ----------------------------------------------------------------------
+ * JournalOp      | enum class      | Kind of mutation in a frame payload
+ * fd             | int             | Journal file, opened O_APPEND
+ * buffer         | std::string     | Frames not yet written to the file
+ * frameEnds      | vector<size_t>  | End offset in buffer of each buffered frame
+ * groupSize      | size_t          | Operations per group commit
+ * seq            | uint64_t        | Sequence number of the last frame
+ * ReplayResult   | struct          | Outcome of replayJournal
+ *
+ */
+
+enum class JournalOp : uint8_t {
+    AddItem = 1,
+    RemoveItem,
+    Checkout,
+    Checkin,
+    Swap,
+    ReserveShelves,
+    AddShelf,
+    Move,
+    Batch,  // a committed Transaction: u32 count, then each step's op + arguments
+    PlaceHold,
+    CancelHold,
+};
+
+class Journal {
+    int fd;
+    std::string path;
+    std::string buffer;
+    std::string payload;
+    std::vector<size_t> frameEnds;
+    size_t groupSize;
+    uint64_t seq;
+
+    void beginRecord(JournalOp op);
+    void commitRecord();
+
+public:
+    explicit Journal(size_t groupSize = 64);
+    ~Journal();
+    Journal(const Journal &) = delete;
+    Journal &operator=(const Journal &) = delete;
+
+    // Open path for appending after a replay. The file is cut back to
+    // validBytes (dropping a torn tail) and numbering resumes after lastSeq.
+    bool open(const std::string &path, uint64_t lastSeq, uint64_t validBytes);
+    void close();
+    bool isOpen() const;
+    uint64_t lastSeq() const;
+    // Operations logged but not yet written to the file.
+    size_t pending() const;
+
+    void logAddItem(const Item &item, size_t shelfIdx, size_t compIdx);
+    void logRemoveItem(size_t shelfIdx, size_t compIdx);
+    void logCheckout(size_t shelfIdx, size_t compIdx, std::string_view person,
+                     const std::string &dueDate);
+    void logCheckin(size_t shelfIdx, size_t compIdx);
+    void logSwap(size_t s1, size_t c1, size_t s2, size_t c2);
+    void logReserveShelves(size_t n);
+    void logAddShelf(size_t capacity);
+    void logMove(size_t s1, size_t c1, size_t s2, size_t c2);
+    // A check-in that hands an item to the next holder is logged as a
+    // plain check-in: replaying it hands the item over again.
+    void logPlaceHold(size_t shelfIdx, size_t compIdx, std::string_view person);
+    void logCancelHold(size_t shelfIdx, size_t compIdx, std::string_view person);
+    // One frame for every step of tx, written before the steps are applied.
+    void logTransaction(const LibraryStorage::Transaction &tx);
+
+    // Write buffered frames and fdatasync. Called automatically once
+    // groupSize operations are pending. After a failed write the frames
+    // that reached the file are dropped from the buffer and the rest stay
+    // pending for the next sync.
+    bool sync();
+
+    // Discard every frame; used once a snapshot covers them.
+    bool truncate();
+};
+
+struct ReplayResult {
+    bool ok = true;          // false if the file could not be read or a frame failed
+    size_t applied = 0;      // frames applied to the storage
+    size_t skipped = 0;      // frames that did not apply (skipFailed only)
+    uint64_t failedSeq = 0;  // the frame that stopped the replay, if any
+    uint64_t lastSeq = 0;    // highest sequence number seen
+    uint64_t validBytes = 0; // length of the intact prefix of the file
+    bool tornTail = false;   // trailing bytes did not form a valid frame
+};
+
+// Apply every frame in path with a sequence number above afterSeq. A
+// missing file is an empty journal. lib must not have a journal attached.
+// A frame that does not apply ends the replay with ok false, unless
+// skipFailed, which reports it and goes on with the next.
+ReplayResult replayJournal(const std::string &path, LibraryStorage &lib, uint64_t afterSeq,
+                           bool skipFailed = false);
+
+// Sync the journal, write a snapshot covering everything in it, then
+// truncate the journal.
+bool compactJournal(const LibraryStorage &lib, Journal &journal,
+                    const std::string &snapshotPath);
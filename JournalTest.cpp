@@ -0,0 +1,234 @@
+#include "Journal.h"
+#include "Snapshot.h"
+#include "TestCheck.h"
+#include <csignal>
+#include <filesystem>
+#include <iostream>
+#include <string>
+#include <sys/resource.h>
+#include <unistd.h>
+
+using namespace std;
+
+/*
+ * File: JournalTest.cpp
+ * ---------------------
+ * LibraryCheckout_journal_test: write-ahead journal round trips (run by
+ * ctest). A storage is changed through every journaled kind of operation
+ * and the journal is replayed into a fresh storage, which must come out
+ * the same. Also covers group commit, a torn tail being cut off and
+ * appended after, a frame that does not apply stopping the replay,
+ * compaction into a snapshot, and a write that fails part way.
+ *
+ * Data Table (identifier | datatype | use)
+ * ----------------------------------------------------------------------
+ * SHELVES | size_t | Shelves every storage here starts with (not journaled)
+ *
+ */
+
+namespace {
+
+constexpr size_t SHELVES = 2;
+
+unique_ptr<Item> book(int id) {
+    return make_unique<Book>("Book " + to_string(id), "", id, "Title", "Author", "2000");
+}
+
+// One of each journaled operation; every call must succeed.
+void changeEverything(LibraryStorage &lib) {
+    CHECK(lib.addItem(book(1), 0, 0));
+    CHECK(lib.addItem(book(2), 0, 1));
+    CHECK(lib.addItem(make_unique<Movie>("Heat", "Heist", 3, "Heat", "Mann",
+                                         vector<string>{"Pacino", "De Niro"}),
+                      1, 3));
+    CHECK(lib.addShelf(20));
+    CHECK(lib.addItem(make_unique<Magazine>("Wired", "", 4, "Vol. 7", "Cover"), 2, 19));
+    CHECK(lib.checkoutItem(0, 0, "Ann", "2026-03-01"));
+    CHECK(lib.placeHold(0, 0, "Bob"));
+    CHECK(lib.placeHold(0, 0, "Cy"));
+    CHECK(lib.cancelHold(0, 0, "Cy"));
+    CHECK(lib.swapItems(0, 1, 1, 3));
+    CHECK(lib.moveItem(2, 19, 2, 0));
+    LibraryStorage::Transaction tx;
+    tx.checkoutItem(0, 1, "Dee", "2026-04-01").moveItem(1, 3, 1, 4);
+    CHECK(lib.commit(tx));
+    CHECK(lib.checkinItem(0, 0));  // set aside for Bob
+    CHECK(lib.removeItem(1, 4));
+    lib.reserveShelves(4);
+}
+
+void testRoundTrip(const filesystem::path &dir) {
+    string path = (dir / "round.journal").string();
+    LibraryStorage lib(SHELVES);
+    Journal journal;
+    CHECK(journal.open(path, 0, 0));
+    lib.attachJournal(&journal);
+    changeEverything(lib);
+    lib.attachJournal(nullptr);
+    uint64_t logged = journal.lastSeq();
+    journal.close();
+
+    LibraryStorage replayed(SHELVES);
+    ReplayResult r = replayJournal(path, replayed, 0);
+    CHECK(r.ok && !r.tornTail && r.skipped == 0);
+    CHECK(r.applied == logged && r.lastSeq == logged);
+    CHECK(r.validBytes == filesystem::file_size(path));
+    CHECK(dumpStorage(replayed) == dumpStorage(lib));
+    CHECK(replayed.pickupFor(0, 0) == "Bob");
+
+    // Frames at or below a snapshot's sequence number are skipped.
+    LibraryStorage none(SHELVES);
+    CHECK(replayJournal(path, none, logged).applied == 0);
+}
+
+void testGroupCommit(const filesystem::path &dir) {
+    string path = (dir / "group.journal").string();
+    LibraryStorage lib(SHELVES);
+    Journal journal(4);
+    CHECK(journal.open(path, 0, 0));
+    lib.attachJournal(&journal);
+    for (int i = 0; i < 3; ++i) CHECK(lib.addItem(book(i), 0, static_cast<size_t>(i)));
+    CHECK(journal.pending() == 3 && filesystem::file_size(path) == 0);
+    CHECK(lib.addItem(book(3), 0, 3));
+    CHECK(journal.pending() == 0 && filesystem::file_size(path) > 0);
+    CHECK(lib.addItem(book(4), 0, 4));
+    CHECK(journal.pending() == 1 && journal.sync() && journal.pending() == 0);
+    lib.attachJournal(nullptr);
+    journal.close();
+
+    LibraryStorage replayed(SHELVES);
+    CHECK(replayJournal(path, replayed, 0).applied == 5);
+    CHECK(dumpStorage(replayed) == dumpStorage(lib));
+}
+
+void testTornTail(const filesystem::path &dir) {
+    string path = (dir / "torn.journal").string();
+    LibraryStorage lib(SHELVES);
+    Journal journal;
+    CHECK(journal.open(path, 0, 0));
+    lib.attachJournal(&journal);
+    changeEverything(lib);
+    lib.attachJournal(nullptr);
+    uint64_t logged = journal.lastSeq();
+    journal.close();
+    auto size = filesystem::file_size(path);
+    filesystem::resize_file(path, size - 5);
+
+    // Everything but the torn last frame comes back ...
+    LibraryStorage partial(SHELVES);
+    ReplayResult r = replayJournal(path, partial, 0);
+    CHECK(r.ok && r.tornTail && r.applied == logged - 1 && r.lastSeq == logged - 1);
+    CHECK(r.validBytes < size - 5);
+
+    // ... and reopening cuts the tail off, so new frames follow the intact
+    // ones and the whole file replays again.
+    Journal reopened;
+    CHECK(reopened.open(path, r.lastSeq, r.validBytes));
+    CHECK(filesystem::file_size(path) == r.validBytes);
+    partial.attachJournal(&reopened);
+    CHECK(partial.addItem(book(9), 1, 10));
+    partial.attachJournal(nullptr);
+    reopened.close();
+
+    LibraryStorage again(SHELVES);
+    ReplayResult r2 = replayJournal(path, again, 0);
+    CHECK(r2.ok && !r2.tornTail && r2.applied == logged && r2.lastSeq == logged);
+    CHECK(dumpStorage(again) == dumpStorage(partial));
+}
+
+void testFailedFrame(const filesystem::path &dir) {
+    string path = (dir / "fails.journal").string();
+    LibraryStorage lib(SHELVES);
+    Journal journal;
+    CHECK(journal.open(path, 0, 0));
+    lib.attachJournal(&journal);
+    CHECK(lib.addItem(book(1), 0, 0));
+    CHECK(lib.addItem(book(2), 0, 1));
+    CHECK(lib.addItem(book(3), 0, 2));
+    lib.attachJournal(nullptr);
+    journal.close();
+
+    // Frame 2 no longer applies: its compartment is taken.
+    LibraryStorage clash(SHELVES);
+    CHECK(clash.addItem(book(7), 0, 1));
+    ReplayResult r = replayJournal(path, clash, 0);
+    CHECK(!r.ok && r.failedSeq == 2 && r.applied == 1);
+    CHECK(!clash.findById(3));
+
+    LibraryStorage skipping(SHELVES);
+    CHECK(skipping.addItem(book(7), 0, 1));
+    ReplayResult s = replayJournal(path, skipping, 0, true);
+    CHECK(s.ok && s.failedSeq == 0 && s.applied == 2 && s.skipped == 1 && s.lastSeq == 3);
+    CHECK(skipping.findById(3) && skipping.findById(7));
+}
+
+void testCompaction(const filesystem::path &dir) {
+    string path = (dir / "compact.journal").string();
+    string snapshot = (dir / "compact.snap").string();
+    LibraryStorage lib(SHELVES);
+    Journal journal;
+    CHECK(journal.open(path, 0, 0));
+    lib.attachJournal(&journal);
+    changeEverything(lib);
+    CHECK(compactJournal(lib, journal, snapshot));
+    CHECK(filesystem::file_size(path) == 0);
+    CHECK(lib.addItem(book(20), 1, 0));
+    CHECK(lib.checkoutItem(1, 0, "Eve", ""));
+    lib.attachJournal(nullptr);
+    journal.close();
+
+    LibraryStorage restored(0);
+    uint64_t seq = 0;
+    CHECK(loadSnapshot(snapshot, restored, &seq));
+    ReplayResult r = replayJournal(path, restored, seq);
+    CHECK(r.ok && r.applied == 2);
+    CHECK(dumpStorage(restored) == dumpStorage(lib));
+}
+
+// A write cut short by RLIMIT_FSIZE: the frames that made it are no longer
+// pending, the rest are written by the next sync, and the file holds each
+// frame exactly once.
+void testWriteFailure(const filesystem::path &dir) {
+    string path = (dir / "short.journal").string();
+    Journal journal(100);
+    CHECK(journal.open(path, 0, 0));
+    journal.logCheckin(0, 0);
+    CHECK(journal.sync());
+    auto frame = filesystem::file_size(path);  // every check-in frame is this long
+    for (size_t c = 1; c <= 5; ++c) journal.logCheckin(0, c);
+
+    signal(SIGXFSZ, SIG_IGN);
+    rlimit saved{};
+    getrlimit(RLIMIT_FSIZE, &saved);
+    rlimit limit = saved;
+    limit.rlim_cur = static_cast<rlim_t>(3 * frame + 3);  // two more frames and a bit
+    setrlimit(RLIMIT_FSIZE, &limit);
+    CHECK(!journal.sync());
+    setrlimit(RLIMIT_FSIZE, &saved);
+    CHECK(journal.pending() == 3);
+
+    CHECK(journal.sync() && journal.pending() == 0);
+    CHECK(filesystem::file_size(path) == 6 * frame);
+    journal.close();
+    LibraryStorage lib(1);
+    ReplayResult r = replayJournal(path, lib, 0, true);
+    CHECK(r.ok && !r.tornTail && r.lastSeq == 6 && r.skipped == 6);
+}
+
+} // namespace
+
+int main() {
+    filesystem::path dir =
+        filesystem::temp_directory_path() / ("journal_test_" + to_string(getpid()));
+    filesystem::create_directories(dir);
+
+    testRoundTrip(dir);
+    testGroupCommit(dir);
+    testTornTail(dir);
+    testFailedFrame(dir);
+    testCompaction(dir);
+    testWriteFailure(dir);
+
+    filesystem::remove_all(dir);
+    return testSummary("journal");
+}
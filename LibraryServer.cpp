@@ -0,0 +1,338 @@
+#include "LibraryServer.h"
+#include "Journal.h"
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <string_view>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+using namespace std;
+
+/*
+ * File: LibraryServer.cpp
+ * -----------------------
+ * Implements the epoll server declared in LibraryServer.h. The loop is
+ * level-triggered: each wakeup reads at most one buffer per ready socket,
+ * so one busy client cannot starve the others, and anything left unread
+ * is reported again on the next wakeup.
+ */
+
+namespace {
+
+constexpr size_t READ_CHUNK = 64 * 1024;
+constexpr int MAX_EVENTS = 256;
+
+bool hasCompleteLine(const string &in, bool eof) {
+    return in.find('\n') != string::npos || (eof && !in.empty());
+}
+
+} // namespace
+
+double ServerStats::commandsPerSecond() const {
+    return seconds > 0 ? static_cast<double>(commands) / seconds : 0.0;
+}
+
+LibraryServer::LibraryServer(LibraryStorage &lib_, Journal *journal_)
+    : lib(lib_), journal(journal_) {}
+
+LibraryServer::~LibraryServer() {
+    for (auto &[fd, c] : connections) ::close(fd);
+    if (listenFd >= 0) ::close(listenFd);
+    if (epollFd >= 0) ::close(epollFd);
+    if (wakeFd >= 0) ::close(wakeFd);
+    if (!unixPath.empty()) unlink(unixPath.c_str());
+}
+
+bool LibraryServer::listen(const string &address) {
+    epollFd = epoll_create1(EPOLL_CLOEXEC);
+    wakeFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (epollFd < 0 || wakeFd < 0) {
+        cerr << "Error: Could not set up the event loop: " << strerror(errno) << "\n";
+        return false;
+    }
+    if (!bindAddress(address)) return false;
+    for (int fd : {listenFd, wakeFd}) {
+        epoll_event ev{};
+        ev.events = EPOLLIN;
+        ev.data.fd = fd;
+        if (epoll_ctl(epollFd, EPOLL_CTL_ADD, fd, &ev) != 0) {
+            cerr << "Error: Could not watch the listening socket: " << strerror(errno) << "\n";
+            return false;
+        }
+    }
+    return true;
+}
+
+bool LibraryServer::bindAddress(const string &address) {
+    if (address.rfind("unix:", 0) == 0) {
+        string path = address.substr(5);
+        sockaddr_un sa{};
+        sa.sun_family = AF_UNIX;
+        if (path.empty() || path.size() >= sizeof(sa.sun_path)) {
+            cerr << "Error: Invalid socket path \"" << path << "\".\n";
+            return false;
+        }
+        memcpy(sa.sun_path, path.c_str(), path.size() + 1);
+        // A socket file left behind by an earlier run would make bind fail.
+        struct stat st {};
+        if (lstat(path.c_str(), &st) == 0 && S_ISSOCK(st.st_mode)) unlink(path.c_str());
+        listenFd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+        if (listenFd < 0 || bind(listenFd, reinterpret_cast<sockaddr *>(&sa), sizeof(sa)) != 0
+            || ::listen(listenFd, SOMAXCONN) != 0) {
+            cerr << "Error: Could not listen on \"" << path << "\": " << strerror(errno)
+                 << "\n";
+            return false;
+        }
+        unixPath = path;
+        return true;
+    }
+
+    size_t colon = address.rfind(':');
+    string host = colon == string::npos ? "127.0.0.1" : address.substr(0, colon);
+    string port = colon == string::npos ? address : address.substr(colon + 1);
+    if (host.size() > 2 && host.front() == '[' && host.back() == ']') {
+        host = host.substr(1, host.size() - 2);
+    }
+    addrinfo hints{};
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    hints.ai_flags = AI_PASSIVE;
+    addrinfo *found = nullptr;
+    int rc = getaddrinfo(host.empty() ? nullptr : host.c_str(), port.c_str(), &hints, &found);
+    if (rc != 0) {
+        cerr << "Error: Cannot resolve \"" << address << "\": " << gai_strerror(rc) << "\n";
+        return false;
+    }
+    int err = 0;
+    for (addrinfo *ai = found; ai; ai = ai->ai_next) {
+        int fd = socket(ai->ai_family, ai->ai_socktype | SOCK_NONBLOCK | SOCK_CLOEXEC,
+                        ai->ai_protocol);
+        if (fd < 0) {
+            err = errno;
+            continue;
+        }
+        int one = 1;
+        setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+        if (bind(fd, ai->ai_addr, ai->ai_addrlen) == 0 && ::listen(fd, SOMAXCONN) == 0) {
+            listenFd = fd;
+            break;
+        }
+        err = errno;
+        ::close(fd);
+    }
+    freeaddrinfo(found);
+    if (listenFd < 0) {
+        cerr << "Error: Could not listen on \"" << address << "\": " << strerror(err) << "\n";
+        return false;
+    }
+    return true;
+}
+
+void LibraryServer::stop() {
+    if (wakeFd < 0) return;
+    uint64_t one = 1;
+    ssize_t n = write(wakeFd, &one, sizeof(one));
+    (void)n;
+}
+
+void LibraryServer::acceptAll(ServerStats &stats) {
+    while (true) {
+        int fd = accept4(listenFd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (fd < 0) {
+            if (errno == EINTR || errno == ECONNABORTED) continue;
+            if (errno != EAGAIN && errno != EWOULDBLOCK) {
+                cerr << "Error: accept failed: " << strerror(errno) << "\n";
+            }
+            return;
+        }
+        // Replies are written once per batch; do not hold them back further.
+        int one = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+        auto c = make_unique<Connection>(fd, lib);
+        epoll_event ev{};
+        ev.events = EPOLLIN;
+        ev.data.fd = fd;
+        if (epoll_ctl(epollFd, EPOLL_CTL_ADD, fd, &ev) != 0) {
+            ::close(fd);
+            continue;
+        }
+        c->events = EPOLLIN;
+        connections.emplace(fd, move(c));
+        ++stats.connections;
+    }
+}
+
+bool LibraryServer::receive(Connection &c) {
+    char buf[READ_CHUNK];
+    ssize_t n;
+    do {
+        n = recv(c.fd, buf, sizeof(buf), 0);
+    } while (n < 0 && errno == EINTR);
+    if (n < 0) return errno == EAGAIN || errno == EWOULDBLOCK;
+    if (n == 0) c.eof = true;
+    c.in.append(buf, static_cast<size_t>(n));
+
+    if (c.in.size() > MAX_LINE && c.in.find('\n') == string::npos) {
+        c.out += "error: line too long\n";
+        c.in.clear();
+        c.eof = true;
+    }
+    return true;
+}
+
+void LibraryServer::execute(Connection &c, ServerStats &stats) {
+    string_view in = c.in;
+    size_t pos = 0;
+    while (pos < in.size() && c.pending() < MAX_PENDING_REPLY) {
+        size_t nl = in.find('\n', pos);
+        if (nl == string_view::npos && !c.eof) break;
+        size_t end = nl == string_view::npos ? in.size() : nl;
+        string_view line = in.substr(pos, end - pos);
+        if (!line.empty() && line.back() == '\r') line.remove_suffix(1);
+        pos = nl == string_view::npos ? in.size() : nl + 1;
+
+        size_t before = c.out.size();
+        bool done = c.processor.execute(line, c.out);
+        if (c.out.size() == before) continue;  // blank or comment
+        ++stats.commands;
+        if (!done) ++stats.failed;
+    }
+    c.in.erase(0, pos);
+}
+
+bool LibraryServer::flush(Connection &c) {
+    while (c.pending() > 0) {
+        ssize_t n = send(c.fd, c.out.data() + c.sent, c.pending(), MSG_NOSIGNAL);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            if (errno == EAGAIN || errno == EWOULDBLOCK) break;
+            return false;
+        }
+        c.sent += static_cast<size_t>(n);
+    }
+    if (c.sent == c.out.size()) {
+        c.out.clear();
+        c.sent = 0;
+    } else if (c.sent > c.out.size() / 2) {
+        c.out.erase(0, c.sent);
+        c.sent = 0;
+    }
+    return true;
+}
+
+void LibraryServer::watch(Connection &c) {
+    uint32_t want = 0;
+    if (!c.eof && c.pending() < MAX_PENDING_REPLY) want |= EPOLLIN;
+    if (c.pending() > 0) want |= EPOLLOUT;
+    if (want == c.events) return;
+    epoll_event ev{};
+    ev.events = want;
+    ev.data.fd = c.fd;
+    epoll_ctl(epollFd, EPOLL_CTL_MOD, c.fd, &ev);
+    c.events = want;
+}
+
+void LibraryServer::close(Connection &c) {
+    int fd = c.fd;
+    epoll_ctl(epollFd, EPOLL_CTL_DEL, fd, nullptr);
+    ::close(fd);
+    connections.erase(fd);
+}
+
+ServerStats LibraryServer::run() {
+    ServerStats stats;
+    auto start = chrono::steady_clock::now();
+    epoll_event events[MAX_EVENTS];
+    vector<Connection *> active;
+    vector<Connection *> broken;
+    vector<size_t> marks;  // active[i]'s reply size before the batch
+    bool stopping = false;
+
+    while (!stopping) {
+        // Leftover lines are executed straight away, not after the next event.
+        int n = epoll_wait(epollFd, events, MAX_EVENTS, backlog.empty() ? -1 : 0);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            cerr << "Error: epoll_wait failed: " << strerror(errno) << "\n";
+            break;
+        }
+        active.swap(backlog);
+        backlog.clear();
+        broken.clear();
+        for (Connection *c : active) c->queued = true;
+
+        for (int i = 0; i < n; ++i) {
+            int fd = events[i].data.fd;
+            if (fd == wakeFd) {
+                stopping = true;
+                continue;
+            }
+            if (fd == listenFd) {
+                acceptAll(stats);
+                continue;
+            }
+            auto it = connections.find(fd);
+            if (it == connections.end()) continue;
+            Connection &c = *it->second;
+            if ((events[i].events & (EPOLLIN | EPOLLHUP | EPOLLERR)) && !c.eof
+                && !receive(c)) {
+                broken.push_back(&c);
+                c.eof = true;
+            }
+            if (!c.queued) {
+                c.queued = true;
+                active.push_back(&c);
+            }
+        }
+
+        // One batch: execute, make it durable, then reply.
+        uint64_t before = stats.commands;
+        marks.clear();
+        for (Connection *c : active) {
+            marks.push_back(c->out.size());
+            execute(*c, stats);
+        }
+        bool durable = true;
+        if (stats.commands != before) {
+            ++stats.batches;
+            if (journal && journal->isOpen()) durable = journal->sync();
+        }
+        for (size_t i = 0; i < active.size(); ++i) {
+            Connection *c = active[i];
+            c->queued = false;
+            if (!durable && c->out.size() > marks[i]) {
+                // Nothing of this batch is acknowledged: the client gets
+                // the replies from before it, then the connection closes.
+                c->out.resize(marks[i]);
+                c->in.clear();
+                c->eof = true;
+                ++stats.unacknowledged;
+            }
+            bool failed = find(broken.begin(), broken.end(), c) != broken.end();
+            if (failed || !flush(*c) || (c->eof && c->pending() == 0 && c->in.empty())) {
+                close(*c);
+                continue;
+            }
+            if (c->pending() < MAX_PENDING_REPLY && hasCompleteLine(c->in, c->eof)) {
+                backlog.push_back(c);
+            }
+            watch(*c);
+        }
+    }
+
+    for (auto &[fd, c] : connections) ::close(fd);
+    connections.clear();
+    backlog.clear();
+    stats.seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    return stats;
+}
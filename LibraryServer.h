@@ -0,0 +1,116 @@
+#pragma once
+#include "CommandProcessor.h"
+#include "LibraryStorage.h"
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+/*
+ * File: LibraryServer.h
+ * ---------------------
+ * Network front end for one shared LibraryStorage. Clients connect over
+ * TCP or a Unix socket and speak the line protocol of CommandProcessor.h:
+ * one command per line, one reply per command, in order. A client may
+ * pipeline as many commands as it likes without waiting for replies.
+ *
+ * One thread runs an epoll loop over non-blocking sockets, so the storage
+ * needs no locking. Each wakeup is one batch: every ready connection's
+ * complete lines are executed, the journal (if any) is synced once, and
+ * only then are the replies written back, so a reply is never sent for an
+ * operation that is not yet durable. If the sync fails, the batch's
+ * replies are dropped and every connection that sent commands in it is
+ * closed once its earlier replies are out: the client sees the connection
+ * end instead of an "ok" the journal does not back. Every connection has
+ * its own CommandProcessor, so a transaction (begin ... commit) belongs
+ * to the client that opened it.
+ *
+ * A connection with more than MAX_PENDING_REPLY bytes of replies unsent
+ * is not read from until the client catches up, so a client that never
+ * reads cannot make the server buffer without bound.
+ *
+ * Data Table (identifier | datatype | use)
+ * ----------------------------------------------------------------------
+ * ServerStats | struct                          | Summary of one run()
+ * Connection  | struct                          | Socket, buffers and processor of a client
+ * connections | unordered_map<int, unique_ptr>  | Open clients by file descriptor
+ * listenFd    | int                             | Listening socket
+ * epollFd     | int                             | The epoll instance
+ * wakeFd      | int                             | eventfd written by stop()
+ * unixPath    | std::string                     | Socket file to remove on shutdown
+ * backlog     | std::vector<Connection*>        | Clients with lines left after a batch
+ *
+ */
+
+struct ServerStats {
+    size_t connections = 0;       // accepted over the whole run
+    uint64_t commands = 0;
+    uint64_t failed = 0;          // commands whose reply was an error
+    uint64_t batches = 0;         // wakeups that executed at least one command
+    uint64_t unacknowledged = 0;  // connections closed by a failed journal sync
+    double seconds = 0.0;
+
+    double commandsPerSecond() const;
+};
+
+class Journal;
+
+class LibraryServer {
+public:
+    static constexpr size_t MAX_PENDING_REPLY = size_t{4} << 20;
+    static constexpr size_t MAX_LINE = size_t{1} << 20;
+
+    explicit LibraryServer(LibraryStorage &lib, Journal *journal = nullptr);
+    ~LibraryServer();
+    LibraryServer(const LibraryServer &) = delete;
+    LibraryServer &operator=(const LibraryServer &) = delete;
+
+    // Listen on "unix:<path>", "<host>:<port>" or just "<port>" (loopback
+    // only). Prints the reason and returns false on failure.
+    bool listen(const std::string &address);
+
+    // Serve clients until stop() is called.
+    ServerStats run();
+
+    // Make run() return after the current batch. Async-signal-safe and
+    // callable from any thread.
+    void stop();
+
+private:
+    struct Connection {
+        int fd;
+        CommandProcessor processor;
+        std::string in;      // received bytes not yet executed
+        std::string out;     // replies not yet sent
+        size_t sent = 0;     // bytes of out already sent
+        bool eof = false;    // the client will send nothing more
+        bool queued = false; // in this batch's active list
+        uint32_t events = 0; // epoll interest currently registered
+
+        Connection(int fd, LibraryStorage &lib) : fd(fd), processor(lib) {}
+        size_t pending() const { return out.size() - sent; }
+    };
+
+    LibraryStorage &lib;
+    Journal *journal;
+    int listenFd = -1;
+    int epollFd = -1;
+    int wakeFd = -1;
+    std::string unixPath;
+    std::unordered_map<int, std::unique_ptr<Connection>> connections;
+    std::vector<Connection *> backlog;
+
+    bool bindAddress(const std::string &address);
+    void acceptAll(ServerStats &stats);
+    // Read what the socket has; false if the connection failed.
+    bool receive(Connection &c);
+    // Execute complete lines while the reply backlog allows.
+    void execute(Connection &c, ServerStats &stats);
+    // Send what the socket takes; false if the connection failed.
+    bool flush(Connection &c);
+    // Register interest in reads and/or writes to match c's buffers.
+    void watch(Connection &c);
+    void close(Connection &c);
+};
@@ -1,6 +1,11 @@
 #include "LibraryStorage.h"
+#include "Journal.h"
+#include "DueDate.h"
+#include "ReportWriter.h"
+#include "StorageStats.h"
+#include <bit>
 #include <stdexcept>
-#include <algorithm>
+#include <unordered_set>
 
 using namespace std;
 
@@ -9,16 +14,18 @@ using namespace std;
  * ------------------------
  * Implements the storage model declared in LibraryStorage.h. A Compartment
  * owns an Item pointer. LibraryStorage provides operations to add, checkout,
- * checkin, swap, and print items. All operations validate input and report errors.
+ * checkin, swap, and print items. All operations validate input first
+ * and return the reason they refuse; indices are checked once up front,
+ * so the work after that uses the unchecked Shelf accessors.
  */
 
 // ------------------ Compartment ------------------
 Compartment::Compartment() = default;
 
-bool Compartment::isEmpty() const { return ptr == nullptr; }
+bool Compartment::isEmpty() const noexcept { return ptr == nullptr; }
 
-const Item* Compartment::get() const { return ptr.get(); }
-Item* Compartment::get() { return ptr.get(); }
+const Item* Compartment::get() const noexcept { return ptr.get(); }
+Item* Compartment::get() noexcept { return ptr.get(); }
 
 void Compartment::place(unique_ptr<Item> item) {
     ptr = move(item);
@@ -29,19 +36,138 @@ std::unique_ptr<Item> Compartment::remove() {
 }
 
 // ------------------ Shelf  ------------------
-Shelf::Shelf() = default;
-size_t Shelf::capacity() const { return CAP; }
+Shelf::Shelf(size_t capacity) : cap(capacity) {
+    if (capacity == 0 || capacity > MAX_CAPACITY) {
+        throw invalid_argument("Shelf capacity must be between 1 and "
+                               + to_string(MAX_CAPACITY));
+    }
+    comps = make_unique<Compartment[]>(capacity);
+}
+size_t Shelf::capacity() const { return cap; }
 Compartment& Shelf::operator[](size_t idx) {
-    if (idx >= CAP) throw out_of_range("Compartment index out of range");
+    if (idx >= cap) throw out_of_range("Compartment index out of range");
     return comps[idx];
 }
 const Compartment& Shelf::operator[](size_t idx) const {
-    if (idx >= CAP) throw out_of_range("Compartment index out of range");
+    if (idx >= cap) throw out_of_range("Compartment index out of range");
     return comps[idx];
 }
 
+// ------------------ Occupancy bitmaps ------------------
+namespace {
+
+constexpr size_t NO_SHELF = SIZE_MAX;
+
+uint64_t fullMask(size_t capacity) {
+    return capacity >= 64 ? ~uint64_t{0} : (uint64_t{1} << capacity) - 1;
+}
+
+void setBit(vector<uint64_t> &bits, size_t i, bool on) {
+    uint64_t m = uint64_t{1} << (i & 63);
+    if (on) {
+        bits[i >> 6] |= m;
+    } else {
+        bits[i >> 6] &= ~m;
+    }
+}
+
+// Lowest set bit at or after from, or NO_SHELF.
+size_t nextSetBit(const vector<uint64_t> &bits, size_t from) {
+    size_t w = from >> 6;
+    if (w >= bits.size()) return NO_SHELF;
+    uint64_t word = bits[w] & (~uint64_t{0} << (from & 63));
+    while (!word) {
+        if (++w == bits.size()) return NO_SHELF;
+        word = bits[w];
+    }
+    return (w << 6) + static_cast<size_t>(countr_zero(word));
+}
+
+// Highest set bit at or before from, or NO_SHELF.
+size_t prevSetBit(const vector<uint64_t> &bits, size_t from) {
+    size_t w = from >> 6;
+    if (w >= bits.size()) return NO_SHELF;
+    uint64_t word = bits[w] & (~uint64_t{0} >> (63 - (from & 63)));
+    while (!word) {
+        if (w-- == 0) return NO_SHELF;
+        word = bits[w];
+    }
+    return (w << 6) + 63 - static_cast<size_t>(countl_zero(word));
+}
+
+} // namespace
+
+double OccupancyStats::fillRatio() const {
+    return compartments ? static_cast<double>(used) / static_cast<double>(compartments) : 0.0;
+}
+
 // ------------------ LibraryStorage ------------------
-LibraryStorage::LibraryStorage(size_t numShelves) : shelves(numShelves) {}
+LibraryStorage::LibraryStorage(size_t numShelves)
+    : shelves(min(numShelves, LoanIndex::MAX_INDEX + 1)) {
+    trackNewShelves();
+}
+
+void LibraryStorage::trackNewShelves() {
+    size_t first = occupancy.size();
+    size_t words = (shelves.size() + 63) / 64;
+    occupancy.resize(shelves.size(), 0);
+    typeCounts.resize(shelves.size(), {});
+    shelvesWithRoom.resize(words, 0);
+    for (auto &bits : typeRoom) bits.resize(words, 0);
+    for (size_t s = first; s < shelves.size(); ++s) updateRoom(s);
+}
+
+void LibraryStorage::updateRoom(size_t shelfIdx) {
+    bool room = occupancy[shelfIdx] != fullMask(shelves[shelfIdx].capacity());
+    setBit(shelvesWithRoom, shelfIdx, room);
+    for (size_t t = 0; t < NUM_TYPES; ++t) {
+        setBit(typeRoom[t], shelfIdx, room && typeCounts[shelfIdx][t] > 0);
+    }
+}
+
+void LibraryStorage::markSlot(size_t shelfIdx, size_t compIdx, bool used) {
+    uint64_t bit = uint64_t{1} << compIdx;
+    uint64_t before = occupancy[shelfIdx];
+    occupancy[shelfIdx] = used ? before | bit : before & ~bit;
+    if (occupancy[shelfIdx] != before) updateRoom(shelfIdx);
+}
+
+void LibraryStorage::placeAt(size_t shelfIdx, size_t compIdx, unique_ptr<Item> item) {
+    size_t t = static_cast<size_t>(item->type());
+    shelves[shelfIdx].unchecked(compIdx).place(move(item));
+    if (typeCounts[shelfIdx][t]++ == 0) updateRoom(shelfIdx);
+    markSlot(shelfIdx, compIdx, true);
+}
+
+unique_ptr<Item> LibraryStorage::takeFrom(size_t shelfIdx, size_t compIdx, bool keepUsed) {
+    unique_ptr<Item> item = shelves[shelfIdx].unchecked(compIdx).remove();
+    size_t t = static_cast<size_t>(item->type());
+    if (--typeCounts[shelfIdx][t] == 0) updateRoom(shelfIdx);
+    markSlot(shelfIdx, compIdx, keepUsed);
+    return item;
+}
+
+LibraryStorage::~LibraryStorage() {
+    // Items may live in the arena; release them while it still exists.
+    checkedOut.clear();
+    shelves.clear();
+}
+
+ItemArena *LibraryStorage::enableArena() {
+    if (!arena) arena = make_unique<ItemArena>();
+    return arena.get();
+}
+
+ItemArena *LibraryStorage::itemArena() const { return arena.get(); }
+
+void LibraryStorage::enableSearch() {
+    if (searchIndex) return;
+    searchIndex = make_unique<SearchIndex>();
+    for (const ItemLocation &loc : items()) searchIndex->add(loc.item);
+    for (const ItemLocation &loc : loans()) searchIndex->add(loc.item);
+}
+
+bool LibraryStorage::searchEnabled() const { return searchIndex != nullptr; }
 size_t LibraryStorage::numShelves() const { return shelves.size(); }
 
 Shelf& LibraryStorage::operator[](size_t idx) {
@@ -53,152 +179,784 @@ const Shelf& LibraryStorage::operator[](size_t idx) const {
     return shelves[idx];
 }
 
-bool LibraryStorage::addItem(unique_ptr<Item> item, size_t shelfIdx, size_t compIdx) {
-    if (shelfIdx >= shelves.size()) {
-        cerr << "Error: Shelf " << shelfIdx << " does not exist.\n";
-        return false;
+void LibraryStorage::attachJournal(Journal *j) { journal = j; }
+
+void LibraryStorage::reserveShelves(size_t n) {
+    STORAGE_OP_SCOPE(StorageOp::ReserveShelves);
+    n = min(n, LoanIndex::MAX_INDEX + 1);
+    if (n <= shelves.size()) return;
+    shelves.resize(n);
+    trackNewShelves();
+    if (journal) journal->logReserveShelves(n);
+}
+
+Result<size_t> LibraryStorage::addShelf(size_t capacity) {
+    STORAGE_OP_SCOPE(StorageOp::AddShelf);
+    if (capacity == 0 || capacity > Shelf::MAX_CAPACITY) {
+        return STORAGE_OP_FAIL(StorageError::InvalidArgument);
     }
-    try {
-        Compartment &c = shelves[shelfIdx][compIdx];
-        if (!c.isEmpty()) {
-            cerr << "Error: Compartment " << compIdx << " on shelf " << shelfIdx
-                 << " is already occupied.\n";
-            return false;
+    if (shelves.size() > LoanIndex::MAX_INDEX) return STORAGE_OP_FAIL(StorageError::StorageFull);
+    shelves.emplace_back(capacity);
+    trackNewShelves();
+    if (journal) journal->logAddShelf(capacity);
+    return shelves.size() - 1;
+}
+
+optional<StorageError> LibraryStorage::checkLocation(size_t shelfIdx,
+                                                     size_t compIdx) const noexcept {
+    if (shelfIdx >= shelves.size()) return StorageError::NoSuchShelf;
+    if (compIdx >= shelves[shelfIdx].capacity()) return StorageError::NoSuchCompartment;
+    return nullopt;
+}
+
+Result<void> LibraryStorage::addItem(unique_ptr<Item> item, size_t shelfIdx, size_t compIdx) {
+    STORAGE_OP_SCOPE(StorageOp::AddItem);
+    if (optional<StorageError> err = checkLocation(shelfIdx, compIdx)) {
+        return STORAGE_OP_FAIL(*err);
+    }
+    Compartment &c = shelves[shelfIdx].unchecked(compIdx);
+    uint64_t key = LoanIndex::makeKey(shelfIdx, compIdx);
+    // A loaned item comes back to its compartment, so that is not free either.
+    if (!c.isEmpty() || loanIndex.find(key) != LoanIndex::NPOS) {
+        return STORAGE_OP_FAIL(StorageError::Occupied);
+    }
+    int id = item->getId();
+    placeAt(shelfIdx, compIdx, move(item));
+    idIndex.emplace(id, key);
+    if (searchIndex) searchIndex->add(c.get());
+    if (journal) journal->logAddItem(*c.get(), shelfIdx, compIdx);
+    return {};
+}
+
+vector<IngestError> LibraryStorage::addItems(span<PlacedItem> batch) {
+    STORAGE_OP_SCOPE(StorageOp::AddItems);
+    vector<IngestError> errors;
+    vector<bool> valid(batch.size(), false);
+    unordered_set<uint64_t> claimed;
+    claimed.reserve(batch.size());
+
+    // Pass 1: validate every row against the current state and the rows
+    // before it, so the batch is checked as a whole before anything moves.
+    for (size_t i = 0; i < batch.size(); ++i) {
+        const PlacedItem &p = batch[i];
+        if (!p.item) {
+            errors.push_back({i, "No item given"});
+            continue;
+        }
+        if (p.shelf == PlacedItem::ANYWHERE) {
+            valid[i] = true;
+            continue;
+        }
+        if (p.shelf >= shelves.size()) {
+            errors.push_back({i, "Shelf " + to_string(p.shelf) + " does not exist"});
+            continue;
+        }
+        if (p.comp >= shelves[p.shelf].capacity()) {
+            errors.push_back({i, "Compartment index out of range"});
+            continue;
+        }
+        if (!shelves[p.shelf].unchecked(p.comp).isEmpty()) {
+            errors.push_back({i, "Compartment " + to_string(p.comp) + " on shelf "
+                                 + to_string(p.shelf) + " is already occupied"});
+            continue;
+        }
+        if (loanIndex.find(LoanIndex::makeKey(p.shelf, p.comp)) != LoanIndex::NPOS) {
+            errors.push_back({i, "Compartment " + to_string(p.comp) + " on shelf "
+                                 + to_string(p.shelf) + " has an item checked out"});
+            continue;
+        }
+        if (!claimed.insert(LoanIndex::makeKey(p.shelf, p.comp)).second) {
+            errors.push_back({i, "Compartment " + to_string(p.comp) + " on shelf "
+                                 + to_string(p.shelf) + " is used by an earlier row"});
+            continue;
         }
-        c.place(move(item));
-        return true;
-    } catch (const out_of_range &e) {
-        cerr << "Error: " << e.what() << "\n";
-        return false;
+        valid[i] = true;
+    }
+
+    // Pass 2: store the rows that passed, those with a fixed location
+    // first so that rows placed anywhere cannot take their compartments.
+    idIndex.reserve(idIndex.size() + batch.size());
+    for (int anywhere = 0; anywhere < 2; ++anywhere) {
+        for (size_t i = 0; i < batch.size(); ++i) {
+            PlacedItem &p = batch[i];
+            if (!valid[i] || (p.shelf == PlacedItem::ANYWHERE) != (anywhere == 1)) continue;
+            if (anywhere) {
+                p.shelf = pickShelf(Placement::FirstFit, p.item->type(), 0);
+                if (p.shelf == NO_SHELF) {
+                    p.shelf = PlacedItem::ANYWHERE;
+                    errors.push_back({i, "No free compartment left"});
+                    continue;
+                }
+                p.comp = static_cast<size_t>(countr_one(occupancy[p.shelf]));
+            }
+            int id = p.item->getId();
+            placeAt(p.shelf, p.comp, move(p.item));
+            const Item *stored = shelves[p.shelf].unchecked(p.comp).get();
+            idIndex.emplace(id, LoanIndex::makeKey(p.shelf, p.comp));
+            if (searchIndex) searchIndex->add(stored);
+            if (journal) journal->logAddItem(*stored, p.shelf, p.comp);
+        }
+    }
+    if (!errors.empty()) (void)STORAGE_OP_FAIL(StorageError::RowsRejected);
+    return errors;
+}
+
+Result<void> LibraryStorage::checkoutItem(size_t shelfIdx, size_t compIdx, string person,
+                                          string dueDate) {
+    STORAGE_OP_SCOPE(StorageOp::CheckoutItem);
+    if (optional<StorageError> err = checkLocation(shelfIdx, compIdx)) {
+        return STORAGE_OP_FAIL(*err);
+    }
+    if (shelves[shelfIdx].unchecked(compIdx).isEmpty()) {
+        return STORAGE_OP_FAIL(StorageError::Empty);
+    }
+    uint64_t key = LoanIndex::makeKey(shelfIdx, compIdx);
+    if (loanIndex.find(key) != LoanIndex::NPOS) {
+        return STORAGE_OP_FAIL(StorageError::AlreadyCheckedOut);
+    }
+    uint32_t holder = pickupPatron(key);
+    if (holder != HoldQueues::NIL && patrons[holder].name != person) {
+        return STORAGE_OP_FAIL(StorageError::HeldForOther);
+    }
+    if (loanCount(person) >= loanLimit) return STORAGE_OP_FAIL(StorageError::LoanLimit);
+    // Anyone still queued now waits for this loan to come back.
+    if (holder != HoldQueues::NIL) holdQueues.setPickup(key, HoldQueues::NIL);
+    unique_ptr<Item> it = takeFrom(shelfIdx, compIdx, true);
+    uint32_t patron = internPatron(move(person));
+    int32_t dueDay = parseDueDay(dueDate).value_or(NO_DUE_DAY);
+    pushCheckedOut({move(it), shelfIdx, compIdx, patron, 0, move(dueDate), dueDay});
+    if (journal) {
+        const CheckedOutRecord &r = checkedOut.back();
+        journal->logCheckout(shelfIdx, compIdx, patrons[patron].name, r.dueDate);
     }
+    return {};
 }
 
-bool LibraryStorage::checkoutItem(size_t shelfIdx, size_t compIdx, string person,
-                                  string dueDate) {
-    if (shelfIdx >= shelves.size()) {
-        cerr << "Error: Shelf " << shelfIdx << " does not exist.\n";
-        return false;
+Result<void> LibraryStorage::checkinItem(size_t shelfIdx, size_t compIdx) {
+    STORAGE_OP_SCOPE(StorageOp::CheckinItem);
+    if (optional<StorageError> err = checkLocation(shelfIdx, compIdx)) {
+        return STORAGE_OP_FAIL(*err);
     }
-    try {
-        Compartment &c = shelves[shelfIdx][compIdx];
-        if (c.isEmpty()) {
-            cerr << "Error: Cannot checkout from empty compartment (" << shelfIdx << ", "
-                 << compIdx << ").\n";
-            return false;
+    uint64_t key = LoanIndex::makeKey(shelfIdx, compIdx);
+    size_t idx = loanIndex.find(key);
+    if (idx == LoanIndex::NPOS) return STORAGE_OP_FAIL(StorageError::NotCheckedOut);
+    if (!shelves[shelfIdx].unchecked(compIdx).isEmpty()) {
+        return STORAGE_OP_FAIL(StorageError::Occupied);
+    }
+    placeAt(shelfIdx, compIdx, move(checkedOut[idx].item));
+    eraseCheckedOut(idx);
+    if (!holdQueues.empty()) holdQueues.advance(key);
+    // Replay passes the item on the same way, so the hand-over is not logged.
+    if (journal) journal->logCheckin(shelfIdx, compIdx);
+    return {};
+}
+
+uint32_t LibraryStorage::pickupPatron(uint64_t key) const {
+    return holdQueues.empty() ? HoldQueues::NIL : holdQueues.pickup(key);
+}
+
+Result<size_t> LibraryStorage::placeHold(size_t shelfIdx, size_t compIdx, string person) {
+    STORAGE_OP_SCOPE(StorageOp::PlaceHold);
+    if (optional<StorageError> err = checkLocation(shelfIdx, compIdx)) {
+        return STORAGE_OP_FAIL(*err);
+    }
+    uint64_t key = LoanIndex::makeKey(shelfIdx, compIdx);
+    size_t loan = loanIndex.find(key);
+    uint32_t pickup = pickupPatron(key);
+    if (loan == LoanIndex::NPOS && pickup == HoldQueues::NIL) {
+        return STORAGE_OP_FAIL(shelves[shelfIdx].unchecked(compIdx).isEmpty()
+                                   ? StorageError::Empty
+                                   : StorageError::NotCheckedOut);
+    }
+    auto known = patronIds.find(person);
+    if (known != patronIds.end()) {
+        uint32_t patron = known->second;
+        if (loan != LoanIndex::NPOS && checkedOut[loan].patron == patron) {
+            return STORAGE_OP_FAIL(StorageError::AlreadyCheckedOut);
+        }
+        if (pickup == patron || holdQueues.position(key, patron) != 0) {
+            return STORAGE_OP_FAIL(StorageError::HoldExists);
         }
-        unique_ptr<Item> it = c.remove();
-        CheckedOutRecord rec{move(it), shelfIdx, compIdx, move(person), move(dueDate)};
-        checkedOut.push_back(move(rec));
-        return true;
-    } catch (const out_of_range &e) {
-        cerr << "Error: " << e.what() << "\n";
-        return false;
     }
+    uint32_t patron = internPatron(move(person));
+    holdQueues.push(key, patron);
+    if (journal) journal->logPlaceHold(shelfIdx, compIdx, patrons[patron].name);
+    return holdQueues.size(key);
+}
+
+Result<void> LibraryStorage::cancelHold(size_t shelfIdx, size_t compIdx, string_view person) {
+    STORAGE_OP_SCOPE(StorageOp::CancelHold);
+    if (optional<StorageError> err = checkLocation(shelfIdx, compIdx)) {
+        return STORAGE_OP_FAIL(*err);
+    }
+    auto known = patronIds.find(person);
+    if (known == patronIds.end()) return STORAGE_OP_FAIL(StorageError::NoSuchHold);
+    uint64_t key = LoanIndex::makeKey(shelfIdx, compIdx);
+    if (pickupPatron(key) == known->second) {
+        holdQueues.advance(key);
+    } else if (!holdQueues.erase(key, known->second)) {
+        return STORAGE_OP_FAIL(StorageError::NoSuchHold);
+    }
+    if (journal) journal->logCancelHold(shelfIdx, compIdx, person);
+    return {};
 }
 
-bool LibraryStorage::checkinItem(size_t shelfIdx, size_t compIdx) {
-    auto it = find_if(checkedOut.begin(), checkedOut.end(),
-                      [&](const CheckedOutRecord &r){
-        return r.origShelf == shelfIdx && r.origComp == compIdx;
-    });
-    if (it == checkedOut.end()) {
-        cerr << "Error: No checked-out item recorded for location (" << shelfIdx << ", "
-             << compIdx << ").\n";
-        return false;
+Result<void> LibraryStorage::restoreHold(size_t shelfIdx, size_t compIdx, string person,
+                                         bool awaitingPickup) {
+    if (optional<StorageError> err = checkLocation(shelfIdx, compIdx)) return *err;
+    uint64_t key = LoanIndex::makeKey(shelfIdx, compIdx);
+    if (awaitingPickup) {
+        if (shelves[shelfIdx].unchecked(compIdx).isEmpty()) return StorageError::Empty;
+        if (loanIndex.find(key) != LoanIndex::NPOS) return StorageError::AlreadyCheckedOut;
+        if (pickupPatron(key) != HoldQueues::NIL) return StorageError::HoldExists;
+        holdQueues.setPickup(key, internPatron(move(person)));
+    } else {
+        holdQueues.push(key, internPatron(move(person)));
     }
-    try {
-        Compartment &c = shelves[shelfIdx][compIdx];
-        if (!c.isEmpty()) {
-            cerr << "Error: Cannot check in; compartment (" << shelfIdx << ", " << compIdx
-                 << ") is already occupied.\n";
-            return false;
+    return {};
+}
+
+optional<string_view> LibraryStorage::pickupFor(size_t shelfIdx, size_t compIdx) const {
+    if (checkLocation(shelfIdx, compIdx)) return nullopt;
+    uint32_t patron = pickupPatron(LoanIndex::makeKey(shelfIdx, compIdx));
+    if (patron == HoldQueues::NIL) return nullopt;
+    return patrons[patron].name;
+}
+
+size_t LibraryStorage::holdCount(size_t shelfIdx, size_t compIdx) const {
+    if (checkLocation(shelfIdx, compIdx)) return 0;
+    return holdQueues.size(LoanIndex::makeKey(shelfIdx, compIdx));
+}
+
+vector<HoldInfo> LibraryStorage::holds() const {
+    vector<HoldInfo> result;
+    for (uint64_t key : holdQueues.keys()) {
+        size_t s = LoanIndex::keyShelf(key), c = LoanIndex::keyComp(key);
+        uint32_t pickup = holdQueues.pickup(key);
+        if (pickup != HoldQueues::NIL) result.push_back({s, c, patrons[pickup].name, 0});
+        size_t pos = 0;
+        for (uint32_t patron : holdQueues.holders(key)) {
+            result.push_back({s, c, patrons[patron].name, ++pos});
         }
-        c.place(move(it->item));
-        checkedOut.erase(it);
-        return true;
-    } catch (const out_of_range &e) {
-        cerr << "Error: " << e.what() << "\n";
-        return false;
     }
+    return result;
 }
 
-bool LibraryStorage::removeItem(size_t shelfIdx, size_t compIdx) {
-    if (shelfIdx >= shelves.size()) {
-        cerr << "Error: Shelf " << shelfIdx << " does not exist.\n";
-        return false;
+vector<ItemLocation> LibraryStorage::awaitingPickup() const {
+    vector<ItemLocation> result;
+    for (uint64_t key : holdQueues.keys()) {
+        uint32_t patron = holdQueues.pickup(key);
+        if (patron == HoldQueues::NIL) continue;
+        size_t s = LoanIndex::keyShelf(key), c = LoanIndex::keyComp(key);
+        result.push_back({shelves[s].unchecked(c).get(), s, c, false, patrons[patron].name, {}});
     }
+    return result;
+}
 
-    try {
-        Compartment &c = shelves[shelfIdx][compIdx];
-        if (c.isEmpty()) {
-            cerr << "Error: Cannot remove from empty compartment ("
-                 << shelfIdx << ", " << compIdx << ").\n";
-            return false;
+Result<void> LibraryStorage::restoreCheckedOut(unique_ptr<Item> item, size_t shelfIdx,
+                                               size_t compIdx, string person, string dueDate) {
+    STORAGE_OP_SCOPE(StorageOp::RestoreCheckedOut);
+    if (optional<StorageError> err = checkLocation(shelfIdx, compIdx)) {
+        return STORAGE_OP_FAIL(*err);
+    }
+    uint64_t key = LoanIndex::makeKey(shelfIdx, compIdx);
+    if (loanIndex.find(key) != LoanIndex::NPOS) {
+        return STORAGE_OP_FAIL(StorageError::AlreadyCheckedOut);
+    }
+    idIndex.emplace(item->getId(), key);
+    if (searchIndex) searchIndex->add(item.get());
+    markSlot(shelfIdx, compIdx, true);
+    uint32_t patron = internPatron(move(person));
+    int32_t dueDay = parseDueDay(dueDate).value_or(NO_DUE_DAY);
+    pushCheckedOut({move(item), shelfIdx, compIdx, patron, 0, move(dueDate), dueDay});
+    return {};
+}
+
+ItemLocation LibraryStorage::loanLocation(uint64_t key) const {
+    const CheckedOutRecord &rec = checkedOut[loanIndex.find(key)];
+    return ItemLocation{rec.item.get(), rec.origShelf, rec.origComp, true,
+                        patrons[rec.patron].name, rec.dueDate};
+}
+
+void LibraryStorage::setLoanLimit(size_t limit) { loanLimit = limit; }
+size_t LibraryStorage::getLoanLimit() const { return loanLimit; }
+
+size_t LibraryStorage::loanCount(string_view person) const {
+    auto it = patronIds.find(person);
+    return it == patronIds.end() ? 0 : patrons[it->second].loans.size();
+}
+
+vector<ItemLocation> LibraryStorage::loansOf(string_view person) const {
+    vector<ItemLocation> result;
+    auto it = patronIds.find(person);
+    if (it == patronIds.end()) return result;
+    const vector<uint64_t> &loans = patrons[it->second].loans;
+    result.reserve(loans.size());
+    for (uint64_t key : loans) result.push_back(loanLocation(key));
+    return result;
+}
+
+string_view LibraryStorage::patronName(uint32_t patron) const { return patrons[patron].name; }
+
+vector<ItemLocation> LibraryStorage::overdueLoans(int32_t day, size_t limit) const {
+    vector<ItemLocation> result;
+    for (auto it = dueIndex.begin(); it != dueIndex.end() && it->first < day; ++it) {
+        if (result.size() >= limit) break;
+        result.push_back(loanLocation(it->second));
+    }
+    return result;
+}
+
+vector<ItemLocation> LibraryStorage::nextDue(size_t n) const {
+    vector<ItemLocation> result;
+    for (auto it = dueIndex.begin(); it != dueIndex.end() && result.size() < n; ++it) {
+        result.push_back(loanLocation(it->second));
+    }
+    return result;
+}
+
+size_t LibraryStorage::pickShelf(Placement policy, ItemType type, size_t nearShelf) const {
+    switch (policy) {
+        case Placement::NearShelf: {
+            if (shelves.empty()) return NO_SHELF;
+            nearShelf = min(nearShelf, shelves.size() - 1);
+            size_t after = nextSetBit(shelvesWithRoom, nearShelf);
+            size_t before = prevSetBit(shelvesWithRoom, nearShelf);
+            if (after == NO_SHELF) return before;
+            if (before == NO_SHELF) return after;
+            return after - nearShelf < nearShelf - before ? after : before;
+        }
+        case Placement::SameType: {
+            size_t s = nextSetBit(typeRoom[static_cast<size_t>(type)], 0);
+            return s != NO_SHELF ? s : nextSetBit(shelvesWithRoom, 0);
         }
+        case Placement::FirstFit:
+            break;
+    }
+    return nextSetBit(shelvesWithRoom, 0);
+}
+
+Result<ShelfSlot> LibraryStorage::addItemAnywhere(unique_ptr<Item> item, Placement policy,
+                                                  size_t nearShelf) {
+    STORAGE_OP_SCOPE(StorageOp::AddItemAnywhere);
+    if (!item) return STORAGE_OP_FAIL(StorageError::InvalidArgument);
+    size_t s = pickShelf(policy, item->type(), nearShelf);
+    if (s == NO_SHELF) return STORAGE_OP_FAIL(StorageError::StorageFull);
+    // Lowest clear bit; the shelf has room, so it is below its capacity.
+    size_t c = static_cast<size_t>(countr_one(occupancy[s]));
+    if (Result<void> added = addItem(move(item), s, c); !added) {
+        return STORAGE_OP_FAIL(added.error());
+    }
+    return ShelfSlot{s, c};
+}
+
+OccupancyStats LibraryStorage::occupancyStats() const {
+    OccupancyStats stats;
+    stats.shelves = shelves.size();
+    for (size_t s = 0; s < shelves.size(); ++s) {
+        size_t cap = shelves[s].capacity();
+        size_t used = static_cast<size_t>(popcount(occupancy[s]));
+        stats.compartments += cap;
+        stats.used += used;
+        if (used == cap) ++stats.fullShelves;
+        if (used == 0) ++stats.emptyShelves;
+    }
+    return stats;
+}
+
+LibraryStorage::ItemRange LibraryStorage::items(optional<ItemType> type) const {
+    return ItemRange(this, type ? static_cast<int>(*type) : -1, 0, shelves.size());
+}
+
+LibraryStorage::ItemRange LibraryStorage::itemsOnShelves(size_t firstShelf, size_t lastShelf,
+                                                         optional<ItemType> type) const {
+    lastShelf = min(lastShelf, shelves.size());
+    return ItemRange(this, type ? static_cast<int>(*type) : -1, min(firstShelf, lastShelf),
+                     lastShelf);
+}
+
+LibraryStorage::LoanRange LibraryStorage::loans(optional<ItemType> type) const {
+    return LoanRange(this, type ? static_cast<int>(*type) : -1);
+}
+
+const vector<LibraryStorage::CheckedOutRecord> &LibraryStorage::checkedOutRecords() const {
+    return checkedOut;
+}
 
-        std::unique_ptr<Item> discarded = c.remove();
-        return true;
-    } catch (const out_of_range &e) {
-        cerr << "Error: " << e.what() << "\n";
-        return false;
+uint32_t LibraryStorage::internPatron(string name) {
+    auto it = patronIds.find(name);
+    if (it != patronIds.end()) return it->second;
+    uint32_t id = static_cast<uint32_t>(patrons.size());
+    patrons.push_back({move(name), {}});
+    patronIds.emplace(patrons.back().name, id);
+    return id;
+}
+
+void LibraryStorage::pushCheckedOut(CheckedOutRecord rec) {
+    uint64_t key = LoanIndex::makeKey(rec.origShelf, rec.origComp);
+    if (rec.dueDay != NO_DUE_DAY) dueIndex.emplace(rec.dueDay, key);
+    vector<uint64_t> &loans = patrons[rec.patron].loans;
+    rec.patronSlot = static_cast<uint32_t>(loans.size());
+    loans.push_back(key);
+    checkedOut.push_back(move(rec));
+    loanIndex.insert(key, checkedOut.size() - 1);
+}
+
+void LibraryStorage::eraseCheckedOut(size_t idx) {
+    CheckedOutRecord &rec = checkedOut[idx];
+    uint64_t key = LoanIndex::makeKey(rec.origShelf, rec.origComp);
+    if (rec.dueDay != NO_DUE_DAY) dueIndex.erase({rec.dueDay, key});
+
+    // Swap-and-pop in the patron's list, then repoint the moved loan.
+    vector<uint64_t> &loans = patrons[rec.patron].loans;
+    uint64_t movedKey = loans.back();
+    loans[rec.patronSlot] = movedKey;
+    loans.pop_back();
+    if (movedKey != key) checkedOut[loanIndex.find(movedKey)].patronSlot = rec.patronSlot;
+
+    loanIndex.erase(key);
+    if (idx + 1 != checkedOut.size()) {
+        rec = move(checkedOut.back());
+        loanIndex.insert(LoanIndex::makeKey(rec.origShelf, rec.origComp), idx);
     }
+    checkedOut.pop_back();
+}
+
+Result<void> LibraryStorage::removeItem(size_t shelfIdx, size_t compIdx) {
+    STORAGE_OP_SCOPE(StorageOp::RemoveItem);
+    if (optional<StorageError> err = checkLocation(shelfIdx, compIdx)) {
+        return STORAGE_OP_FAIL(*err);
+    }
+    if (shelves[shelfIdx].unchecked(compIdx).isEmpty()) {
+        return STORAGE_OP_FAIL(StorageError::Empty);
+    }
+
+    uint64_t key = LoanIndex::makeKey(shelfIdx, compIdx);
+    bool loaned = loanIndex.find(key) != LoanIndex::NPOS;
+    if (!loaned && pickupPatron(key) != HoldQueues::NIL) holdQueues.drop(key);
+    std::unique_ptr<Item> discarded = takeFrom(shelfIdx, compIdx, loaned);
+    unindexId(discarded->getId(), key);
+    if (searchIndex) searchIndex->remove(discarded.get());
+    if (journal) journal->logRemoveItem(shelfIdx, compIdx);
+    return {};
 }
 
 void LibraryStorage::printItemsInStorage() const {
-    cout << "Items currently in storage:\n";
-    bool any = false;
+    ReportWriter out(cout, ReportFormat::Text);
+    writeItemsInStorage(out);
+}
 
-    for (size_t s = 0; s < shelves.size(); ++s) {
-        for (size_t c = 0; c < shelves[s].capacity(); ++c) {
-            const Compartment &comp = shelves[s][c];
-            if (!comp.isEmpty()) {
-                any = true;
-                cout << "  Shelf " << s << ", Compartment " << c << ": "
-                     << *comp.get() << "\n";
-            }
+void LibraryStorage::printCheckedOutItems() const {
+    ReportWriter out(cout, ReportFormat::Text);
+    writeCheckedOutItems(out);
+}
+
+void LibraryStorage::writeItemsInStorage(ReportWriter &out) const {
+    out.begin(ReportKind::Storage);
+    for (const ItemLocation &loc : items()) out.row(loc);
+    out.end();
+}
+
+void LibraryStorage::writeCheckedOutItems(ReportWriter &out) const {
+    out.begin(ReportKind::CheckedOut);
+    for (const ItemLocation &loc : loans()) out.row(loc);
+    out.end();
+}
+
+Result<void> LibraryStorage::swapItems(size_t s1, size_t c1, size_t s2, size_t c2) {
+    STORAGE_OP_SCOPE(StorageOp::SwapItems);
+    optional<StorageError> err = checkLocation(s1, c1);
+    if (!err) err = checkLocation(s2, c2);
+    if (err) return STORAGE_OP_FAIL(*err);
+    Compartment &a = shelves[s1].unchecked(c1);
+    Compartment &b = shelves[s2].unchecked(c2);
+    if (a.isEmpty() || b.isEmpty()) return STORAGE_OP_FAIL(StorageError::Empty);
+    if (&a == &b) return {};
+    uint64_t ka = LoanIndex::makeKey(s1, c1);
+    uint64_t kb = LoanIndex::makeKey(s2, c2);
+    if (pickupPatron(ka) != HoldQueues::NIL || pickupPatron(kb) != HoldQueues::NIL) {
+        return STORAGE_OP_FAIL(StorageError::HeldForOther);
+    }
+    unindexId(a.get()->getId(), ka);
+    unindexId(b.get()->getId(), kb);
+    unique_ptr<Item> first = takeFrom(s1, c1, true);
+    unique_ptr<Item> second = takeFrom(s2, c2, true);
+    placeAt(s1, c1, move(second));
+    placeAt(s2, c2, move(first));
+    idIndex.emplace(a.get()->getId(), ka);
+    idIndex.emplace(b.get()->getId(), kb);
+    if (journal) journal->logSwap(s1, c1, s2, c2);
+    return {};
+}
+
+Result<void> LibraryStorage::moveItem(size_t s1, size_t c1, size_t s2, size_t c2) {
+    STORAGE_OP_SCOPE(StorageOp::MoveItem);
+    optional<StorageError> err = checkLocation(s1, c1);
+    if (!err) err = checkLocation(s2, c2);
+    if (err) return STORAGE_OP_FAIL(*err);
+    Compartment &from = shelves[s1].unchecked(c1);
+    Compartment &to = shelves[s2].unchecked(c2);
+    if (from.isEmpty()) return STORAGE_OP_FAIL(StorageError::Empty);
+    uint64_t kFrom = LoanIndex::makeKey(s1, c1);
+    uint64_t kTo = LoanIndex::makeKey(s2, c2);
+    if (!to.isEmpty() || loanIndex.find(kTo) != LoanIndex::NPOS) {
+        return STORAGE_OP_FAIL(StorageError::Occupied);
+    }
+    if (pickupPatron(kFrom) != HoldQueues::NIL) return STORAGE_OP_FAIL(StorageError::HeldForOther);
+    int id = from.get()->getId();
+    unindexId(id, kFrom);
+    placeAt(s2, c2, takeFrom(s1, c1, loanIndex.find(kFrom) != LoanIndex::NPOS));
+    idIndex.emplace(id, kTo);
+    if (journal) journal->logMove(s1, c1, s2, c2);
+    return {};
+}
+
+Result<void, IngestError> LibraryStorage::commit(Transaction &tx) {
+    STORAGE_OP_SCOPE(StorageOp::Commit);
+    using SlotState = Transaction::SlotState;
+    auto initial = [this](size_t s, size_t c) -> optional<SlotState> {
+        if (s >= shelves.size() || c >= shelves[s].capacity()) return nullopt;
+        SlotState st;
+        st.item = !shelves[s].unchecked(c).isEmpty();
+        uint64_t key = LoanIndex::makeKey(s, c);
+        st.held = pickupPatron(key) != HoldQueues::NIL || holdQueues.size(key) > 0;
+        size_t idx = loanIndex.find(key);
+        if (idx != LoanIndex::NPOS) {
+            st.loan = true;
+            st.person = patrons[checkedOut[idx].patron].name;
         }
+        return st;
+    };
+    function<bool(string_view, ptrdiff_t)> mayBorrow;
+    if (loanLimit != SIZE_MAX) {
+        mayBorrow = [this](string_view person, ptrdiff_t more) {
+            return static_cast<ptrdiff_t>(loanCount(person)) + more
+                   <= static_cast<ptrdiff_t>(min(loanLimit, size_t{PTRDIFF_MAX}));
+        };
+    }
+    if (optional<IngestError> err = tx.check(initial, mayBorrow)) {
+        (void)STORAGE_OP_FAIL(StorageError::TransactionStep);
+        return move(*err);
     }
 
-    if (!any) {
-        cout << "  (none)\n";
+    // Every step is known to succeed, so log the whole transaction as one
+    // record and apply the steps without logging them again. Their results
+    // can only be success.
+    if (journal) journal->logTransaction(tx);
+    Journal *saved = journal;
+    journal = nullptr;
+    for (Transaction::Step &step : tx.ops) {
+        switch (step.kind) {
+            case Transaction::Kind::Add:
+                (void)addItem(move(step.item), step.shelf, step.comp);
+                break;
+            case Transaction::Kind::Remove:
+                (void)removeItem(step.shelf, step.comp);
+                break;
+            case Transaction::Kind::Move:
+                (void)moveItem(step.shelf, step.comp, step.toShelf, step.toComp);
+                break;
+            case Transaction::Kind::Checkout:
+                (void)checkoutItem(step.shelf, step.comp, move(step.person),
+                                   move(step.dueDate));
+                break;
+            case Transaction::Kind::Checkin:
+                (void)checkinItem(step.shelf, step.comp);
+                break;
+        }
     }
+    journal = saved;
+    tx.clear();
+    return {};
 }
 
-void LibraryStorage::printCheckedOutItems() const {
-    cout << "Items currently checked out:\n";
+// ------------------ Transaction ------------------
+using Transaction = LibraryStorage::Transaction;
+
+Transaction &Transaction::addItem(unique_ptr<Item> item, size_t shelfIdx, size_t compIdx) {
+    ops.push_back({Kind::Add, shelfIdx, compIdx, 0, 0, move(item), {}, {}});
+    return *this;
+}
+
+Transaction &Transaction::removeItem(size_t shelfIdx, size_t compIdx) {
+    ops.push_back({Kind::Remove, shelfIdx, compIdx, 0, 0, nullptr, {}, {}});
+    return *this;
+}
+
+Transaction &Transaction::moveItem(size_t s1, size_t c1, size_t s2, size_t c2) {
+    ops.push_back({Kind::Move, s1, c1, s2, c2, nullptr, {}, {}});
+    return *this;
+}
 
-    if (checkedOut.empty()) {
-        cout << "  (none)\n";
-        return;
+Transaction &Transaction::checkoutItem(size_t shelfIdx, size_t compIdx, string person,
+                                       string dueDate) {
+    ops.push_back({Kind::Checkout, shelfIdx, compIdx, 0, 0, nullptr, move(person),
+                   move(dueDate)});
+    return *this;
+}
+
+Transaction &Transaction::checkinItem(size_t shelfIdx, size_t compIdx) {
+    ops.push_back({Kind::Checkin, shelfIdx, compIdx, 0, 0, nullptr, {}, {}});
+    return *this;
+}
+
+size_t Transaction::size() const { return ops.size(); }
+bool Transaction::empty() const { return ops.empty(); }
+void Transaction::clear() { ops.clear(); }
+const vector<Transaction::Step> &Transaction::steps() const { return ops; }
+
+optional<IngestError> Transaction::check(
+    const function<optional<SlotState>(size_t, size_t)> &initial,
+    const function<bool(string_view, ptrdiff_t)> &mayBorrow) const {
+    unordered_map<uint64_t, SlotState> touched;
+    unordered_map<string_view, ptrdiff_t> borrowed;  // loans gained per patron
+    touched.reserve(ops.size());
+    auto slot = [&](size_t s, size_t c) -> SlotState * {
+        // Too large to pack is too large for any storage.
+        if (s > LoanIndex::MAX_INDEX || c > LoanIndex::MAX_INDEX) return nullptr;
+        uint64_t key = LoanIndex::makeKey(s, c);
+        auto it = touched.find(key);
+        if (it != touched.end()) return &it->second;
+        optional<SlotState> st = initial(s, c);
+        return st ? &touched.emplace(key, *st).first->second : nullptr;
+    };
+    auto where = [](size_t s, size_t c) {
+        return "(" + to_string(s) + ", " + to_string(c) + ")";
+    };
+
+    for (size_t i = 0; i < ops.size(); ++i) {
+        const Step &step = ops[i];
+        SlotState *at = slot(step.shelf, step.comp);
+        if (!at) return IngestError{i, "Location " + where(step.shelf, step.comp)
+                                           + " does not exist"};
+        if (at->held && step.kind != Kind::Checkin) {
+            return IngestError{i, "Location " + where(step.shelf, step.comp)
+                                      + " has holds; use the single-item operations"};
+        }
+        switch (step.kind) {
+            case Kind::Add:
+                if (!step.item) return IngestError{i, "No item given"};
+                if (at->item || at->loan) {
+                    return IngestError{i, "Compartment " + where(step.shelf, step.comp)
+                                              + " is not free"};
+                }
+                at->item = true;
+                break;
+            case Kind::Remove:
+                if (!at->item) {
+                    return IngestError{i, "Cannot remove from empty compartment "
+                                              + where(step.shelf, step.comp)};
+                }
+                at->item = false;
+                break;
+            case Kind::Move: {
+                SlotState *to = slot(step.toShelf, step.toComp);
+                if (!to) {
+                    return IngestError{i, "Location " + where(step.toShelf, step.toComp)
+                                              + " does not exist"};
+                }
+                if (!at->item) {
+                    return IngestError{i, "Cannot move from empty compartment "
+                                              + where(step.shelf, step.comp)};
+                }
+                if (to->item || to->loan) {
+                    return IngestError{i, "Compartment " + where(step.toShelf, step.toComp)
+                                              + " is not free"};
+                }
+                at->item = false;
+                to->item = true;
+                break;
+            }
+            case Kind::Checkout:
+                if (!at->item) {
+                    return IngestError{i, "Cannot checkout from empty compartment "
+                                              + where(step.shelf, step.comp)};
+                }
+                if (at->loan) {
+                    return IngestError{i, "An item from " + where(step.shelf, step.comp)
+                                              + " is already checked out"};
+                }
+                if (mayBorrow) {
+                    ptrdiff_t &more = borrowed[step.person];
+                    if (!mayBorrow(step.person, more + 1)) {
+                        return IngestError{i, step.person + " would exceed the loan limit"};
+                    }
+                    ++more;
+                }
+                *at = {false, true, step.person};
+                break;
+            case Kind::Checkin:
+                if (!at->loan) {
+                    return IngestError{i, "No checked-out item recorded for location "
+                                              + where(step.shelf, step.comp)};
+                }
+                if (at->item) {
+                    return IngestError{i, "Cannot check in; compartment "
+                                              + where(step.shelf, step.comp)
+                                              + " is already occupied"};
+                }
+                if (mayBorrow) --borrowed[at->person];
+                at->item = true;
+                at->loan = false;
+                at->person = {};
+                break;
+        }
     }
+    return nullopt;
+}
 
-    for (const auto &rec : checkedOut) {
-        cout << "  From shelf " << rec.origShelf
-             << ", compartment " << rec.origComp << ": "
-             << *rec.item << "\n"
-             << "    Checked out by: " << rec.person
-             << " (due: " << rec.dueDate << ")\n";
+void LibraryStorage::unindexId(int id, uint64_t key) {
+    auto range = idIndex.equal_range(id);
+    for (auto it = range.first; it != range.second; ++it) {
+        if (it->second == key) {
+            idIndex.erase(it);
+            return;
+        }
     }
 }
 
-bool LibraryStorage::swapItems(size_t s1, size_t c1, size_t s2, size_t c2) {
-    if (s1 >= shelves.size() || s2 >= shelves.size()) {
-        cerr << "Error: One of the shelves does not exist.\n";
-        return false;
+optional<ItemLocation> LibraryStorage::findById(int id) const {
+    auto range = idIndex.equal_range(id);
+    for (auto it = range.first; it != range.second; ++it) {
+        size_t s = LoanIndex::keyShelf(it->second);
+        size_t c = LoanIndex::keyComp(it->second);
+
+        // The location may hold this item, or it may be out on loan while a
+        // different item occupies the compartment.
+        const Item *onShelf = shelves[s].unchecked(c).get();
+        if (onShelf && onShelf->getId() == id) {
+            return ItemLocation{onShelf, s, c, false, {}, {}};
+        }
+        size_t idx = loanIndex.find(it->second);
+        if (idx != LoanIndex::NPOS && checkedOut[idx].item->getId() == id) {
+            const CheckedOutRecord &rec = checkedOut[idx];
+            return ItemLocation{rec.item.get(), s, c, true, patrons[rec.patron].name,
+                                rec.dueDate};
+        }
     }
-    try {
-        Compartment &a = shelves[s1][c1];
-        Compartment &b = shelves[s2][c2];
-        if (a.isEmpty() || b.isEmpty()) {
-            cerr << "Error: Both compartments must contain an item to swap.\n";
-            return false;
+    return nullopt;
+}
+
+optional<ItemLocation> LibraryStorage::locate(const Item *item) const {
+    auto range = idIndex.equal_range(item->getId());
+    for (auto it = range.first; it != range.second; ++it) {
+        size_t s = LoanIndex::keyShelf(it->second);
+        size_t c = LoanIndex::keyComp(it->second);
+        if (shelves[s].unchecked(c).get() == item) return ItemLocation{item, s, c, false, {}, {}};
+        size_t idx = loanIndex.find(it->second);
+        if (idx != LoanIndex::NPOS && checkedOut[idx].item.get() == item) {
+            const CheckedOutRecord &rec = checkedOut[idx];
+            return ItemLocation{item, s, c, true, patrons[rec.patron].name, rec.dueDate};
         }
-        unique_ptr<Item> tmp = a.remove();
-        a.place(b.remove());
-        b.place(move(tmp));
-        return true;
-    } catch (const out_of_range &e) {
-        cerr << "Error: " << e.what() << "\n";
-        return false;
     }
+    return nullopt;
+}
+
+vector<SearchResult> LibraryStorage::search(string_view query, size_t k) const {
+    vector<SearchResult> results;
+    if (!searchIndex) return results;
+    for (const SearchHit &hit : searchIndex->search(query, k)) {
+        if (optional<ItemLocation> loc = locate(hit.item)) results.push_back({*loc, hit.score});
+    }
+    return results;
 }
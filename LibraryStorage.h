@@ -1,30 +1,88 @@
 #pragma once
+#include "HoldQueue.h"
 #include "Item.h"
+#include "ItemArena.h"
+#include "LoanIndex.h"
+#include "SearchIndex.h"
+#include "StorageError.h"
+#include <deque>
 #include <array>
+#include <bit>
+#include <cstdint>
 #include <vector>
 #include <memory>
 #include <string>
+#include <string_view>
+#include <optional>
+#include <ranges>
+#include <functional>
+#include <set>
+#include <span>
+#include <unordered_map>
 #include <iostream>
 
 /*
  * File: LibraryStorage.h
  * ----------------------
  * Declarations for the library storage. The storage is composed of
- * Shelves; each Shelf contains up to 15 Compartments. Each Compartment owns
- * a pointer to an Item.
+ * Shelves; each Shelf has a fixed number of Compartments chosen when it is
+ * created (15 by default, at most 64). Each Compartment owns a pointer to
+ * an Item. Shelves can be added at any time; adding one never moves the
+ * existing shelves, so references to them stay valid.
+ *
+ * Patrons can place holds on a checked-out item (placeHold). The holds
+ * on an item form a FIFO queue; when the item is checked in it is set
+ * aside for the first holder, and only that patron can check it out until
+ * they do or cancel.
+ *
+ * Operations that can be refused return a Result (see StorageError.h)
+ * saying why; they print nothing and throw nothing, so a failure costs
+ * about as much as the check that detects it. Reporting is up to the
+ * caller.
  *
  * Data Table (identifier | datatype | use)
  * ----------------------------------------------------------------------
  * ptr              | std::unique_ptr<Item>         | Compartment's owned Item pointer
  * Compartment      | class                         | Holds item pointer
- * CAP              | constexpr size_t              | Max compartments per shelf (15)
- * comps            | std::array<Compartment, CAP>  | Storage for compartments on a shelf
+ * DEFAULT_CAPACITY | constexpr size_t              | Compartments in a default shelf (15)
+ * MAX_CAPACITY     | constexpr size_t              | Largest allowed shelf (64)
+ * comps            | std::unique_ptr<Compartment[]>| Storage for compartments on a shelf
+ * cap              | size_t                        | Number of compartments on a shelf
  * Shelf            | class                         | Contains an array of compartments
- * shelves          | std::vector<Shelf>            | Shelves in LibraryStorage
+ * shelves          | std::deque<Shelf>             | Shelves in LibraryStorage (never relocated)
  * CheckedOutRecord | struct                        | Internal record of checked-out items
  * checkedOut       | std::vector<CheckedOutRecord> | List of checked-out items
- * person           | std::string                   | Name of person who checked out an item
+ * patron           | uint32_t                      | Borrower, index into patrons
+ * patronSlot       | uint32_t                      | Position of the loan in its patron's list
+ * Patron           | struct                        | Registered borrower + keys of open loans
+ * patrons          | std::deque<Patron>            | Patron registry, indexed by patron id
+ * patronIds        | std::unordered_map            | Name -> patron id
+ * loanLimit        | size_t                        | Max open loans per patron
  * dueDate          | std::string                   | Due date string for a checkout
+ * dueDay           | int32_t                       | dueDate as a day number, or NO_DUE_DAY
+ * dueIndex         | std::set<pair<int32, uint64>> | (dueDay, location) of dated loans, ordered
+ * loanIndex        | LoanIndex                     | (shelf, comp) -> position in checkedOut
+ * holdQueues       | HoldQueues                    | (shelf, comp) -> pickup + patrons waiting
+ * HoldInfo         | struct                        | One hold or pickup, returned by holds()
+ * idIndex          | std::unordered_multimap       | Item id -> packed (shelf, comp) location
+ * ItemLocation     | struct                        | Result of findById
+ * PlacedItem       | struct                        | One item + target location for addItems
+ * IngestError      | struct                        | Per-row failure reported by addItems
+ * journal          | Journal*                      | Optional write-ahead log of mutations
+ * arena            | std::unique_ptr<ItemArena>    | Optional pool for this storage's items
+ * searchIndex      | std::unique_ptr<SearchIndex>  | Optional word index over all items
+ * SearchResult     | struct                        | One ranked search hit with its location
+ * occupancy        | std::vector<uint64_t>         | Per shelf, bit c set = compartment c in use
+ * shelvesWithRoom  | std::vector<uint64_t>         | Bit s set = shelf s has a free compartment
+ * typeRoom         | std::array<vector<u64>, 4>    | Per ItemType, shelves holding it with room
+ * typeCounts       | std::vector<array<u32, 4>>    | Per shelf, items of each ItemType on it
+ * Placement        | enum class                    | Policy for addItemAnywhere
+ * ShelfSlot        | struct                        | A (shelf, compartment) pair
+ * OccupancyStats   | struct                        | Summary returned by occupancyStats
+ * Transaction      | class                         | Steps applied all-or-nothing by commit
+ * ItemRange        | class                         | View of stored items (items())
+ * LoanRange        | class                         | View of checked-out items (loans())
+ * ops              | std::vector<Step>             | Steps of a Transaction, in order
  *
  */
 
@@ -32,9 +90,9 @@ class Compartment {
     std::unique_ptr<Item> ptr;
 public:
     Compartment();
-    bool isEmpty() const;
-    const Item* get() const;
-    Item* get();
+    bool isEmpty() const noexcept;
+    const Item* get() const noexcept;
+    Item* get() noexcept;
 
     // Place an item into the compartment. Existing item should be null.
     void place(std::unique_ptr<Item> item);
@@ -44,40 +102,528 @@ public:
 };
 
 class Shelf {
-    static constexpr size_t CAP = 15;
-    std::array<Compartment, CAP> comps;
+    std::unique_ptr<Compartment[]> comps;
+    size_t cap;
 public:
-    Shelf();
+    static constexpr size_t DEFAULT_CAPACITY = 15;
+    static constexpr size_t MAX_CAPACITY = 64;
+
+    // Throws std::invalid_argument unless 1 <= capacity <= MAX_CAPACITY.
+    explicit Shelf(size_t capacity = DEFAULT_CAPACITY);
     size_t capacity() const;
+    // Throw std::out_of_range unless idx < capacity().
     Compartment& operator[](size_t idx);
     const Compartment& operator[](size_t idx) const;
+    // No check: idx must already be known to be < capacity().
+    Compartment& unchecked(size_t idx) noexcept { return comps[idx]; }
+    const Compartment& unchecked(size_t idx) const noexcept { return comps[idx]; }
+};
+
+// Where an item currently is. For a checked-out item, shelf/comp are the
+// location it will be checked back into. Views are valid until the next
+// mutation of the storage.
+struct ItemLocation {
+    const Item* item;
+    size_t shelf;
+    size_t comp;
+    bool checkedOut;
+    std::string_view person;   // empty unless checkedOut
+    std::string_view dueDate;  // empty unless checkedOut
+};
+
+// A patron waiting for the item that belongs at (shelf, comp). position 0
+// means the item is back and set aside for them; 1, 2, ... is their place
+// in the queue. person is valid until the next mutation of the storage.
+struct HoldInfo {
+    size_t shelf;
+    size_t comp;
+    std::string_view person;
+    size_t position;
+};
+
+// An item paired with the location it should be stored at (bulk ingest).
+// A shelf of ANYWHERE lets addItems pick the first free compartment; the
+// chosen location is written back.
+struct PlacedItem {
+    static constexpr size_t ANYWHERE = SIZE_MAX;
+
+    std::unique_ptr<Item> item;
+    size_t shelf;
+    size_t comp;
+};
+
+// Why one row of a bulk ingest was rejected. row is the position within
+// the batch passed to addItems (or a source line number, for loaders).
+struct IngestError {
+    size_t row;
+    std::string message;
 };
 
+// A search hit and where the item currently is.
+struct SearchResult {
+    ItemLocation location;
+    double score;
+};
+
+// How addItemAnywhere chooses a compartment.
+enum class Placement {
+    FirstFit,   // lowest shelf with room
+    NearShelf,  // shelf with room closest to the requested one
+    SameType,   // lowest shelf with room that already holds this ItemType
+};
+
+struct ShelfSlot {
+    size_t shelf;
+    size_t comp;
+};
+
+// Compartments count as used when they hold an item or when the item
+// they hold is checked out (the compartment is kept for its return).
+struct OccupancyStats {
+    size_t shelves = 0;
+    size_t compartments = 0;
+    size_t used = 0;
+    size_t fullShelves = 0;
+    size_t emptyShelves = 0;
+
+    double fillRatio() const;
+};
+
+class Journal;
+class ReportWriter;
+
 class LibraryStorage {
-    std::vector<Shelf> shelves;
+public:
+    class Transaction;
+    class ItemIterator;
+    class LoanIterator;
+    class ItemRange;
+    class LoanRange;
 
     struct CheckedOutRecord {
         std::unique_ptr<Item> item;
         size_t origShelf;
         size_t origComp;
-        std::string person;
+        uint32_t patron;      // see patronName()
+        uint32_t patronSlot;  // maintained by the storage
         std::string dueDate;
+        int32_t dueDay;       // NO_DUE_DAY if dueDate is not YYYY-MM-DD
+    };
+
+private:
+    struct Patron {
+        std::string name;
+        std::vector<uint64_t> loans;  // loan keys, unordered
     };
 
+    std::deque<Shelf> shelves;
     std::vector<CheckedOutRecord> checkedOut;
+    LoanIndex loanIndex;
+    std::set<std::pair<int32_t, uint64_t>> dueIndex;
+    // A deque so names never move: patronIds and ItemLocation view them.
+    std::deque<Patron> patrons;
+    std::unordered_map<std::string_view, uint32_t> patronIds;
+    size_t loanLimit = SIZE_MAX;
+    HoldQueues holdQueues;
+
+    static constexpr size_t NUM_TYPES = 4;  // values of ItemType
+    std::vector<uint64_t> occupancy;
+    std::vector<uint64_t> shelvesWithRoom;
+    std::array<std::vector<uint64_t>, NUM_TYPES> typeRoom;
+    std::vector<std::array<uint32_t, NUM_TYPES>> typeCounts;
+    std::unordered_multimap<int, uint64_t> idIndex;
+    Journal *journal = nullptr;
+    std::unique_ptr<SearchIndex> searchIndex;
+    // Kept last: a move assignment replaces the items above before it
+    // releases the arena they were allocated from.
+    std::unique_ptr<ItemArena> arena;
+
+    void unindexId(int id, uint64_t key);
+
+    // NoSuchShelf or NoSuchCompartment unless (shelfIdx, compIdx) exists.
+    std::optional<StorageError> checkLocation(size_t shelfIdx, size_t compIdx) const noexcept;
+
+    // Location of this exact item (ids need not be unique).
+    std::optional<ItemLocation> locate(const Item *item) const;
+
+    // Every change to what a compartment holds goes through these so the
+    // occupancy bitmaps stay current.
+    void trackNewShelves();
+    void updateRoom(size_t shelfIdx);
+    void markSlot(size_t shelfIdx, size_t compIdx, bool used);
+    void placeAt(size_t shelfIdx, size_t compIdx, std::unique_ptr<Item> item);
+    // keepUsed: the compartment stays reserved (item leaves on loan).
+    std::unique_ptr<Item> takeFrom(size_t shelfIdx, size_t compIdx, bool keepUsed);
+    // A shelf with a free compartment chosen by policy, or SIZE_MAX.
+    size_t pickShelf(Placement policy, ItemType type, size_t nearShelf) const;
+
+    uint32_t internPatron(std::string name);
+    // Append a loan record and index it (patronSlot is filled in).
+    void pushCheckedOut(CheckedOutRecord rec);
+    // Drop checkedOut[idx] by moving the last record into its place.
+    void eraseCheckedOut(size_t idx);
+    ItemLocation loanLocation(uint64_t key) const;
+    // Patron the item at key is set aside for, or HoldQueues::NIL.
+    uint32_t pickupPatron(uint64_t key) const;
 
 public:
     LibraryStorage(size_t numShelves = 3);
+    ~LibraryStorage();
+    LibraryStorage(LibraryStorage &&) = default;
+    LibraryStorage &operator=(LibraryStorage &&) = default;
     size_t numShelves() const;
     Shelf& operator[](size_t idx);
     const Shelf& operator[](size_t idx) const;
 
-    bool addItem(std::unique_ptr<Item> item, size_t shelfIdx, size_t compIdx);
-    bool checkoutItem(size_t shelfIdx, size_t compIdx, std::string person,
-                      std::string dueDate);
-    bool checkinItem(size_t shelfIdx, size_t compIdx);
-    bool removeItem(size_t shelfIdx, size_t compIdx);
+    // Log every successful mutation to j (not owned); nullptr detaches.
+    void attachJournal(Journal *j);
+
+    // Give this storage its own ItemArena. Items created inside an
+    // ItemArena::Scope for itemArena() are then freed together with the
+    // storage. Returns the arena; nullptr until enabled.
+    ItemArena *enableArena();
+    ItemArena *itemArena() const;
+
+    // Build a word index over every stored and checked-out item and keep
+    // it current from then on. Without it, search() returns nothing.
+    void enableSearch();
+    bool searchEnabled() const;
+
+    // Grow the storage to at least n shelves of the default capacity.
+    // Existing shelves are kept in place. A storage never has more than
+    // LoanIndex::MAX_INDEX + 1 shelves, so n is capped there.
+    void reserveShelves(size_t n);
+
+    // Append one shelf with the given number of compartments and return
+    // its index; InvalidArgument unless 1 <= capacity <= MAX_CAPACITY,
+    // StorageFull once the storage has LoanIndex::MAX_INDEX + 1 shelves.
+    Result<size_t> addShelf(size_t capacity = Shelf::DEFAULT_CAPACITY);
+
+    // Validate every step of tx against the storage as the steps before
+    // it leave it, then apply them all and log them as one journal record.
+    // If any step would fail, nothing changes, the first failing step is
+    // returned and tx keeps its items. On success tx is cleared.
+    Result<void, IngestError> commit(Transaction &tx);
+
+    // Occupied if the compartment holds an item or is kept for a loaned one.
+    Result<void> addItem(std::unique_ptr<Item> item, size_t shelfIdx, size_t compIdx);
+
+    // Store item in a free compartment chosen by policy (nearShelf is used
+    // by Placement::NearShelf). A compartment whose item is checked out is
+    // not free. Returns where the item went; StorageFull if there is none.
+    Result<ShelfSlot> addItemAnywhere(std::unique_ptr<Item> item,
+                                      Placement policy = Placement::FirstFit,
+                                      size_t nearShelf = 0);
+    OccupancyStats occupancyStats() const;
+
+    // Validate the whole batch first, then store every valid row. Rows that
+    // fail validation keep their item and are reported.
+    std::vector<IngestError> addItems(std::span<PlacedItem> batch);
+    // An item set aside for a holder can only be checked out by them
+    // (HeldForOther otherwise).
+    Result<void> checkoutItem(size_t shelfIdx, size_t compIdx, std::string person,
+                              std::string dueDate);
+    // If anyone holds the item, it is set aside for the first of them.
+    Result<void> checkinItem(size_t shelfIdx, size_t compIdx);
+
+    // Re-create a loan read back from persistent state. The location must
+    // exist and must not already have a loan recorded.
+    Result<void> restoreCheckedOut(std::unique_ptr<Item> item, size_t shelfIdx,
+                                   size_t compIdx, std::string person, std::string dueDate);
+    // Refuse checkouts that would give a patron more than limit open
+    // loans. Restored loans are not checked. Default: no limit.
+    void setLoanLimit(size_t limit);
+    size_t getLoanLimit() const;
+
+    // Queue person for the item that belongs at (shelfIdx, compIdx). The
+    // item must be checked out or set aside for another patron; an item
+    // on the shelf and free to borrow is refused with NotCheckedOut.
+    // Returns the patron's place in the queue (1 = next). O(1) apart from
+    // the duplicate check, which is O(k) in the queue length.
+    Result<size_t> placeHold(size_t shelfIdx, size_t compIdx, std::string person);
+    // Withdraw person's hold. If the item was set aside for them it passes
+    // to the next holder, if any.
+    Result<void> cancelHold(size_t shelfIdx, size_t compIdx, std::string_view person);
+    // Re-create a hold read back from persistent state: the pickup of the
+    // item now at the location (position 0), or a place at the back of
+    // its queue. Not journaled.
+    Result<void> restoreHold(size_t shelfIdx, size_t compIdx, std::string person,
+                             bool awaitingPickup);
+    // Patron the item at the location is set aside for, if any.
+    std::optional<std::string_view> pickupFor(size_t shelfIdx, size_t compIdx) const;
+    // Patrons queued for the location, not counting a pending pickup.
+    size_t holdCount(size_t shelfIdx, size_t compIdx) const;
+    // Every pickup and queued hold, grouped by location with the pickup
+    // first and the queue in order; locations in unspecified order.
+    std::vector<HoldInfo> holds() const;
+    // Items on the shelf waiting to be collected, with person set to the
+    // patron each one is for.
+    std::vector<ItemLocation> awaitingPickup() const;
+
+    // Open loans of a patron, in O(1) and O(k).
+    size_t loanCount(std::string_view person) const;
+    std::vector<ItemLocation> loansOf(std::string_view person) const;
+    std::string_view patronName(uint32_t patron) const;
+
+    // Loans due strictly before day (see DueDate.h), earliest first, at
+    // most limit of them. Loans whose due date is not YYYY-MM-DD are never
+    // overdue. Cost is O(log n + k) for k results.
+    std::vector<ItemLocation> overdueLoans(int32_t day, size_t limit = SIZE_MAX) const;
+    // The n dated loans due soonest, earliest first.
+    std::vector<ItemLocation> nextDue(size_t n) const;
+
+    // Checked-out records in unspecified order.
+    const std::vector<CheckedOutRecord> &checkedOutRecords() const;
+
+    // Lazy views of the stored items (shelf, then compartment order) and
+    // of the checked-out items (unspecified order), optionally only those
+    // of one type. Iterating allocates nothing; empty shelves and shelves
+    // without the type are skipped using the occupancy bitmaps. Any change
+    // to the storage invalidates them.
+    ItemRange items(std::optional<ItemType> type = std::nullopt) const;
+    LoanRange loans(std::optional<ItemType> type = std::nullopt) const;
+    // Stored items on shelves [firstShelf, lastShelf) only; lastShelf is
+    // clamped to numShelves(). Used to split a scan between threads.
+    ItemRange itemsOnShelves(size_t firstShelf, size_t lastShelf,
+                             std::optional<ItemType> type = std::nullopt) const;
+    // Removing an item set aside for a holder cancels its holds.
+    Result<void> removeItem(size_t shelfIdx, size_t compIdx);
     void printItemsInStorage() const;
     void printCheckedOutItems() const;
-    bool swapItems(size_t s1, size_t c1, size_t s2, size_t c2);
+    // The same listings as one section each of a report (see ReportWriter.h).
+    void writeItemsInStorage(ReportWriter &out) const;
+    void writeCheckedOutItems(ReportWriter &out) const;
+    // An item set aside for a holder stays put (HeldForOther) in a swap
+    // or a move.
+    Result<void> swapItems(size_t s1, size_t c1, size_t s2, size_t c2);
+    // Move the item at (s1, c1) into the free compartment (s2, c2). A
+    // compartment kept for a checked-out item is not free.
+    Result<void> moveItem(size_t s1, size_t c1, size_t s2, size_t c2);
+
+    // O(1) lookup by Item id across shelves and checked-out records.
+    std::optional<ItemLocation> findById(int id) const;
+
+    // Best k items containing every word of query (see SearchIndex.h).
+    std::vector<SearchResult> search(std::string_view query, size_t k = 10) const;
+};
+
+// A list of storage operations applied all-or-nothing by
+// LibraryStorage::commit or ConcurrentLibraryStorage::commit. Building
+// one does not touch any storage.
+class LibraryStorage::Transaction {
+public:
+    enum class Kind : uint8_t { Add, Remove, Move, Checkout, Checkin };
+
+    struct Step {
+        Kind kind;
+        size_t shelf;
+        size_t comp;
+        size_t toShelf = 0;  // Move only
+        size_t toComp = 0;   // Move only
+        std::unique_ptr<Item> item;  // Add only
+        std::string person;          // Checkout only
+        std::string dueDate;         // Checkout only
+    };
+
+    // What a compartment looks like part way through a transaction.
+    struct SlotState {
+        bool item = false;        // holds an item
+        bool loan = false;        // its item is checked out
+        std::string_view person;  // borrower, if loan
+        bool held = false;        // has holds; only a check-in may touch it
+    };
+
+    Transaction &addItem(std::unique_ptr<Item> item, size_t shelfIdx, size_t compIdx);
+    Transaction &removeItem(size_t shelfIdx, size_t compIdx);
+    Transaction &moveItem(size_t s1, size_t c1, size_t s2, size_t c2);
+    Transaction &checkoutItem(size_t shelfIdx, size_t compIdx, std::string person,
+                              std::string dueDate);
+    Transaction &checkinItem(size_t shelfIdx, size_t compIdx);
+
+    size_t size() const;
+    bool empty() const;
+    void clear();
+    const std::vector<Step> &steps() const;
+
+    // Walk the steps without applying them and return the first one that
+    // would fail. initial(s, c) is a compartment's state before the
+    // transaction, or nullopt if it does not exist. mayBorrow(person, n)
+    // says whether person may take n more loans than they hold now (n can
+    // be negative after check-ins); leave it empty when there is no limit.
+    std::optional<IngestError> check(
+        const std::function<std::optional<SlotState>(size_t, size_t)> &initial,
+        const std::function<bool(std::string_view, ptrdiff_t)> &mayBorrow) const;
+
+private:
+    friend class LibraryStorage;
+    friend class ConcurrentLibraryStorage;
+
+    std::vector<Step> ops;
+};
+
+// Iterators yield ItemLocation by value. They only ever read the storage.
+class LibraryStorage::ItemIterator {
+    const LibraryStorage *lib = nullptr;
+    size_t shelf = 0;
+    size_t lastShelf = 0;        // one past the last shelf to visit
+    uint64_t bits = 0;           // compartments of shelf still to visit
+    int type = -1;               // ItemType to keep, or -1 for all
+    const Item *item = nullptr;  // item at the lowest bit, once settled
+
+    void settle();
+
+public:
+    using value_type = ItemLocation;
+    using difference_type = std::ptrdiff_t;
+    using iterator_concept = std::forward_iterator_tag;
+
+    ItemIterator() = default;
+    ItemIterator(const LibraryStorage *lib, int type, size_t firstShelf, size_t lastShelf);
+
+    ItemLocation operator*() const;
+    ItemIterator &operator++();
+    ItemIterator operator++(int);
+    bool operator==(const ItemIterator &other) const;
+    bool operator==(std::default_sentinel_t) const;
+};
+
+class LibraryStorage::LoanIterator {
+    const LibraryStorage *lib = nullptr;
+    size_t idx = 0;
+    int type = -1;
+
+    void settle();
+
+public:
+    using value_type = ItemLocation;
+    using difference_type = std::ptrdiff_t;
+    using iterator_concept = std::forward_iterator_tag;
+
+    LoanIterator() = default;
+    LoanIterator(const LibraryStorage *lib, int type);
+
+    ItemLocation operator*() const;
+    LoanIterator &operator++();
+    LoanIterator operator++(int);
+    bool operator==(const LoanIterator &other) const;
+    bool operator==(std::default_sentinel_t) const;
+};
+
+class LibraryStorage::ItemRange : public std::ranges::view_interface<ItemRange> {
+    const LibraryStorage *lib = nullptr;
+    int type = -1;
+    size_t firstShelf = 0;
+    size_t lastShelf = 0;
+
+public:
+    ItemRange() = default;
+    ItemRange(const LibraryStorage *lib, int type, size_t firstShelf, size_t lastShelf)
+        : lib(lib), type(type), firstShelf(firstShelf), lastShelf(lastShelf) {}
+    ItemIterator begin() const { return ItemIterator(lib, type, firstShelf, lastShelf); }
+    std::default_sentinel_t end() const { return std::default_sentinel; }
+};
+
+class LibraryStorage::LoanRange : public std::ranges::view_interface<LoanRange> {
+    const LibraryStorage *lib = nullptr;
+    int type = -1;
+
+public:
+    LoanRange() = default;
+    LoanRange(const LibraryStorage *lib, int type) : lib(lib), type(type) {}
+    LoanIterator begin() const { return LoanIterator(lib, type); }
+    std::default_sentinel_t end() const { return std::default_sentinel; }
 };
+
+// Defined here so loops over a range inline down to bit scans.
+
+inline LibraryStorage::ItemIterator::ItemIterator(const LibraryStorage *lib_, int type_,
+                                                  size_t firstShelf, size_t lastShelf_)
+    : lib(lib_), shelf(firstShelf), lastShelf(lastShelf_),
+      bits(firstShelf < lastShelf_ ? lib_->occupancy[firstShelf] : 0), type(type_) {
+    settle();
+}
+
+// Stop at the next compartment holding a wanted item, starting with the
+// lowest bit of bits. A used compartment may be empty (its item is out).
+inline void LibraryStorage::ItemIterator::settle() {
+    while (true) {
+        if (bits) {
+            const Shelf &cur = lib->shelves[shelf];
+            do {
+                item = cur.unchecked(static_cast<size_t>(std::countr_zero(bits))).get();
+                if (item && (type < 0 || static_cast<int>(item->type()) == type)) return;
+                bits &= bits - 1;
+            } while (bits);
+        }
+        if (shelf >= lastShelf || ++shelf >= lastShelf) {
+            shelf = lastShelf;
+            return;
+        }
+        if (type < 0 || lib->typeCounts[shelf][static_cast<size_t>(type)] > 0) {
+            bits = lib->occupancy[shelf];
+        }
+    }
+}
+
+inline ItemLocation LibraryStorage::ItemIterator::operator*() const {
+    return {item, shelf, static_cast<size_t>(std::countr_zero(bits)), false, {}, {}};
+}
+
+inline LibraryStorage::ItemIterator &LibraryStorage::ItemIterator::operator++() {
+    bits &= bits - 1;
+    settle();
+    return *this;
+}
+
+inline LibraryStorage::ItemIterator LibraryStorage::ItemIterator::operator++(int) {
+    ItemIterator old = *this;
+    ++*this;
+    return old;
+}
+
+inline bool LibraryStorage::ItemIterator::operator==(const ItemIterator &other) const {
+    return shelf == other.shelf && bits == other.bits;
+}
+
+inline bool LibraryStorage::ItemIterator::operator==(std::default_sentinel_t) const {
+    return shelf >= lastShelf;
+}
+
+inline LibraryStorage::LoanIterator::LoanIterator(const LibraryStorage *lib_, int type_)
+    : lib(lib_), idx(0), type(type_) {
+    settle();
+}
+
+inline void LibraryStorage::LoanIterator::settle() {
+    if (type < 0) return;
+    while (idx < lib->checkedOut.size()
+           && static_cast<int>(lib->checkedOut[idx].item->type()) != type) {
+        ++idx;
+    }
+}
+
+inline ItemLocation LibraryStorage::LoanIterator::operator*() const {
+    const CheckedOutRecord &rec = lib->checkedOut[idx];
+    return {rec.item.get(), rec.origShelf, rec.origComp, true,
+            lib->patrons[rec.patron].name, rec.dueDate};
+}
+
+inline LibraryStorage::LoanIterator &LibraryStorage::LoanIterator::operator++() {
+    ++idx;
+    settle();
+    return *this;
+}
+
+inline LibraryStorage::LoanIterator LibraryStorage::LoanIterator::operator++(int) {
+    LoanIterator old = *this;
+    ++*this;
+    return old;
+}
+
+inline bool LibraryStorage::LoanIterator::operator==(const LoanIterator &other) const {
+    return idx == other.idx;
+}
+
+inline bool LibraryStorage::LoanIterator::operator==(std::default_sentinel_t) const {
+    return !lib || idx >= lib->checkedOut.size();
+}
@@ -0,0 +1,366 @@
+#include "StorageStats.h"
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <iostream>
+#include <random>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+using namespace std;
+
+/*
+ * File: LoadGenerator.cpp
+ * -----------------------
+ * LibraryCheckout_load: drives a server started with
+ * "LibraryCheckout --serve <address>" and reports throughput and latency.
+ *
+ *   LibraryCheckout_load <host:port | port | unix:path> [--connections <n>]
+ *                        [--depth <n>] [--requests <n>] [--items <n>] [--seed <n>]
+ *
+ * First one connection stocks the server with --items books (default
+ * 10^4) on new shelves. Then --connections clients (default 4), one thread
+ * each, send --requests commands between them (default 10^6), each
+ * keeping up to --depth commands in flight (default 32). The mix is 30%
+ * checkout, 30% checkin, 25% find by id, 10% remove followed by re-adding
+ * the item and 5% swap, at random stocked locations. Lookups whose replies
+ * grow with the run (loans of a patron who keeps borrowing) are left out
+ * so that throughput does not drift.
+ *
+ * Latency is measured per command, from handing it to send() to reading
+ * the first line of its reply, so it includes queueing behind the commands
+ * ahead of it on the same connection. Replies that are errors (a checkin
+ * of an item that is on the shelf, say) are normal here and are counted
+ * as refused, not as failures of the server.
+ *
+ * Data Table (identifier | datatype | use)
+ * ----------------------------------------------------------------------
+ * Options     | struct                     | Command-line settings
+ * Connection  | class                      | Blocking socket with a line reader
+ * Location    | struct                     | Shelf and compartment of one stocked item
+ * WorkerStats | struct                     | Counts and latencies of one client thread
+ * sentAt      | std::deque<time_point>     | Send times of commands awaiting a reply
+ *
+ */
+
+namespace {
+
+struct Options {
+    string address;
+    size_t connections = 4;
+    size_t depth = 32;
+    size_t requests = 1000000;
+    size_t items = 10000;
+    uint64_t seed = 42;
+};
+
+bool parseOptions(int argc, char *argv[], Options &opt) {
+    if (argc < 2 || argv[1][0] == '-') return false;
+    opt.address = argv[1];
+    for (int i = 2; i < argc; ++i) {
+        string arg = argv[i];
+        if (i + 1 >= argc) {
+            cerr << "Missing value for " << arg << "\n";
+            return false;
+        }
+        string value = argv[++i];
+        char *end = nullptr;
+        unsigned long long n = strtoull(value.c_str(), &end, 10);
+        bool numeric = !value.empty() && *end == '\0';
+        if (arg == "--connections" && numeric && n > 0) {
+            opt.connections = n;
+        } else if (arg == "--depth" && numeric && n > 0) {
+            opt.depth = n;
+        } else if (arg == "--requests" && numeric && n > 0) {
+            opt.requests = n;
+        } else if (arg == "--items" && numeric && n > 0) {
+            opt.items = n;
+        } else if (arg == "--seed" && numeric) {
+            opt.seed = n;
+        } else {
+            cerr << "Bad option: " << arg << " " << value << "\n";
+            return false;
+        }
+    }
+    return true;
+}
+
+// Connect to the same address forms LibraryServer::listen accepts.
+int connectTo(const string &address) {
+    if (address.rfind("unix:", 0) == 0) {
+        string path = address.substr(5);
+        sockaddr_un sa{};
+        sa.sun_family = AF_UNIX;
+        if (path.empty() || path.size() >= sizeof(sa.sun_path)) return -1;
+        memcpy(sa.sun_path, path.c_str(), path.size() + 1);
+        int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        if (fd >= 0 && connect(fd, reinterpret_cast<sockaddr *>(&sa), sizeof(sa)) == 0) {
+            return fd;
+        }
+        if (fd >= 0) close(fd);
+        return -1;
+    }
+    size_t colon = address.rfind(':');
+    string host = colon == string::npos ? "127.0.0.1" : address.substr(0, colon);
+    string port = colon == string::npos ? address : address.substr(colon + 1);
+    if (host.size() > 2 && host.front() == '[' && host.back() == ']') {
+        host = host.substr(1, host.size() - 2);
+    }
+    addrinfo hints{};
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    addrinfo *found = nullptr;
+    if (getaddrinfo(host.empty() ? "127.0.0.1" : host.c_str(), port.c_str(), &hints, &found)) {
+        return -1;
+    }
+    int fd = -1;
+    for (addrinfo *ai = found; ai && fd < 0; ai = ai->ai_next) {
+        fd = socket(ai->ai_family, ai->ai_socktype | SOCK_CLOEXEC, ai->ai_protocol);
+        if (fd >= 0 && connect(fd, ai->ai_addr, ai->ai_addrlen) != 0) {
+            close(fd);
+            fd = -1;
+        }
+    }
+    freeaddrinfo(found);
+    if (fd >= 0) {
+        int one = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    }
+    return fd;
+}
+
+// A reply starts with a line that is not indented; indented lines are the
+// results of a lookup and belong to the reply before them.
+class Connection {
+    int fd;
+    string buffer;
+    size_t scanned = 0;
+
+public:
+    explicit Connection(int fd_) : fd(fd_) {}
+    ~Connection() {
+        if (fd >= 0) close(fd);
+    }
+    Connection(const Connection &) = delete;
+    Connection &operator=(const Connection &) = delete;
+
+    bool sendAll(string_view data) {
+        while (!data.empty()) {
+            ssize_t n = send(fd, data.data(), data.size(), MSG_NOSIGNAL);
+            if (n < 0) {
+                if (errno == EINTR) continue;
+                return false;
+            }
+            data.remove_prefix(static_cast<size_t>(n));
+        }
+        return true;
+    }
+
+    // Block until at least one more line arrives, then call onReply with
+    // the first line of every reply that is now complete. false on EOF or
+    // error.
+    template <typename F>
+    bool readReplies(F onReply) {
+        char chunk[64 * 1024];
+        ssize_t n;
+        do {
+            n = recv(fd, chunk, sizeof(chunk), 0);
+        } while (n < 0 && errno == EINTR);
+        if (n <= 0) return false;
+        buffer.append(chunk, static_cast<size_t>(n));
+        size_t start = 0;
+        for (size_t nl; (nl = buffer.find('\n', scanned)) != string::npos; scanned = nl + 1) {
+            string_view line(buffer.data() + scanned, nl - scanned);
+            if (line.rfind("  ", 0) != 0) onReply(line);
+            start = nl + 1;
+        }
+        buffer.erase(0, start);
+        scanned -= start;
+        return true;
+    }
+};
+
+struct Location {
+    size_t shelf;
+    size_t comp;
+};
+
+struct WorkerStats {
+    uint64_t replies = 0;
+    uint64_t refused = 0;
+    uint64_t maxNs = 0;
+    LatencyHistogram latency;
+    bool ok = true;
+};
+
+string addCommand(const string &where, size_t id) {
+    return "add book " + where + " " + to_string(id) + " Load" + to_string(id)
+           + " generated Title" + to_string(id) + " Author" + to_string(id % 100) + " 2000\n";
+}
+
+// Stock the server with n books on shelves of its own; returns where they went.
+bool stock(const string &address, size_t n, vector<Location> &slots) {
+    int fd = connectTo(address);
+    if (fd < 0) {
+        cerr << "Error: Could not connect to " << address << ": " << strerror(errno) << "\n";
+        return false;
+    }
+    Connection conn(fd);
+    size_t shelves = (n + 63) / 64;
+    size_t firstShelf = SIZE_MAX;
+    string script;
+    for (size_t i = 0; i < shelves; ++i) script += "addshelf 64\n";
+    bool ok = conn.sendAll(script);
+    for (size_t got = 0; ok && got < shelves;) {
+        ok = conn.readReplies([&](string_view line) {
+            if (got++ == 0 && line.rfind("ok ", 0) == 0) {
+                firstShelf = strtoull(string(line.substr(3)).c_str(), nullptr, 10);
+            }
+        });
+    }
+    if (!ok || firstShelf == SIZE_MAX) {
+        cerr << "Error: The server did not add shelves.\n";
+        return false;
+    }
+    // Shelves added by one connection in one go are consecutive.
+    for (size_t done = 0; done < n;) {
+        size_t batch = min<size_t>(n - done, 4096);
+        script.clear();
+        for (size_t i = done; i < done + batch; ++i) {
+            slots.push_back({firstShelf + i / 64, i % 64});
+            script += addCommand(to_string(slots.back().shelf) + " "
+                                     + to_string(slots.back().comp), i + 1);
+        }
+        if (!conn.sendAll(script)) return false;
+        for (size_t got = 0; got < batch;) {
+            if (!conn.readReplies([&](string_view) { ++got; })) return false;
+        }
+        done += batch;
+    }
+    return true;
+}
+
+void runWorker(const Options &opt, const vector<Location> &slots, size_t worker,
+               size_t requests, WorkerStats &stats) {
+    int fd = connectTo(opt.address);
+    if (fd < 0) {
+        stats.ok = false;
+        return;
+    }
+    Connection conn(fd);
+    mt19937_64 rng(opt.seed + worker);
+    string reader = "\"Reader " + to_string(worker) + "\"";
+    auto where = [&](const Location &s) { return to_string(s.shelf) + " " + to_string(s.comp); };
+
+    deque<chrono::steady_clock::time_point> sentAt;
+    size_t sent = 0;
+    string script;
+    while (stats.replies < requests) {
+        script.clear();
+        size_t before = sent;
+        while (sent < requests && sent - stats.replies < opt.depth) {
+            const Location &s = slots[rng() % slots.size()];
+            unsigned roll = static_cast<unsigned>(rng() % 100);
+            if (roll < 30) {
+                script += "checkout " + where(s) + " " + reader + " 2027-01-01\n";
+            } else if (roll < 60) {
+                script += "checkin " + where(s) + "\n";
+            } else if (roll < 85) {
+                script += "find " + to_string(rng() % slots.size() + 1) + "\n";
+            } else if (roll < 95) {
+                if (sent + 2 > requests) continue;
+                size_t id = static_cast<size_t>(&s - slots.data()) + 1;
+                script += "remove " + where(s) + "\n" + addCommand(where(s), id);
+                ++sent;
+            } else {
+                script += "swap " + where(s) + " " + where(slots[rng() % slots.size()]) + "\n";
+            }
+            ++sent;
+        }
+        auto now = chrono::steady_clock::now();
+        sentAt.insert(sentAt.end(), sent - before, now);
+        if (!script.empty() && !conn.sendAll(script)) {
+            stats.ok = false;
+            return;
+        }
+        bool alive = conn.readReplies([&](string_view line) {
+            auto ns = chrono::nanoseconds(chrono::steady_clock::now() - sentAt.front()).count();
+            sentAt.pop_front();
+            uint64_t v = static_cast<uint64_t>(ns);
+            stats.latency.record(v);
+            stats.maxNs = max(stats.maxNs, v);
+            ++stats.replies;
+            if (line.rfind("error", 0) == 0) ++stats.refused;
+        });
+        if (!alive) {
+            stats.ok = false;
+            return;
+        }
+    }
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+    Options opt;
+    if (!parseOptions(argc, argv, opt)) {
+        cerr << "Usage: " << argv[0]
+             << " <host:port | port | unix:path> [--connections <n>] [--depth <n>]"
+                " [--requests <n>] [--items <n>] [--seed <n>]\n";
+        return 1;
+    }
+
+    vector<Location> slots;
+    auto start = chrono::steady_clock::now();
+    if (!stock(opt.address, opt.items, slots)) return 1;
+    double stockSeconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    printf("stocked %zu items in %.2f s (%.0f adds/s)\n", slots.size(), stockSeconds,
+           static_cast<double>(slots.size()) / stockSeconds);
+
+    vector<WorkerStats> stats(opt.connections);
+    vector<thread> workers;
+    start = chrono::steady_clock::now();
+    for (size_t w = 0; w < opt.connections; ++w) {
+        size_t share = opt.requests / opt.connections + (w < opt.requests % opt.connections);
+        workers.emplace_back(runWorker, cref(opt), cref(slots), w, share, ref(stats[w]));
+    }
+    for (thread &t : workers) t.join();
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+    WorkerStats total;
+    for (const WorkerStats &s : stats) {
+        total.replies += s.replies;
+        total.refused += s.refused;
+        total.maxNs = max(total.maxNs, s.maxNs);
+        total.latency.merge(s.latency);
+        total.ok = total.ok && s.ok;
+    }
+    if (!total.ok) cerr << "Error: A connection failed; results cover the replies received.\n";
+
+    // A bucket's upper edge can lie above the largest value seen.
+    auto us = [&](double q) {
+        return static_cast<double>(min(total.latency.quantile(q), total.maxNs)) / 1e3;
+    };
+    printf("%zu connections, depth %zu: %llu replies in %.2f s = %.0f requests/s\n",
+           opt.connections, opt.depth, static_cast<unsigned long long>(total.replies), seconds,
+           static_cast<double>(total.replies) / seconds);
+    printf("refused by the storage: %.1f%%\n",
+           total.replies ? 100.0 * static_cast<double>(total.refused)
+                               / static_cast<double>(total.replies)
+                         : 0.0);
+    printf("latency us: p50 %.1f  p90 %.1f  p99 %.1f  p99.9 %.1f  max %.1f\n", us(0.50),
+           us(0.90), us(0.99), us(0.999), static_cast<double>(total.maxNs) / 1e3);
+    return total.ok ? 0 : 1;
+}
@@ -0,0 +1,100 @@
+#include "LoanIndex.h"
+#include <cassert>
+#include <utility>
+
+using namespace std;
+
+/*
+ * File: LoanIndex.cpp
+ * -------------------
+ * Implements the open-addressing location index declared in LoanIndex.h.
+ * The table keeps its load factor at or below 1/2 and doubles when full.
+ */
+
+static constexpr size_t INITIAL_SLOTS = 16;
+
+static uint64_t mix(uint64_t x) {
+    // splitmix64 finalizer; spreads packed (shelf, comp) keys across the table
+    x ^= x >> 30;
+    x *= 0xbf58476d1ce4e5b9ULL;
+    x ^= x >> 27;
+    x *= 0x94d049bb133111ebULL;
+    x ^= x >> 31;
+    return x;
+}
+
+LoanIndex::LoanIndex() : slots(INITIAL_SLOTS, Slot{EMPTY, 0}), count(0) {}
+
+uint64_t LoanIndex::makeKey(size_t shelfIdx, size_t compIdx) {
+    assert(shelfIdx <= MAX_INDEX && compIdx <= MAX_INDEX);
+    return (static_cast<uint64_t>(shelfIdx) << 32) | static_cast<uint32_t>(compIdx);
+}
+
+size_t LoanIndex::keyShelf(uint64_t key) { return static_cast<size_t>(key >> 32); }
+size_t LoanIndex::keyComp(uint64_t key) { return static_cast<size_t>(key & 0xffffffffu); }
+
+size_t LoanIndex::size() const { return count; }
+bool LoanIndex::empty() const { return count == 0; }
+
+size_t LoanIndex::mask() const { return slots.size() - 1; }
+size_t LoanIndex::home(uint64_t key) const { return mix(key) & mask(); }
+
+size_t LoanIndex::find(uint64_t key) const {
+    for (size_t i = home(key);; i = (i + 1) & mask()) {
+        if (slots[i].key == key) return slots[i].value;
+        if (slots[i].key == EMPTY) return NPOS;
+    }
+}
+
+void LoanIndex::insert(uint64_t key, size_t value) {
+    assert(key != EMPTY);
+    if ((count + 1) * 2 > slots.size()) grow();
+    for (size_t i = home(key);; i = (i + 1) & mask()) {
+        if (slots[i].key == key) {
+            slots[i].value = value;
+            return;
+        }
+        if (slots[i].key == EMPTY) {
+            slots[i] = Slot{key, value};
+            ++count;
+            return;
+        }
+    }
+}
+
+bool LoanIndex::erase(uint64_t key) {
+    size_t i = home(key);
+    while (slots[i].key != key) {
+        if (slots[i].key == EMPTY) return false;
+        i = (i + 1) & mask();
+    }
+
+    // Backward-shift: pull later entries of the probe run into the hole so
+    // that every remaining key stays reachable from its home slot.
+    size_t hole = i;
+    for (size_t j = (hole + 1) & mask(); slots[j].key != EMPTY; j = (j + 1) & mask()) {
+        size_t h = home(slots[j].key);
+        bool movable = (hole <= j) ? (h <= hole || h > j) : (h <= hole && h > j);
+        if (movable) {
+            slots[hole] = slots[j];
+            hole = j;
+        }
+    }
+    slots[hole].key = EMPTY;
+    --count;
+    return true;
+}
+
+void LoanIndex::clear() {
+    slots.assign(INITIAL_SLOTS, Slot{EMPTY, 0});
+    count = 0;
+}
+
+void LoanIndex::grow() {
+    vector<Slot> old(slots.size() * 2, Slot{EMPTY, 0});
+    old.swap(slots);
+    count = 0;
+    for (const Slot &s : old) {
+        if (s.key != EMPTY) insert(s.key, s.value);
+    }
+}
@@ -0,0 +1,74 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/*
+ * File: LoanIndex.h
+ * -----------------
+ * Open-addressing hash index from a storage location (shelf, compartment)
+ * to the position of its record in LibraryStorage's checked-out list.
+ * Uses linear probing with backward-shift deletion, so lookups, inserts
+ * and erases are O(1) amortized and no tombstones build up.
+ *
+ * A location key keeps 32 bits of each index, so makeKey only accepts
+ * indices up to MAX_INDEX: larger ones would alias another location, and
+ * (MAX_INDEX + 1, MAX_INDEX + 1) would be the EMPTY marker itself.
+ * LibraryStorage never has more shelves than that and checks a location
+ * before packing it; makeKey asserts it.
+ *
+ * Data Table (identifier | datatype | use)
+ * ----------------------------------------------------------------------
+ * Slot      | struct                | One table entry (key + value)
+ * key       | uint64_t              | Packed (shelf, compartment) location
+ * value     | size_t                | Index into the checked-out list
+ * slots     | std::vector<Slot>     | Table storage, size is a power of two
+ * count     | size_t                | Number of keys stored
+ * MAX_INDEX | constexpr size_t      | Largest shelf or compartment makeKey packs
+ * EMPTY     | constexpr uint64_t    | Key value marking an unused slot
+ * NPOS      | constexpr size_t      | Returned by find() when key is absent
+ *
+ */
+
+class LoanIndex {
+public:
+    static constexpr size_t NPOS = static_cast<size_t>(-1);
+    static constexpr size_t MAX_INDEX = 0xfffffffe;
+
+    LoanIndex();
+
+    // Pack a location into a single key; both indices at most MAX_INDEX.
+    static uint64_t makeKey(size_t shelfIdx, size_t compIdx);
+    static size_t keyShelf(uint64_t key);
+    static size_t keyComp(uint64_t key);
+
+    size_t size() const;
+    bool empty() const;
+
+    // Returns the stored value for key, or NPOS if absent.
+    size_t find(uint64_t key) const;
+
+    // Insert or overwrite the value for key, which is never EMPTY.
+    void insert(uint64_t key, size_t value);
+
+    // Remove key; returns false if it was not present.
+    bool erase(uint64_t key);
+
+    void clear();
+
+    static constexpr uint64_t EMPTY = ~uint64_t{0};
+
+private:
+
+    struct Slot {
+        uint64_t key;
+        size_t value;
+    };
+
+    std::vector<Slot> slots;
+    size_t count;
+
+    size_t mask() const;
+    size_t home(uint64_t key) const;
+    void grow();
+};
@@ -0,0 +1,369 @@
+#include "ReportWriter.h"
+#include <charconv>
+
+using namespace std;
+
+/*
+ * File: ReportWriter.cpp
+ * ----------------------
+ * Implements the buffered report writer declared in ReportWriter.h. The
+ * Text rows reproduce Item::print byte for byte.
+ */
+
+namespace {
+
+string_view typeName(ItemType type) {
+    switch (type) {
+        case ItemType::Book:
+            return "book";
+        case ItemType::Movie:
+            return "movie";
+        case ItemType::Magazine:
+            return "magazine";
+        case ItemType::Item:
+            break;
+    }
+    return "item";
+}
+
+string_view sectionName(ReportKind kind) {
+    return kind == ReportKind::Storage ? "storage" : "checkedOut";
+}
+
+} // namespace
+
+ReportWriter::ReportWriter(ostream &os_, ReportFormat format_, size_t bufferSize)
+    : os(os_), format(format_), flushAt(bufferSize ? bufferSize : 1) {
+    buf.reserve(flushAt + 4096);
+}
+
+ReportWriter::~ReportWriter() { finish(); }
+
+uint64_t ReportWriter::bytesWritten() const { return written; }
+
+void ReportWriter::flush() {
+    if (buf.empty()) return;
+    os.write(buf.data(), static_cast<streamsize>(buf.size()));
+    written += buf.size();
+    buf.clear();
+}
+
+void ReportWriter::finish() {
+    if (format == ReportFormat::Json && sections > 0) buf += "\n}\n";
+    sections = 0;
+    flush();
+    os.flush();
+}
+
+void ReportWriter::appendNumber(uint64_t value) {
+    char digits[24];
+    auto [end, ec] = to_chars(digits, digits + sizeof(digits), value);
+    buf.append(digits, end);
+}
+
+void ReportWriter::appendNumber(int64_t value) {
+    char digits[24];
+    auto [end, ec] = to_chars(digits, digits + sizeof(digits), value);
+    buf.append(digits, end);
+}
+
+void ReportWriter::appendJsonString(string_view s) {
+    static const char hex[] = "0123456789abcdef";
+    buf += '"';
+    size_t run = 0;  // start of the bytes that need no escaping
+    for (size_t i = 0; i < s.size(); ++i) {
+        unsigned char ch = static_cast<unsigned char>(s[i]);
+        if (ch >= 0x20 && ch != '"' && ch != '\\') continue;
+        buf.append(s.data() + run, i - run);
+        run = i + 1;
+        switch (ch) {
+            case '"':
+                buf += "\\\"";
+                break;
+            case '\\':
+                buf += "\\\\";
+                break;
+            case '\n':
+                buf += "\\n";
+                break;
+            case '\t':
+                buf += "\\t";
+                break;
+            case '\r':
+                buf += "\\r";
+                break;
+            default:
+                buf += "\\u00";
+                buf += hex[ch >> 4];
+                buf += hex[ch & 15];
+        }
+    }
+    buf.append(s.data() + run, s.size() - run);
+    buf += '"';
+}
+
+void ReportWriter::appendCsvField(string_view s) {
+    bool quote = false;
+    for (char ch : s) {
+        if (ch == ',' || ch == '"' || ch == '\n' || ch == '\r') {
+            quote = true;
+            break;
+        }
+    }
+    if (!quote) {
+        buf += s;
+        return;
+    }
+    buf += '"';
+    for (char ch : s) {
+        if (ch == '"') buf += '"';
+        buf += ch;
+    }
+    buf += '"';
+}
+
+void ReportWriter::appendItemText(const Item &item) {
+    auto field = [this](string_view key, string_view value) {
+        buf += ", ";
+        buf += key;
+        buf += "=\"";
+        buf += value;
+        buf += '"';
+    };
+    switch (item.type()) {
+        case ItemType::Book:
+            buf += "Book[id=";
+            break;
+        case ItemType::Movie:
+            buf += "Movie[id=";
+            break;
+        case ItemType::Magazine:
+            buf += "Magazine[id=";
+            break;
+        case ItemType::Item:
+            buf += "Item[id=";
+            break;
+    }
+    appendNumber(int64_t{item.getId()});
+    field("name", item.getName());
+    switch (item.type()) {
+        case ItemType::Book: {
+            const auto &b = static_cast<const Book &>(item);
+            field("title", b.getTitle());
+            field("author", b.getAuthor());
+            field("copyright", b.getCopyrightDate());
+            break;
+        }
+        case ItemType::Movie: {
+            const auto &m = static_cast<const Movie &>(item);
+            field("title", m.getTitle());
+            field("director", m.getDirector());
+            buf += ", actors=[";
+            const auto &actors = m.getMainActors();
+            for (size_t i = 0; i < actors.size(); ++i) {
+                if (i) buf += ", ";
+                buf += actors[i].str();
+            }
+            buf += ']';
+            break;
+        }
+        case ItemType::Magazine: {
+            const auto &m = static_cast<const Magazine &>(item);
+            field("edition", m.getEdition());
+            field("mainArticle", m.getMainArticleTitle());
+            break;
+        }
+        case ItemType::Item:
+            break;
+    }
+    field("desc", item.getDescription());
+    buf += ']';
+}
+
+void ReportWriter::appendItemJson(const Item &item) {
+    auto field = [this](string_view key, string_view value) {
+        buf += ",\"";
+        buf += key;
+        buf += "\":";
+        appendJsonString(value);
+    };
+    buf += "\"type\":\"";
+    buf += typeName(item.type());
+    buf += "\",\"id\":";
+    appendNumber(int64_t{item.getId()});
+    field("name", item.getName());
+    field("description", item.getDescription());
+    switch (item.type()) {
+        case ItemType::Book: {
+            const auto &b = static_cast<const Book &>(item);
+            field("title", b.getTitle());
+            field("author", b.getAuthor());
+            field("copyright", b.getCopyrightDate());
+            break;
+        }
+        case ItemType::Movie: {
+            const auto &m = static_cast<const Movie &>(item);
+            field("title", m.getTitle());
+            field("director", m.getDirector());
+            buf += ",\"actors\":[";
+            const auto &actors = m.getMainActors();
+            for (size_t i = 0; i < actors.size(); ++i) {
+                if (i) buf += ',';
+                appendJsonString(actors[i].str());
+            }
+            buf += ']';
+            break;
+        }
+        case ItemType::Magazine: {
+            const auto &m = static_cast<const Magazine &>(item);
+            field("edition", m.getEdition());
+            field("mainArticle", m.getMainArticleTitle());
+            break;
+        }
+        case ItemType::Item:
+            break;
+    }
+}
+
+void ReportWriter::appendItemCsv(const Item &item, size_t shelf, size_t comp, bool pad) {
+    auto field = [this](string_view value) {
+        buf += ',';
+        appendCsvField(value);
+    };
+    buf += typeName(item.type());
+    buf += ',';
+    appendNumber(uint64_t{shelf});
+    buf += ',';
+    appendNumber(uint64_t{comp});
+    buf += ',';
+    appendNumber(int64_t{item.getId()});
+    field(item.getName());
+    field(item.getDescription());
+    size_t columns = 6;
+    switch (item.type()) {
+        case ItemType::Book: {
+            const auto &b = static_cast<const Book &>(item);
+            field(b.getTitle());
+            field(b.getAuthor());
+            field(b.getCopyrightDate());
+            columns = 9;
+            break;
+        }
+        case ItemType::Movie: {
+            const auto &m = static_cast<const Movie &>(item);
+            field(m.getTitle());
+            field(m.getDirector());
+            // Join the actors in place; quote afterwards in the rare case
+            // that a name needs it.
+            buf += ',';
+            size_t at = buf.size();
+            const auto &actors = m.getMainActors();
+            for (size_t i = 0; i < actors.size(); ++i) {
+                if (i) buf += ';';
+                buf += actors[i].str();
+            }
+            string_view joined(buf.data() + at, buf.size() - at);
+            if (joined.find_first_of(",\"\n\r") != string_view::npos) {
+                string copy(joined);
+                buf.resize(at);
+                appendCsvField(copy);
+            }
+            columns = 9;
+            break;
+        }
+        case ItemType::Magazine: {
+            const auto &m = static_cast<const Magazine &>(item);
+            field(m.getEdition());
+            field(m.getMainArticleTitle());
+            columns = 8;
+            break;
+        }
+        case ItemType::Item:
+            break;
+    }
+    if (pad) buf.append(9 - columns, ',');
+}
+
+void ReportWriter::begin(ReportKind kind_) {
+    kind = kind_;
+    rows = 0;
+    switch (format) {
+        case ReportFormat::Text:
+            buf += kind == ReportKind::Storage ? "Items currently in storage:\n"
+                                               : "Items currently checked out:\n";
+            break;
+        case ReportFormat::Json:
+            buf += sections == 0 ? "{\n\"" : ",\n\"";
+            buf += sectionName(kind);
+            buf += "\": [";
+            break;
+        case ReportFormat::Csv:
+            buf += "type,shelf,comp,id,name,description,field1,field2,field3";
+            if (kind == ReportKind::CheckedOut) buf += ",person,due";
+            buf += '\n';
+            break;
+    }
+    ++sections;
+}
+
+void ReportWriter::row(const ItemLocation &loc) {
+    bool loan = kind == ReportKind::CheckedOut;
+    switch (format) {
+        case ReportFormat::Text:
+            buf += loan ? "  From shelf " : "  Shelf ";
+            appendNumber(uint64_t{loc.shelf});
+            buf += loan ? ", compartment " : ", Compartment ";
+            appendNumber(uint64_t{loc.comp});
+            buf += ": ";
+            appendItemText(*loc.item);
+            buf += '\n';
+            if (loan) {
+                buf += "    Checked out by: ";
+                buf += loc.person;
+                buf += " (due: ";
+                buf += loc.dueDate;
+                buf += ")\n";
+            }
+            break;
+        case ReportFormat::Json:
+            buf += rows == 0 ? "\n{\"shelf\":" : ",\n{\"shelf\":";
+            appendNumber(uint64_t{loc.shelf});
+            buf += ",\"comp\":";
+            appendNumber(uint64_t{loc.comp});
+            buf += ',';
+            appendItemJson(*loc.item);
+            if (loan) {
+                buf += ",\"person\":";
+                appendJsonString(loc.person);
+                buf += ",\"due\":";
+                appendJsonString(loc.dueDate);
+            }
+            buf += '}';
+            break;
+        case ReportFormat::Csv:
+            appendItemCsv(*loc.item, loc.shelf, loc.comp, loan);
+            if (loan) {
+                buf += ',';
+                appendCsvField(loc.person);
+                buf += ',';
+                appendCsvField(loc.dueDate);
+            }
+            buf += '\n';
+            break;
+    }
+    ++rows;
+    if (buf.size() >= flushAt) flush();
+}
+
+void ReportWriter::end() {
+    if (format == ReportFormat::Text && rows == 0) buf += "  (none)\n";
+    if (format == ReportFormat::Json) buf += rows == 0 ? "]" : "\n]";
+}
+
+ReportFormat reportFormatFor(string_view path) {
+    size_t dot = path.rfind('.');
+    string_view ext = dot == string_view::npos ? string_view() : path.substr(dot + 1);
+    if (ext == "json") return ReportFormat::Json;
+    if (ext == "csv") return ReportFormat::Csv;
+    return ReportFormat::Text;
+}
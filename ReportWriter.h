@@ -0,0 +1,88 @@
+#pragma once
+#include "LibraryStorage.h"
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <string_view>
+
+/*
+ * File: ReportWriter.h
+ * --------------------
+ * Buffered writer for inventory reports. Rows are formatted straight into
+ * one reusable buffer (integers with std::to_chars, strings copied from
+ * the items' string_views) and handed to the stream in large write()
+ * calls, so a report costs a few bytes of formatting per field instead of
+ * one iostream call per field.
+ *
+ * A report is one or more sections (begin/row/end):
+ *   Text - the listing printItemsInStorage/printCheckedOutItems show.
+ *   Json - one object; each section is an array of row objects under
+ *          "storage" or "checkedOut".
+ *   Csv  - a header line per section. Storage rows use the catalog file
+ *          layout (see CatalogLoader.h), so they can be loaded again.
+ *          Checked-out rows always have nine item columns (blank where a
+ *          type has fewer), then person and due date. The catalog loader
+ *          rejects those eleven-column rows, so a CSV report reloads to the
+ *          same inventory only when nothing is checked out; otherwise the
+ *          loans are reported as errors and only the shelves come back.
+ *          Use a snapshot (see Snapshot.h) to keep loans.
+ *
+ * Data Table (identifier | datatype | use)
+ * ----------------------------------------------------------------------
+ * ReportFormat | enum class    | Output syntax
+ * ReportKind   | enum class    | Which listing a section holds
+ * os           | std::ostream& | Destination
+ * buf          | std::string   | Formatted bytes not yet written
+ * flushAt      | size_t        | Buffer size that triggers a write
+ * kind         | ReportKind    | Section being written
+ * sections     | size_t        | Sections begun so far
+ * rows         | size_t        | Rows in the current section
+ * written      | uint64_t      | Bytes handed to os
+ *
+ */
+
+enum class ReportFormat { Text, Json, Csv };
+enum class ReportKind { Storage, CheckedOut };
+
+class ReportWriter {
+    std::ostream &os;
+    ReportFormat format;
+    std::string buf;
+    size_t flushAt;
+    ReportKind kind = ReportKind::Storage;
+    size_t sections = 0;
+    size_t rows = 0;
+    uint64_t written = 0;
+
+    void appendNumber(uint64_t value);
+    void appendNumber(int64_t value);
+    void appendJsonString(std::string_view s);
+    void appendCsvField(std::string_view s);
+    void appendItemText(const Item &item);
+    void appendItemJson(const Item &item);
+    // Catalog columns from type to the last item field; pad to nine.
+    void appendItemCsv(const Item &item, size_t shelf, size_t comp, bool pad);
+
+public:
+    explicit ReportWriter(std::ostream &os, ReportFormat format,
+                          size_t bufferSize = size_t{1} << 20);
+    // Calls finish().
+    ~ReportWriter();
+    ReportWriter(const ReportWriter &) = delete;
+    ReportWriter &operator=(const ReportWriter &) = delete;
+
+    void begin(ReportKind kind);
+    // loc.person and loc.dueDate are used in CheckedOut sections only.
+    void row(const ItemLocation &loc);
+    void end();
+
+    // Close the JSON object (if any section was written) and write out
+    // the buffer. Further sections start a new report.
+    void finish();
+    void flush();
+
+    uint64_t bytesWritten() const;
+};
+
+// "json" / "csv" / anything else -> Text, from a file name's extension.
+ReportFormat reportFormatFor(std::string_view path);
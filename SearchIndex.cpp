@@ -0,0 +1,295 @@
+#include "SearchIndex.h"
+#include <algorithm>
+#include <cmath>
+
+using namespace std;
+
+/*
+ * File: SearchIndex.cpp
+ * ---------------------
+ * Implements the inverted index declared in SearchIndex.h.
+ */
+
+namespace {
+
+constexpr double BM25_K1 = 1.2;
+constexpr double BM25_B = 0.75;
+constexpr uint32_t NO_DOC = ~uint32_t{0};
+
+uint64_t itemKey(const Item *item) { return reinterpret_cast<uintptr_t>(item); }
+
+bool isWordByte(unsigned char ch) {
+    return (ch >= 'a' && ch <= 'z') || (ch >= 'A' && ch <= 'Z') || (ch >= '0' && ch <= '9')
+           || ch >= 0x80;
+}
+
+// Lower bound for doc in list[from..], probing 1, 2, 4, ... ahead first
+// so that skipping over a long list costs O(log distance).
+template <typename P>
+size_t gallop(const vector<P> &list, size_t from, uint32_t doc) {
+    size_t lo = from, hi = from, step = 1;
+    while (hi < list.size() && list[hi].doc < doc) {
+        lo = hi + 1;
+        hi += step;
+        step *= 2;
+    }
+    hi = min(hi, list.size());
+    auto it = lower_bound(list.begin() + lo, list.begin() + hi, doc,
+                          [](const P &p, uint32_t d) { return p.doc < d; });
+    return static_cast<size_t>(it - list.begin());
+}
+
+struct Candidate {
+    double score;
+    uint32_t doc;
+};
+
+// Higher score first, then earlier document. Used as the heap's
+// less-than, which keeps the weakest of the best k on top.
+bool stronger(const Candidate &a, const Candidate &b) {
+    if (a.score != b.score) return a.score > b.score;
+    return a.doc < b.doc;
+}
+
+} // namespace
+
+void SearchIndex::PostingList::append(Posting p, uint32_t len) {
+    if (items.size() % BLOCK == 0) blocks.push_back({0, ~uint32_t{0}});
+    items.push_back(p);
+    Block &b = blocks.back();
+    b.maxTf = max(b.maxTf, p.tf);
+    b.minLen = min(b.minLen, len);
+    bound.maxTf = max(bound.maxTf, p.tf);
+    bound.minLen = min(bound.minLen, len);
+}
+
+void SearchIndex::tokenize(string_view text, vector<string> &out) {
+    size_t i = 0;
+    while (i < text.size()) {
+        while (i < text.size() && !isWordByte(static_cast<unsigned char>(text[i]))) ++i;
+        size_t start = i;
+        while (i < text.size() && isWordByte(static_cast<unsigned char>(text[i]))) ++i;
+        if (i == start) break;
+        string &word = out.emplace_back(text.substr(start, i - start));
+        for (char &ch : word) {
+            if (ch >= 'A' && ch <= 'Z') ch = static_cast<char>(ch - 'A' + 'a');
+        }
+    }
+}
+
+void SearchIndex::add(const Item *item) {
+    if (!item || docOf.find(itemKey(item)) != LoanIndex::NPOS) return;
+
+    tokens.clear();
+    tokenize(item->getName(), tokens);
+    tokenize(item->getDescription(), tokens);
+    switch (item->type()) {
+        case ItemType::Book: {
+            const auto &b = static_cast<const Book &>(*item);
+            tokenize(b.getTitle(), tokens);
+            tokenize(b.getAuthor(), tokens);
+            break;
+        }
+        case ItemType::Movie: {
+            const auto &m = static_cast<const Movie &>(*item);
+            tokenize(m.getTitle(), tokens);
+            tokenize(m.getDirector(), tokens);
+            for (Symbol a : m.getMainActors()) tokenize(a.str(), tokens);
+            break;
+        }
+        case ItemType::Magazine:
+            tokenize(static_cast<const Magazine &>(*item).getMainArticleTitle(), tokens);
+            break;
+        case ItemType::Item:
+            break;
+    }
+
+    terms.clear();
+    for (string &t : tokens) {
+        auto [it, inserted] =
+            termIds.try_emplace(move(t), static_cast<uint32_t>(postings.size()));
+        if (inserted) postings.emplace_back();
+        terms.push_back(it->second);
+    }
+    sort(terms.begin(), terms.end());
+
+    uint32_t doc = static_cast<uint32_t>(docs.size());
+    uint32_t len = static_cast<uint32_t>(tokens.size());
+    for (size_t i = 0; i < terms.size();) {
+        size_t j = i;
+        while (j < terms.size() && terms[j] == terms[i]) ++j;
+        postings[terms[i]].append({doc, static_cast<uint32_t>(j - i)}, len);
+        i = j;
+    }
+    docs.push_back(item);
+    docLen.push_back(len);
+    docOf.insert(itemKey(item), doc);
+    ++live;
+    totalLen += tokens.size();
+}
+
+bool SearchIndex::remove(const Item *item) {
+    size_t doc = docOf.find(itemKey(item));
+    if (doc == LoanIndex::NPOS) return false;
+    docOf.erase(itemKey(item));
+    docs[doc] = nullptr;
+    totalLen -= docLen[doc];
+    --live;
+    if (docs.size() >= 1024 && docs.size() - live > live) compact();
+    return true;
+}
+
+// Renumber the live documents in their existing order and drop the dead
+// postings. Order is preserved, so every list stays sorted; block bounds
+// are recomputed without the dead documents.
+void SearchIndex::compact() {
+    vector<uint32_t> newDoc(docs.size(), NO_DOC);
+    vector<const Item *> liveDocs;
+    vector<uint32_t> liveLen;
+    liveDocs.reserve(live);
+    liveLen.reserve(live);
+    docOf.clear();
+    for (size_t d = 0; d < docs.size(); ++d) {
+        if (!docs[d]) continue;
+        newDoc[d] = static_cast<uint32_t>(liveDocs.size());
+        docOf.insert(itemKey(docs[d]), liveDocs.size());
+        liveDocs.push_back(docs[d]);
+        liveLen.push_back(docLen[d]);
+    }
+    for (PostingList &list : postings) {
+        PostingList kept;
+        for (const Posting &p : list.items) {
+            uint32_t d = newDoc[p.doc];
+            if (d != NO_DOC) kept.append({d, p.tf}, liveLen[d]);
+        }
+        list = move(kept);
+    }
+    docs = move(liveDocs);
+    docLen = move(liveLen);
+}
+
+void SearchIndex::clear() {
+    termIds.clear();
+    postings.clear();
+    docs.clear();
+    docLen.clear();
+    docOf.clear();
+    live = 0;
+    totalLen = 0;
+}
+
+size_t SearchIndex::size() const { return live; }
+size_t SearchIndex::numTerms() const { return termIds.size(); }
+
+vector<SearchHit> SearchIndex::search(string_view query, size_t k) const {
+    vector<SearchHit> hits;
+    if (k == 0 || live == 0) return hits;
+
+    vector<string> words;
+    tokenize(query, words);
+    sort(words.begin(), words.end());
+    words.erase(unique(words.begin(), words.end()), words.end());
+    if (words.empty()) return hits;
+
+    vector<const PostingList *> lists;
+    for (const string &w : words) {
+        auto it = termIds.find(w);
+        if (it == termIds.end() || postings[it->second].items.empty()) return hits;
+        lists.push_back(&postings[it->second]);
+    }
+    sort(lists.begin(), lists.end(), [](const PostingList *a, const PostingList *b) {
+        return a->items.size() < b->items.size();
+    });
+
+    double n = static_cast<double>(live);
+    double avgLen = max(1.0, static_cast<double>(totalLen) / n);
+    vector<double> idf(lists.size());
+    for (size_t j = 0; j < lists.size(); ++j) {
+        // Dead postings still count toward df until compaction.
+        double df = min(n, static_cast<double>(lists[j]->items.size()));
+        idf[j] = log(1.0 + (n - df + 0.5) / (df + 0.5));
+    }
+    // BM25 term weight. Grows with tf and shrinks with len, so a block's
+    // (maxTf, minLen) gives an upper bound for every posting in it.
+    auto termScore = [&](size_t j, uint32_t tf, uint32_t len) {
+        double norm = BM25_K1 * (1.0 - BM25_B + BM25_B * len / avgLen);
+        return idf[j] * tf * (BM25_K1 + 1.0) / (tf + norm);
+    };
+
+    // Walk the shortest list and look each document up in the others.
+    const vector<Posting> &lead = lists[0]->items;
+    vector<Candidate> heap;
+    heap.reserve(min(k, lead.size()));
+    vector<size_t> pos(lists.size(), 0);
+    vector<uint32_t> maxTf(lists.size(), 0);
+    bool exhausted = false;
+    for (size_t b = 0; b < lists[0]->blocks.size() && !exhausted; ++b) {
+        size_t begin = b * BLOCK;
+        size_t end = min(lead.size(), begin + BLOCK);
+
+        // Bound the score of any document in this block from the block
+        // bounds of every list over the same range of documents. A match
+        // is in all of those blocks, so its length is at least the largest
+        // of their minimum lengths. Later documents lose ties, so a block
+        // that can at best equal the weakest held result has nothing to add.
+        const Block &blk = lists[0]->blocks[b];
+        maxTf[0] = blk.maxTf;
+        uint32_t minLen = blk.minLen;
+        bool empty = false;
+        for (size_t j = 1; j < lists.size(); ++j) {
+            const PostingList &list = *lists[j];
+            pos[j] = gallop(list.items, pos[j], lead[begin].doc);
+            size_t last = gallop(list.items, pos[j], lead[end - 1].doc + 1);
+            if (pos[j] == list.items.size()) exhausted = true;
+            if (pos[j] == last) {
+                empty = true;
+                break;
+            }
+            uint32_t listMinLen = ~uint32_t{0};
+            maxTf[j] = 0;
+            for (size_t q = pos[j] / BLOCK; q <= (last - 1) / BLOCK; ++q) {
+                maxTf[j] = max(maxTf[j], list.blocks[q].maxTf);
+                listMinLen = min(listMinLen, list.blocks[q].minLen);
+            }
+            minLen = max(minLen, listMinLen);
+        }
+        if (empty) continue;
+        if (heap.size() == k) {
+            double best = 0;
+            for (size_t j = 0; j < lists.size(); ++j) best += termScore(j, maxTf[j], minLen);
+            if (best <= heap.front().score) continue;
+        }
+
+        for (size_t i = begin; i < end; ++i) {
+            uint32_t doc = lead[i].doc;
+            if (!docs[doc]) continue;
+            double score = termScore(0, lead[i].tf, docLen[doc]);
+            bool matched = true;
+            for (size_t j = 1; j < lists.size(); ++j) {
+                const vector<Posting> &list = lists[j]->items;
+                pos[j] = gallop(list, pos[j], doc);
+                if (pos[j] == list.size() || list[pos[j]].doc != doc) {
+                    matched = false;
+                    break;
+                }
+                score += termScore(j, list[pos[j]].tf, docLen[doc]);
+            }
+            if (!matched) continue;
+
+            Candidate c{score, doc};
+            if (heap.size() < k) {
+                heap.push_back(c);
+                push_heap(heap.begin(), heap.end(), stronger);
+            } else if (stronger(c, heap.front())) {
+                pop_heap(heap.begin(), heap.end(), stronger);
+                heap.back() = c;
+                push_heap(heap.begin(), heap.end(), stronger);
+            }
+        }
+    }
+
+    sort_heap(heap.begin(), heap.end(), stronger);
+    hits.reserve(heap.size());
+    for (const Candidate &c : heap) hits.push_back({docs[c.doc], c.score});
+    return hits;
+}
@@ -0,0 +1,104 @@
+#pragma once
+#include "Item.h"
+#include "LoanIndex.h"
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+/*
+ * File: SearchIndex.h
+ * -------------------
+ * Inverted index for word search over items. Indexed text: name,
+ * description, Book title/author, Movie title/director/actors and
+ * Magazine main article title. Text is split into lower-case ASCII
+ * letter/digit runs; other bytes separate words (bytes >= 0x80 are kept
+ * so UTF-8 words stay whole).
+ *
+ * A query matches items containing every query word. Matches are ranked
+ * with BM25 and the best k are returned.
+ *
+ * Documents are numbered in insertion order, so each posting list is
+ * sorted by document and intersection is a merge with galloping search.
+ * remove() only marks a document dead; dead postings are skipped by
+ * queries and dropped once they make up half of the index.
+ *
+ * Each posting list keeps, per block of BLOCK postings, the largest term
+ * frequency and the shortest document in it. That bounds the best score
+ * any document in the block can reach, so once k results are held a
+ * query skips whole blocks that cannot beat the weakest of them.
+ *
+ * Data Table (identifier | datatype | use)
+ * ------------------------------------------------------------------------
+ * Posting     | struct                          | Document number + term frequency
+ * Block       | struct                          | Max tf / min length over BLOCK postings
+ * PostingList | struct                          | Postings of one term + per-block bounds
+ * SearchHit   | struct                          | One ranked result
+ * termIds     | std::unordered_map<string, u32> | Word -> term number
+ * postings    | std::vector<PostingList>        | Per term, documents containing it
+ * docs        | std::vector<const Item*>        | Document number -> item (nullptr = removed)
+ * docLen      | std::vector<uint32_t>           | Words per document
+ * docOf       | LoanIndex                       | Item address -> document number
+ * live        | size_t                          | Documents not removed
+ * totalLen    | uint64_t                        | Sum of docLen over live documents
+ *
+ */
+
+struct SearchHit {
+    const Item *item;
+    double score;
+};
+
+class SearchIndex {
+    static constexpr size_t BLOCK = 128;
+
+    struct Posting {
+        uint32_t doc;
+        uint32_t tf;
+    };
+
+    struct Block {
+        uint32_t maxTf;
+        uint32_t minLen;
+    };
+
+    struct PostingList {
+        std::vector<Posting> items;
+        std::vector<Block> blocks;  // blocks[b] covers items[b*BLOCK, (b+1)*BLOCK)
+        Block bound{0, ~uint32_t{0}}; // over the whole list
+
+        void append(Posting p, uint32_t len);
+    };
+
+    std::unordered_map<std::string, uint32_t> termIds;
+    std::vector<PostingList> postings;
+    std::vector<const Item *> docs;
+    std::vector<uint32_t> docLen;
+    LoanIndex docOf;
+    size_t live = 0;
+    uint64_t totalLen = 0;
+
+    // Scratch for add(); kept to avoid reallocating per item.
+    std::vector<std::string> tokens;
+    std::vector<uint32_t> terms;
+
+    void compact();
+
+public:
+    // Append the words of text to out.
+    static void tokenize(std::string_view text, std::vector<std::string> &out);
+
+    // Index item; the pointer must stay valid until it is removed.
+    void add(const Item *item);
+    // Returns false if item is not indexed.
+    bool remove(const Item *item);
+    void clear();
+
+    size_t size() const;
+    size_t numTerms() const;
+
+    // Best k items containing every word of query, highest score first.
+    std::vector<SearchHit> search(std::string_view query, size_t k) const;
+};
@@ -0,0 +1,161 @@
+#include "Journal.h"
+#include "LibraryServer.h"
+#include "TestCheck.h"
+#include <algorithm>
+#include <csignal>
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+using namespace std;
+
+/*
+ * File: ServerTest.cpp
+ * --------------------
+ * LibraryCheckout_server_test: a LibraryServer with a journal, served on
+ * a Unix socket from a second thread, driven by plain blocking clients
+ * (run by ctest). Covers pipelined replies in order, locations no storage
+ * can have, transactions private to their connection, and a journal that
+ * cannot be synced: that batch must not be acknowledged.
+ *
+ * Data Table (identifier | datatype | use)
+ * ----------------------------------------------------------------------
+ * Client | struct | One blocking connection to the server's socket
+ *
+ */
+
+namespace {
+
+struct Client {
+    int fd = -1;
+
+    explicit Client(const string &path) {
+        fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        sockaddr_un sa{};
+        sa.sun_family = AF_UNIX;
+        memcpy(sa.sun_path, path.c_str(), path.size() + 1);
+        if (connect(fd, reinterpret_cast<sockaddr *>(&sa), sizeof(sa)) != 0) {
+            ::close(fd);
+            fd = -1;
+        }
+    }
+    ~Client() {
+        if (fd >= 0) ::close(fd);
+    }
+    Client(const Client &) = delete;
+    Client &operator=(const Client &) = delete;
+
+    // Send text in one go, then read until lines reply lines have arrived
+    // or the server closes the connection.
+    string send(const string &text, size_t lines) {
+        if (fd < 0 || ::send(fd, text.data(), text.size(), MSG_NOSIGNAL) < 0) return "";
+        string reply;
+        char buf[4096];
+        while (static_cast<size_t>(count(reply.begin(), reply.end(), '\n')) < lines) {
+            ssize_t n = recv(fd, buf, sizeof(buf), 0);
+            if (n <= 0) break;
+            reply.append(buf, static_cast<size_t>(n));
+        }
+        return reply;
+    }
+
+    // True once the server has closed the connection.
+    bool closed() {
+        char c;
+        return recv(fd, &c, 1, 0) == 0;
+    }
+};
+
+const string ADD = "add book 0 0 1 Dune Desert Dune Herbert 1965\n";
+
+void testPipelined(const string &path) {
+    Client c(path);
+    CHECK(c.fd >= 0);
+    string reply = c.send(ADD + "checkout 0 0 Ann 2026-01-01\n"
+                                "checkin 4294967295 4294967295\n"
+                                "checkin 0 4294967297\n"
+                                "checkin 1 64\n"
+                                "find 1\n",
+                          7);
+    CHECK(reply.rfind("ok\nok\nerror: invalid location\nerror: invalid location\n"
+                      "error: no such compartment\nok\n  0 0 out Ann 2026-01-01 ",
+                      0)
+          == 0);
+    // Still serving after the bad locations.
+    CHECK(c.send("checkin 0 0\n", 1) == "ok\n");
+}
+
+void testTransactionsPerConnection(const string &path) {
+    Client a(path), b(path);
+    CHECK(a.send("begin\nadd book 0 5 2 Emma Novel Emma Austen 1815\n", 2) == "ok\nok\n");
+    CHECK(b.send("find 2\n", 1) == "error: no item with id 2\n");
+    CHECK(b.send("commit\n", 1) == "error: no transaction is open\n");
+    CHECK(a.send("commit\n", 1) == "ok\n");
+    CHECK(b.send("find 2\n", 2).rfind("ok\n  0 5 ", 0) == 0);
+}
+
+// Writes past the journal's current size fail with EFBIG while this is
+// in place, so its sync fails.
+void testSyncFailure(const string &path, const string &journalPath) {
+    signal(SIGXFSZ, SIG_IGN);
+    rlimit saved{};
+    getrlimit(RLIMIT_FSIZE, &saved);
+    rlimit limit = saved;
+    limit.rlim_cur = static_cast<rlim_t>(filesystem::file_size(journalPath));
+    setrlimit(RLIMIT_FSIZE, &limit);
+
+    Client earlier(path), c(path);
+    CHECK(earlier.send("find 1\n", 2).rfind("ok\n", 0) == 0);
+    CHECK(c.send("add book 1 0 3 Heat Heist Heat Mann 1995\n", 1).empty());
+    CHECK(c.closed());
+
+    setrlimit(RLIMIT_FSIZE, &saved);
+    // A connection with nothing in that batch keeps working, and the next
+    // batch syncs what the failed one left behind.
+    CHECK(earlier.send("find 3\n", 2).rfind("ok\n  1 0 ", 0) == 0);
+    CHECK(earlier.send("checkout 1 0 Bob 2026-02-01\n", 1) == "ok\n");
+}
+
+} // namespace
+
+int main() {
+    filesystem::path dir =
+        filesystem::temp_directory_path() / ("server_test_" + to_string(getpid()));
+    filesystem::create_directories(dir);
+    string path = (dir / "library.sock").string();
+    string journalPath = (dir / "library.journal").string();
+
+    LibraryStorage lib(2);
+    Journal journal;
+    CHECK(journal.open(journalPath, 0, 0));
+    lib.attachJournal(&journal);
+    LibraryServer server(lib, &journal);
+    CHECK(server.listen("unix:" + path));
+    ServerStats stats;
+    thread serving([&] { stats = server.run(); });
+
+    testPipelined(path);
+    testTransactionsPerConnection(path);
+    testSyncFailure(path, journalPath);
+
+    server.stop();
+    serving.join();
+    CHECK(stats.unacknowledged == 1);
+    lib.attachJournal(nullptr);
+    journal.close();
+
+    // Everything acknowledged, and what the failed batch left, replays.
+    LibraryStorage replayed(2);
+    ReplayResult r = replayJournal(journalPath, replayed, 0);
+    CHECK(r.ok && !r.tornTail);
+    CHECK(replayed.findById(2) && replayed.loanCount("Bob") == 1);
+
+    filesystem::remove_all(dir);
+    return testSummary("server");
+}
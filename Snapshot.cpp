@@ -0,0 +1,466 @@
+#include "Snapshot.h"
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <string_view>
+#include <unordered_map>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using namespace std;
+
+/*
+ * File: Snapshot.cpp
+ * ------------------
+ * Implements saveSnapshot/loadSnapshot declared in Snapshot.h. Saving
+ * deduplicates strings into the table; loading mmaps the file, checks
+ * every count, offset and string id against the file size, then rebuilds
+ * a fresh LibraryStorage that replaces the caller's only on success.
+ */
+
+namespace {
+
+constexpr char SNAPSHOT_MAGIC[8] = {'L', 'I', 'B', 'S', 'N', 'A', 'P', '\0'};
+constexpr uint32_t NO_STRING = ~uint32_t{0};
+
+struct SnapshotHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t reserved;
+    uint64_t numShelves;
+    uint64_t numItems;
+    uint64_t numLoans;
+    uint64_t numHolds;
+    uint64_t numActorRefs;
+    uint64_t numStrings;
+    uint64_t stringBytes;
+    uint64_t journalSeq;
+};
+
+// field1..field3 hold the type-specific strings in declaration order:
+// Book title/author/copyright, Movie title/director, Magazine
+// edition/mainArticle. Unused fields are NO_STRING.
+struct ItemRecord {
+    uint8_t type;
+    uint8_t pad[3];
+    int32_t id;
+    uint32_t shelf;
+    uint32_t comp;
+    uint32_t name;
+    uint32_t description;
+    uint32_t field1;
+    uint32_t field2;
+    uint32_t field3;
+    uint32_t actorsBegin;
+    uint32_t actorsCount;
+    uint32_t pad2;
+};
+
+struct LoanRecord {
+    ItemRecord item;
+    uint32_t person;
+    uint32_t dueDate;
+};
+
+// position 0: the item at (shelf, comp) is set aside for person;
+// otherwise person's place in the queue for it.
+struct HoldRecord {
+    uint32_t shelf;
+    uint32_t comp;
+    uint32_t person;
+    uint32_t position;
+};
+
+size_t align8(size_t n) { return (n + 7) & ~size_t{7}; }
+
+// Section offsets, derived from the header counts.
+struct Layout {
+    size_t shelves, items, loans, holds, actors, offsets, data, end;
+
+    explicit Layout(const SnapshotHeader &h) {
+        shelves = sizeof(SnapshotHeader);
+        items = align8(shelves + h.numShelves * sizeof(uint32_t));
+        loans = items + h.numItems * sizeof(ItemRecord);
+        holds = loans + h.numLoans * sizeof(LoanRecord);
+        actors = holds + h.numHolds * sizeof(HoldRecord);
+        offsets = align8(actors + h.numActorRefs * sizeof(uint32_t));
+        data = offsets + (h.numStrings + 1) * sizeof(uint64_t);
+        end = data + h.stringBytes;
+    }
+};
+
+// ------------------ Saving ------------------
+
+class SnapshotWriter {
+    unordered_map<string_view, uint32_t> ids;
+    vector<string_view> strings;
+    uint64_t stringBytes = 0;
+
+public:
+    vector<ItemRecord> items;
+    vector<LoanRecord> loans;
+    vector<HoldRecord> holds;
+    vector<uint32_t> actorRefs;
+    vector<uint32_t> shelfCapacities;
+
+    // Views point into items owned by the storage being saved.
+    uint32_t intern(string_view s) {
+        auto [it, inserted] = ids.emplace(s, static_cast<uint32_t>(strings.size()));
+        if (inserted) {
+            strings.push_back(s);
+            stringBytes += s.size();
+        }
+        return it->second;
+    }
+
+    ItemRecord encode(const Item &item, size_t shelf, size_t comp) {
+        ItemRecord r{};
+        r.type = static_cast<uint8_t>(item.type());
+        r.id = item.getId();
+        r.shelf = static_cast<uint32_t>(shelf);
+        r.comp = static_cast<uint32_t>(comp);
+        r.name = intern(item.getName());
+        r.description = intern(item.getDescription());
+        r.field1 = r.field2 = r.field3 = NO_STRING;
+
+        switch (item.type()) {
+            case ItemType::Book: {
+                const auto &b = static_cast<const Book &>(item);
+                r.field1 = intern(b.getTitle());
+                r.field2 = intern(b.getAuthor());
+                r.field3 = intern(b.getCopyrightDate());
+                break;
+            }
+            case ItemType::Movie: {
+                const auto &m = static_cast<const Movie &>(item);
+                r.field1 = intern(m.getTitle());
+                r.field2 = intern(m.getDirector());
+                r.actorsBegin = static_cast<uint32_t>(actorRefs.size());
+                r.actorsCount = static_cast<uint32_t>(m.getMainActors().size());
+                for (const auto &a : m.getMainActors()) actorRefs.push_back(intern(a));
+                break;
+            }
+            case ItemType::Magazine: {
+                const auto &m = static_cast<const Magazine &>(item);
+                r.field1 = intern(m.getEdition());
+                r.field2 = intern(m.getMainArticleTitle());
+                break;
+            }
+            case ItemType::Item:
+                break;
+        }
+        return r;
+    }
+
+    bool write(const string &path, uint64_t journalSeq) const {
+        SnapshotHeader h{};
+        memcpy(h.magic, SNAPSHOT_MAGIC, sizeof(h.magic));
+        h.version = SNAPSHOT_VERSION;
+        h.numShelves = shelfCapacities.size();
+        h.numItems = items.size();
+        h.numLoans = loans.size();
+        h.numHolds = holds.size();
+        h.numActorRefs = actorRefs.size();
+        h.numStrings = strings.size();
+        h.stringBytes = stringBytes;
+        h.journalSeq = journalSeq;
+        Layout layout(h);
+
+        vector<uint64_t> offsets;
+        offsets.reserve(strings.size() + 1);
+        uint64_t pos = 0;
+        for (string_view s : strings) {
+            offsets.push_back(pos);
+            pos += s.size();
+        }
+        offsets.push_back(pos);
+
+        ofstream out(path, ios::binary | ios::trunc);
+        if (!out) return false;
+        static const char zeros[8] = {};
+        out.write(reinterpret_cast<const char *>(&h), sizeof(h));
+        out.write(reinterpret_cast<const char *>(shelfCapacities.data()),
+                  static_cast<streamsize>(shelfCapacities.size() * sizeof(uint32_t)));
+        out.write(zeros, static_cast<streamsize>(layout.items - layout.shelves
+                                                 - shelfCapacities.size() * sizeof(uint32_t)));
+        out.write(reinterpret_cast<const char *>(items.data()),
+                  static_cast<streamsize>(items.size() * sizeof(ItemRecord)));
+        out.write(reinterpret_cast<const char *>(loans.data()),
+                  static_cast<streamsize>(loans.size() * sizeof(LoanRecord)));
+        out.write(reinterpret_cast<const char *>(holds.data()),
+                  static_cast<streamsize>(holds.size() * sizeof(HoldRecord)));
+        out.write(reinterpret_cast<const char *>(actorRefs.data()),
+                  static_cast<streamsize>(actorRefs.size() * sizeof(uint32_t)));
+        out.write(zeros, static_cast<streamsize>(layout.offsets - layout.actors
+                                                 - actorRefs.size() * sizeof(uint32_t)));
+        out.write(reinterpret_cast<const char *>(offsets.data()),
+                  static_cast<streamsize>(offsets.size() * sizeof(uint64_t)));
+        for (string_view s : strings) out.write(s.data(), static_cast<streamsize>(s.size()));
+        out.flush();
+        return static_cast<bool>(out);
+    }
+};
+
+// ------------------ Loading ------------------
+
+// Read-only view of a mapped snapshot with bounds-checked accessors.
+class SnapshotView {
+    const char *base;
+    const SnapshotHeader *h;
+    const uint64_t *offsets;
+    const uint32_t *actorRefs;
+
+public:
+    SnapshotView(const char *data, const SnapshotHeader &header)
+        : base(data), h(&header) {
+        Layout layout(header);
+        offsets = reinterpret_cast<const uint64_t *>(base + layout.offsets);
+        actorRefs = reinterpret_cast<const uint32_t *>(base + layout.actors);
+    }
+
+    bool validStrings() const {
+        for (uint64_t i = 0; i < h->numStrings; ++i) {
+            if (offsets[i] > offsets[i + 1]) return false;
+        }
+        return offsets[0] == 0 && offsets[h->numStrings] == h->stringBytes;
+    }
+
+    bool str(uint32_t id, string &out) const {
+        if (id >= h->numStrings) return false;
+        const char *data = base + Layout(*h).data;
+        out.assign(data + offsets[id], data + offsets[id + 1]);
+        return true;
+    }
+
+    unique_ptr<Item> decode(const ItemRecord &r) const {
+        string name, description, f1, f2, f3;
+        if (!str(r.name, name) || !str(r.description, description)) return nullptr;
+
+        switch (static_cast<ItemType>(r.type)) {
+            case ItemType::Book:
+                if (!str(r.field1, f1) || !str(r.field2, f2) || !str(r.field3, f3)) {
+                    return nullptr;
+                }
+                return make_unique<Book>(move(name), move(description), r.id, move(f1),
+                                         move(f2), move(f3));
+            case ItemType::Movie: {
+                if (!str(r.field1, f1) || !str(r.field2, f2)) return nullptr;
+                if (r.actorsBegin > h->numActorRefs
+                    || r.actorsCount > h->numActorRefs - r.actorsBegin) {
+                    return nullptr;
+                }
+                vector<string> actors(r.actorsCount);
+                for (uint32_t i = 0; i < r.actorsCount; ++i) {
+                    if (!str(actorRefs[r.actorsBegin + i], actors[i])) return nullptr;
+                }
+                return make_unique<Movie>(move(name), move(description), r.id, move(f1),
+                                          move(f2), move(actors));
+            }
+            case ItemType::Magazine:
+                if (!str(r.field1, f1) || !str(r.field2, f2)) return nullptr;
+                return make_unique<Magazine>(move(name), move(description), r.id, move(f1),
+                                             move(f2));
+            case ItemType::Item:
+                return make_unique<Item>(move(name), move(description), r.id);
+        }
+        return nullptr;
+    }
+};
+
+// Owns a read-only mapping of a whole file.
+class MappedFile {
+    void *addr = MAP_FAILED;
+    size_t len = 0;
+
+public:
+    explicit MappedFile(const string &path) {
+        int fd = open(path.c_str(), O_RDONLY);
+        if (fd < 0) return;
+        struct stat st {};
+        if (fstat(fd, &st) == 0 && st.st_size > 0) {
+            len = static_cast<size_t>(st.st_size);
+            addr = mmap(nullptr, len, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (addr != MAP_FAILED) madvise(addr, len, MADV_SEQUENTIAL);
+        }
+        close(fd);
+    }
+    ~MappedFile() {
+        if (addr != MAP_FAILED) munmap(addr, len);
+    }
+    MappedFile(const MappedFile &) = delete;
+    MappedFile &operator=(const MappedFile &) = delete;
+
+    bool ok() const { return addr != MAP_FAILED; }
+    const char *data() const { return static_cast<const char *>(addr); }
+    size_t size() const { return len; }
+};
+
+// fsync a file or directory by name.
+bool syncPath(const string &path) {
+    int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return false;
+    bool ok = fsync(fd) == 0;
+    close(fd);
+    return ok;
+}
+
+string directoryOf(const string &path) {
+    size_t slash = path.rfind('/');
+    if (slash == string::npos) return ".";
+    return slash == 0 ? "/" : path.substr(0, slash);
+}
+
+} // namespace
+
+bool saveSnapshot(const LibraryStorage &lib, const string &path, uint64_t journalSeq) {
+    SnapshotWriter w;
+    for (size_t s = 0; s < lib.numShelves(); ++s) {
+        w.shelfCapacities.push_back(static_cast<uint32_t>(lib[s].capacity()));
+    }
+    for (const ItemLocation &loc : lib.items()) {
+        w.items.push_back(w.encode(*loc.item, loc.shelf, loc.comp));
+    }
+    for (const ItemLocation &loc : lib.loans()) {
+        LoanRecord lr{};
+        lr.item = w.encode(*loc.item, loc.shelf, loc.comp);
+        lr.person = w.intern(loc.person);
+        lr.dueDate = w.intern(loc.dueDate);
+        w.loans.push_back(lr);
+    }
+    for (const HoldInfo &hold : lib.holds()) {
+        w.holds.push_back({static_cast<uint32_t>(hold.shelf), static_cast<uint32_t>(hold.comp),
+                           w.intern(hold.person), static_cast<uint32_t>(hold.position)});
+    }
+
+    // The data must be on disk before the rename makes it the snapshot, and
+    // the rename itself is only durable once the directory is synced.
+    string tmp = path + ".tmp";
+    if (!w.write(tmp, journalSeq) || !syncPath(tmp)) {
+        cerr << "Error: Could not write snapshot \"" << tmp << "\".\n";
+        remove(tmp.c_str());
+        return false;
+    }
+    if (rename(tmp.c_str(), path.c_str()) != 0) {
+        cerr << "Error: Could not replace snapshot \"" << path << "\".\n";
+        remove(tmp.c_str());
+        return false;
+    }
+    if (!syncPath(directoryOf(path))) {
+        cerr << "Error: Could not sync the directory of snapshot \"" << path << "\".\n";
+        return false;
+    }
+    return true;
+}
+
+bool loadSnapshot(const string &path, LibraryStorage &lib, uint64_t *journalSeq) {
+    MappedFile file(path);
+    if (!file.ok()) {
+        cerr << "Error: Could not open snapshot \"" << path << "\".\n";
+        return false;
+    }
+    if (file.size() < sizeof(SnapshotHeader)) {
+        cerr << "Error: Snapshot \"" << path << "\" is truncated.\n";
+        return false;
+    }
+
+    const auto &h = *reinterpret_cast<const SnapshotHeader *>(file.data());
+    if (memcmp(h.magic, SNAPSHOT_MAGIC, sizeof(h.magic)) != 0) {
+        cerr << "Error: \"" << path << "\" is not a library snapshot.\n";
+        return false;
+    }
+    if (h.version != SNAPSHOT_VERSION) {
+        cerr << "Error: Unsupported snapshot version " << h.version << ".\n";
+        return false;
+    }
+    // Bound every count by the file size before computing offsets from them.
+    if (h.numItems > file.size() || h.numLoans > file.size() || h.numHolds > file.size()
+        || h.numActorRefs > file.size() || h.numStrings > file.size()
+        || h.stringBytes > file.size() || h.numShelves > file.size()
+        || Layout(h).end > file.size()) {
+        cerr << "Error: Snapshot \"" << path << "\" is truncated or corrupt.\n";
+        return false;
+    }
+
+    SnapshotView view(file.data(), h);
+    if (!view.validStrings()) {
+        cerr << "Error: Snapshot \"" << path << "\" has a corrupt string table.\n";
+        return false;
+    }
+
+    Layout layout(h);
+    const auto *capacities = reinterpret_cast<const uint32_t *>(file.data() + layout.shelves);
+    const auto *items = reinterpret_cast<const ItemRecord *>(file.data() + layout.items);
+    const auto *loans = reinterpret_cast<const LoanRecord *>(file.data() + layout.loans);
+    const auto *holds = reinterpret_cast<const HoldRecord *>(file.data() + layout.holds);
+
+    LibraryStorage fresh(0);
+    for (uint64_t s = 0; s < h.numShelves; ++s) {
+        if (capacities[s] == 0 || capacities[s] > Shelf::MAX_CAPACITY) {
+            cerr << "Error: Snapshot shelf " << s << " has invalid capacity " << capacities[s]
+                 << ".\n";
+            return false;
+        }
+        (void)fresh.addShelf(capacities[s]);
+    }
+    if (lib.itemArena()) fresh.enableArena();
+    if (lib.searchEnabled()) fresh.enableSearch();
+    ItemArena::Scope scope(fresh.itemArena());
+    vector<PlacedItem> batch;
+    batch.reserve(h.numItems);
+    for (uint64_t i = 0; i < h.numItems; ++i) {
+        unique_ptr<Item> item = view.decode(items[i]);
+        if (!item) {
+            cerr << "Error: Snapshot item record " << i << " is corrupt.\n";
+            return false;
+        }
+        batch.push_back({move(item), items[i].shelf, items[i].comp});
+    }
+    vector<IngestError> errors = fresh.addItems(batch);
+    if (!errors.empty()) {
+        cerr << "Error: Snapshot item record " << errors.front().row << ": "
+             << errors.front().message << ".\n";
+        return false;
+    }
+
+    for (uint64_t i = 0; i < h.numLoans; ++i) {
+        const LoanRecord &lr = loans[i];
+        unique_ptr<Item> item = view.decode(lr.item);
+        string person, dueDate;
+        if (!item || !view.str(lr.person, person) || !view.str(lr.dueDate, dueDate)) {
+            cerr << "Error: Snapshot loan record " << i << " is corrupt.\n";
+            return false;
+        }
+        Result<void> restored = fresh.restoreCheckedOut(move(item), lr.item.shelf,
+                                                        lr.item.comp, move(person),
+                                                        move(dueDate));
+        if (!restored) {
+            cerr << "Error: Snapshot loan record " << i << ": "
+                 << storageErrorName(restored.error()) << ".\n";
+            return false;
+        }
+    }
+
+    // holds() writes each pickup before the queue of the same item, and
+    // each queue in order, so restoring in file order rebuilds them.
+    for (uint64_t i = 0; i < h.numHolds; ++i) {
+        const HoldRecord &hr = holds[i];
+        string person;
+        if (!view.str(hr.person, person)) {
+            cerr << "Error: Snapshot hold record " << i << " is corrupt.\n";
+            return false;
+        }
+        Result<void> restored = fresh.restoreHold(hr.shelf, hr.comp, move(person),
+                                                  hr.position == 0);
+        if (!restored) {
+            cerr << "Error: Snapshot hold record " << i << ": "
+                 << storageErrorName(restored.error()) << ".\n";
+            return false;
+        }
+    }
+
+    lib = move(fresh);
+    if (journalSeq) *journalSeq = h.journalSeq;
+    return true;
+}
@@ -0,0 +1,45 @@
+#pragma once
+#include "LibraryStorage.h"
+#include <string>
+
+/*
+ * File: Snapshot.h
+ * ----------------
+ * Versioned binary snapshot of a LibraryStorage: shelves, stored items
+ * (Book, Movie, Magazine), checked-out records and holds. Every string is
+ * written once into a shared string table and referenced by index, so
+ * records are fixed-size. Loading maps the file into memory and rebuilds
+ * the storage directly from the records; no text is parsed.
+ *
+ * File layout (native byte order)
+ * ----------------------------------------------------------------------
+ * SnapshotHeader                      | magic, version, counts, offsets
+ * uint32_t[numShelves], padded to 8   | compartments per shelf
+ * ItemRecord[numItems]                | items stored in compartments
+ * LoanRecord[numLoans]                | checked-out items
+ * HoldRecord[numHolds]                | pickups and queued holds, in order
+ * uint32_t[numActorRefs]              | string ids of Movie actors
+ * uint64_t[numStrings + 1]            | string start offsets (+ end)
+ * char[stringBytes]                   | string data, not NUL-terminated
+ *
+ * Data Table (identifier | datatype | use)
+ * ----------------------------------------------------------------------
+ * SNAPSHOT_VERSION | constexpr uint32_t | Current format version
+ * journalSeq       | uint64_t           | Last journal frame the snapshot covers
+ *
+ */
+
+constexpr uint32_t SNAPSHOT_VERSION = 4;
+
+// Write lib to path. The file is written next to path, fsynced, renamed
+// into place and the directory fsynced, so after a crash path holds either
+// the old snapshot or the new one, never a half-written file. journalSeq
+// is the last journal frame already reflected in lib (see Journal.h).
+bool saveSnapshot(const LibraryStorage &lib, const std::string &path,
+                  uint64_t journalSeq = 0);
+
+// Replace the contents of lib with the snapshot at path. On failure lib
+// is left unchanged. If journalSeq is given it receives the value passed
+// to saveSnapshot.
+bool loadSnapshot(const std::string &path, LibraryStorage &lib,
+                  uint64_t *journalSeq = nullptr);
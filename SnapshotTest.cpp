@@ -0,0 +1,164 @@
+#include "Snapshot.h"
+#include "TestCheck.h"
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <unistd.h>
+
+using namespace std;
+
+/*
+ * File: SnapshotTest.cpp
+ * ----------------------
+ * LibraryCheckout_snapshot_test: save/load round trips through
+ * saveSnapshot and loadSnapshot (run by ctest). A storage with shelves of
+ * several capacities, every item type, loans, a pickup and queued holds is
+ * saved and loaded into a fresh storage, and the two are compared through
+ * a text dump of everything a snapshot is meant to keep. Damaged files
+ * must be refused without touching the storage they were loaded into.
+ *
+ * Data Table (identifier | datatype | use)
+ * ----------------------------------------------------------------------
+ * dir      | std::filesystem::path | Scratch directory for snapshot files
+ *
+ */
+
+namespace {
+
+// A storage with something of everything a snapshot records.
+LibraryStorage sampleLibrary() {
+    LibraryStorage lib(2);
+    CHECK(lib.addShelf(64));
+    CHECK(lib.addShelf(1));
+    CHECK(lib.addItem(make_unique<Book>("Dune", "Desert planet", 1, "Dune", "Frank Herbert",
+                                        "1965"),
+                      0, 0));
+    CHECK(lib.addItem(make_unique<Movie>("Alien", "", 2, "Alien", "Ridley Scott",
+                                         vector<string>{"Sigourney Weaver", "Tom Skerritt"}),
+                      2, 63));
+    CHECK(lib.addItem(make_unique<Magazine>("Wired", "Tech, \"quoted\"\nand multi-line", 3,
+                                            "Vol. 7", "Cover story"),
+                      3, 0));
+    CHECK(lib.addItem(make_unique<Book>("Emma", "Novel", 4, "Emma", "Jane Austen", "1815"), 1,
+                      14));
+    CHECK(lib.addItem(make_unique<Movie>("Heat", "Heist", 5, "Heat", "Michael Mann",
+                                         vector<string>{}),
+                      0, 7));
+    // Ids are not unique in the storage; both copies must survive.
+    CHECK(lib.addItem(make_unique<Book>("Dune", "Second copy", 1, "Dune", "Frank Herbert",
+                                        "1965"),
+                      2, 0));
+
+    CHECK(lib.checkoutItem(1, 14, "Ann Reader", "2026-03-01"));
+    CHECK(lib.checkoutItem(0, 7, "Bob", "not a date"));
+    // Emma comes back to a pickup for Cy, with Dee still waiting; Heat
+    // stays out with a queue of two.
+    CHECK(lib.placeHold(1, 14, "Cy"));
+    CHECK(lib.placeHold(1, 14, "Dee"));
+    CHECK(lib.checkinItem(1, 14));
+    CHECK(lib.placeHold(0, 7, "Dee"));
+    CHECK(lib.placeHold(0, 7, "Ann Reader"));
+    CHECK(lib.holds().size() == 4);
+    return lib;
+}
+
+void testRoundTrip(const filesystem::path &dir) {
+    LibraryStorage original = sampleLibrary();
+    string path = (dir / "round.snap").string();
+    CHECK(saveSnapshot(original, path, 42));
+    CHECK(!filesystem::exists(path + ".tmp"));
+
+    LibraryStorage loaded(0);
+    uint64_t seq = 0;
+    CHECK(loadSnapshot(path, loaded, &seq));
+    CHECK(seq == 42);
+    CHECK(dumpStorage(loaded) == dumpStorage(original));
+    CHECK(loaded.pickupFor(1, 14) == "Cy");
+    CHECK(loaded.holdCount(0, 7) == 2);
+    CHECK(loaded.loanCount("Ann Reader") == 0 && loaded.loanCount("Bob") == 1);
+
+    // Saving what was loaded reproduces the same contents.
+    string again = (dir / "again.snap").string();
+    CHECK(saveSnapshot(loaded, again));
+    LibraryStorage reloaded(0);
+    CHECK(loadSnapshot(again, reloaded));
+    CHECK(dumpStorage(reloaded) == dumpStorage(original));
+
+    // The loaded storage behaves like the original: the pickup is honoured.
+    CHECK(!loaded.checkoutItem(1, 14, "Dee", ""));
+    CHECK(loaded.checkoutItem(1, 14, "Cy", ""));
+}
+
+void testEmpty(const filesystem::path &dir) {
+    LibraryStorage empty(0);
+    string path = (dir / "empty.snap").string();
+    CHECK(saveSnapshot(empty, path));
+    LibraryStorage loaded(5);
+    CHECK(loadSnapshot(path, loaded));
+    CHECK(loaded.numShelves() == 0);
+    CHECK(dumpStorage(loaded) == dumpStorage(empty));
+}
+
+void testReplace(const filesystem::path &dir) {
+    string path = (dir / "replace.snap").string();
+    LibraryStorage first = sampleLibrary();
+    CHECK(saveSnapshot(first, path, 1));
+    LibraryStorage second(1);
+    CHECK(saveSnapshot(second, path, 2));
+    LibraryStorage loaded(0);
+    uint64_t seq = 0;
+    CHECK(loadSnapshot(path, loaded, &seq));
+    CHECK(seq == 2 && dumpStorage(loaded) == dumpStorage(second));
+}
+
+// A refused load must leave the target exactly as it was.
+void expectRefused(const string &path) {
+    LibraryStorage target = sampleLibrary();
+    string before = dumpStorage(target);
+    CHECK(!loadSnapshot(path, target));
+    CHECK(dumpStorage(target) == before);
+}
+
+void testDamaged(const filesystem::path &dir) {
+    string good = (dir / "good.snap").string();
+    LibraryStorage lib = sampleLibrary();
+    CHECK(saveSnapshot(lib, good));
+    auto size = filesystem::file_size(good);
+
+    expectRefused((dir / "missing.snap").string());
+
+    for (auto cut : {uintmax_t{0}, uintmax_t{7}, size / 2, size - 1}) {
+        string path = (dir / ("cut" + to_string(cut) + ".snap")).string();
+        filesystem::copy_file(good, path, filesystem::copy_options::overwrite_existing);
+        filesystem::resize_file(path, cut);
+        expectRefused(path);
+    }
+
+    // Bad magic, then a version from the future.
+    for (size_t offset : {size_t{0}, size_t{8}}) {
+        string path = (dir / ("patched" + to_string(offset) + ".snap")).string();
+        filesystem::copy_file(good, path, filesystem::copy_options::overwrite_existing);
+        fstream f(path, ios::in | ios::out | ios::binary);
+        f.seekp(static_cast<streamoff>(offset));
+        f.put('\x7f');
+        f.close();
+        expectRefused(path);
+    }
+}
+
+} // namespace
+
+int main() {
+    filesystem::path dir =
+        filesystem::temp_directory_path() / ("snapshot_test_" + to_string(getpid()));
+    filesystem::create_directories(dir);
+
+    testRoundTrip(dir);
+    testEmpty(dir);
+    testReplace(dir);
+    testDamaged(dir);
+
+    filesystem::remove_all(dir);
+    return testSummary("snapshot");
+}
@@ -0,0 +1,121 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string_view>
+#include <utility>
+#include <variant>
+
+/*
+ * File: StorageError.h
+ * --------------------
+ * Why a LibraryStorage or ConcurrentLibraryStorage operation was refused,
+ * and Result<T>, the value-or-error type those operations return in
+ * place of a bare bool. Nothing is printed and nothing is thrown on a
+ * refusal: the caller gets the code and decides whether, and how, to
+ * report it (storageErrorName gives a short English name).
+ *
+ * Result<T> is modelled on C++23 std::expected<T, StorageError>: it
+ * converts to true on success, *r is the value and r.error() the code.
+ * Result<void> carries no value. A different error type can be given as
+ * the second argument (commit reports the failing transaction step).
+ *
+ * Data Table (identifier | datatype | use)
+ * ----------------------------------------------------------------------
+ * StorageError | enum class          | Reason an operation was refused
+ * Result       | class template      | Value of type T or an error of type E
+ * v            | std::variant<T, E>  | The value (index 0) or the error (index 1)
+ * err          | std::optional<E>    | Result<void>: the error, if any
+ *
+ */
+
+enum class StorageError : uint8_t {
+    NoSuchShelf,
+    NoSuchCompartment,
+    Occupied,
+    Empty,
+    AlreadyCheckedOut,
+    NotCheckedOut,
+    LoanLimit,
+    StorageFull,
+    InvalidArgument,
+    HeldForOther,     // the item is waiting for another patron's pickup
+    HoldExists,
+    NoSuchHold,
+    RowsRejected,     // addItems: at least one row of the batch
+    TransactionStep,  // commit: a step would fail
+};
+
+constexpr size_t NUM_STORAGE_ERRORS = static_cast<size_t>(StorageError::TransactionStep) + 1;
+
+constexpr std::string_view storageErrorName(StorageError error) {
+    switch (error) {
+        case StorageError::NoSuchShelf:
+            return "no such shelf";
+        case StorageError::NoSuchCompartment:
+            return "no such compartment";
+        case StorageError::Occupied:
+            return "compartment is not free";
+        case StorageError::Empty:
+            return "compartment is empty";
+        case StorageError::AlreadyCheckedOut:
+            return "already checked out";
+        case StorageError::NotCheckedOut:
+            return "not checked out";
+        case StorageError::LoanLimit:
+            return "loan limit reached";
+        case StorageError::StorageFull:
+            return "no free compartment left";
+        case StorageError::InvalidArgument:
+            return "invalid argument";
+        case StorageError::HeldForOther:
+            return "held for another patron";
+        case StorageError::HoldExists:
+            return "already on hold for patron";
+        case StorageError::NoSuchHold:
+            return "no such hold";
+        case StorageError::RowsRejected:
+            return "rows rejected";
+        case StorageError::TransactionStep:
+            return "step would fail";
+    }
+    return "?";
+}
+
+// T must not be constructible from E, so that Result(value) and
+// Result(error) never compete.
+template <typename T, typename E = StorageError>
+class [[nodiscard]] Result {
+    std::variant<T, E> v;
+
+public:
+    Result(T value) : v(std::in_place_index<0>, std::move(value)) {}
+    Result(E error) : v(std::in_place_index<1>, std::move(error)) {}
+
+    bool ok() const noexcept { return v.index() == 0; }
+    explicit operator bool() const noexcept { return ok(); }
+
+    // Only valid if ok().
+    T &operator*() noexcept { return *std::get_if<0>(&v); }
+    const T &operator*() const noexcept { return *std::get_if<0>(&v); }
+    T *operator->() noexcept { return std::get_if<0>(&v); }
+    const T *operator->() const noexcept { return std::get_if<0>(&v); }
+
+    // Only valid if !ok().
+    const E &error() const noexcept { return *std::get_if<1>(&v); }
+};
+
+template <typename E>
+class [[nodiscard]] Result<void, E> {
+    std::optional<E> err;
+
+public:
+    Result() = default;
+    Result(E error) : err(std::move(error)) {}
+
+    bool ok() const noexcept { return !err; }
+    explicit operator bool() const noexcept { return ok(); }
+
+    // Only valid if !ok().
+    const E &error() const noexcept { return *err; }
+};
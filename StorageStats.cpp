@@ -0,0 +1,243 @@
+#include "StorageStats.h"
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+/*
+ * File: StorageStats.cpp
+ * ----------------------
+ * Implements the counters declared in StorageStats.h. Each thread gets a
+ * cache-line-aligned block of atomics on its first recorded call; blocks
+ * are kept (and handed to new threads) after their thread exits, so no
+ * count is ever lost.
+ */
+
+namespace {
+
+// Only the owning thread writes a counter, so a relaxed load and store
+// is enough; readers see each counter as some recent value.
+void bump(atomic<uint64_t> &counter, uint64_t by = 1) {
+    counter.store(counter.load(memory_order_relaxed) + by, memory_order_relaxed);
+}
+
+struct OpCounters {
+    atomic<uint64_t> ok{0};
+    array<atomic<uint64_t>, NUM_STORAGE_ERRORS> failed{};
+    atomic<uint64_t> totalNs{0};
+    atomic<uint64_t> maxNs{0};
+    array<atomic<uint64_t>, LatencyHistogram::BUCKETS> buckets{};
+};
+
+struct alignas(64) ThreadBlock {
+    array<OpCounters, NUM_STORAGE_OPS> ops;
+    atomic<bool> used{false};  // recorded at least one call
+};
+
+mutex registryMutex;
+vector<unique_ptr<ThreadBlock>> blocks;  // guarded by registryMutex
+vector<ThreadBlock *> freeBlocks;       // blocks of exited threads
+
+// The calling thread's block; returned to freeBlocks when it exits.
+struct LocalBlock {
+    ThreadBlock *block;
+
+    LocalBlock() {
+        lock_guard lock(registryMutex);
+        if (!freeBlocks.empty()) {
+            block = freeBlocks.back();
+            freeBlocks.pop_back();
+        } else {
+            blocks.push_back(make_unique<ThreadBlock>());
+            block = blocks.back().get();
+        }
+    }
+    ~LocalBlock() {
+        lock_guard lock(registryMutex);
+        freeBlocks.push_back(block);
+    }
+};
+
+ThreadBlock &localBlock() {
+    thread_local LocalBlock local;
+    return *local.block;
+}
+
+} // namespace
+
+string_view storageOpName(StorageOp op) {
+    switch (op) {
+        case StorageOp::AddItem:
+            return "addItem";
+        case StorageOp::AddItemAnywhere:
+            return "addItemAnywhere";
+        case StorageOp::AddItems:
+            return "addItems";
+        case StorageOp::RemoveItem:
+            return "removeItem";
+        case StorageOp::CheckoutItem:
+            return "checkoutItem";
+        case StorageOp::CheckinItem:
+            return "checkinItem";
+        case StorageOp::RestoreCheckedOut:
+            return "restoreCheckedOut";
+        case StorageOp::SwapItems:
+            return "swapItems";
+        case StorageOp::MoveItem:
+            return "moveItem";
+        case StorageOp::Commit:
+            return "commit";
+        case StorageOp::PlaceHold:
+            return "placeHold";
+        case StorageOp::CancelHold:
+            return "cancelHold";
+        case StorageOp::AddShelf:
+            return "addShelf";
+        case StorageOp::ReserveShelves:
+            return "reserveShelves";
+    }
+    return "?";
+}
+
+// ===== LatencyHistogram =====
+
+size_t LatencyHistogram::bucketOf(uint64_t ns) {
+    // Values below 2 * SUB_BUCKETS get a bucket each; above that, the
+    // top SUB_BITS + 1 bits select the bucket.
+    if (ns < 2 * SUB_BUCKETS) return static_cast<size_t>(ns);
+    unsigned shift = static_cast<unsigned>(bit_width(ns)) - SUB_BITS - 1;
+    if (shift > MAX_SHIFT) return BUCKETS - 1;
+    return shift * SUB_BUCKETS + static_cast<size_t>(ns >> shift);
+}
+
+uint64_t LatencyHistogram::bucketHigh(size_t idx) {
+    if (idx < 2 * SUB_BUCKETS) return idx;
+    unsigned shift = static_cast<unsigned>(idx / SUB_BUCKETS) - 1;
+    uint64_t low = static_cast<uint64_t>(idx - shift * SUB_BUCKETS) << shift;
+    return low + (uint64_t{1} << shift) - 1;
+}
+
+void LatencyHistogram::add(size_t bucket, uint64_t n) {
+    counts[bucket] += n;
+    total += n;
+}
+
+void LatencyHistogram::record(uint64_t ns) { add(bucketOf(ns), 1); }
+
+void LatencyHistogram::merge(const LatencyHistogram &other) {
+    for (size_t i = 0; i < BUCKETS; ++i) counts[i] += other.counts[i];
+    total += other.total;
+}
+
+uint64_t LatencyHistogram::count() const { return total; }
+
+uint64_t LatencyHistogram::quantile(double q) const {
+    if (total == 0) return 0;
+    uint64_t rank = static_cast<uint64_t>(clamp(q, 0.0, 1.0) * static_cast<double>(total));
+    rank = max<uint64_t>(rank, 1);
+    uint64_t seen = 0;
+    for (size_t i = 0; i < BUCKETS; ++i) {
+        seen += counts[i];
+        if (seen >= rank) return bucketHigh(i);
+    }
+    return bucketHigh(BUCKETS - 1);
+}
+
+const array<uint64_t, LatencyHistogram::BUCKETS> &LatencyHistogram::buckets() const {
+    return counts;
+}
+
+// ===== OpStats / StorageStatsSnapshot =====
+
+uint64_t OpStats::failures() const {
+    uint64_t n = 0;
+    for (uint64_t f : failed) n += f;
+    return n;
+}
+
+uint64_t OpStats::calls() const { return ok + failures(); }
+
+const OpStats &StorageStatsSnapshot::operator[](StorageOp op) const {
+    return ops[static_cast<size_t>(op)];
+}
+
+void recordStorageOp(StorageOp op, int reason, uint64_t ns) {
+    ThreadBlock &block = localBlock();
+    OpCounters &c = block.ops[static_cast<size_t>(op)];
+    if (reason < 0) {
+        bump(c.ok);
+    } else {
+        bump(c.failed[static_cast<size_t>(reason)]);
+    }
+    bump(c.totalNs, ns);
+    if (ns > c.maxNs.load(memory_order_relaxed)) c.maxNs.store(ns, memory_order_relaxed);
+    bump(c.buckets[LatencyHistogram::bucketOf(ns)]);
+    if (!block.used.load(memory_order_relaxed)) block.used.store(true, memory_order_relaxed);
+}
+
+StorageStatsSnapshot collectStorageStats() {
+    StorageStatsSnapshot snap;
+#ifdef LIBRARY_INSTRUMENTATION
+    snap.enabled = true;
+#endif
+    lock_guard lock(registryMutex);
+    for (const auto &block : blocks) {
+        if (!block->used.load(memory_order_relaxed)) continue;
+        ++snap.threads;
+        for (size_t op = 0; op < NUM_STORAGE_OPS; ++op) {
+            const OpCounters &c = block->ops[op];
+            OpStats &s = snap.ops[op];
+            s.ok += c.ok.load(memory_order_relaxed);
+            for (size_t r = 0; r < NUM_STORAGE_ERRORS; ++r) {
+                s.failed[r] += c.failed[r].load(memory_order_relaxed);
+            }
+            s.totalNs += c.totalNs.load(memory_order_relaxed);
+            s.maxNs = max(s.maxNs, c.maxNs.load(memory_order_relaxed));
+            for (size_t b = 0; b < LatencyHistogram::BUCKETS; ++b) {
+                uint64_t n = c.buckets[b].load(memory_order_relaxed);
+                if (n) s.latency.add(b, n);
+            }
+        }
+    }
+    return snap;
+}
+
+void writeStorageStats(ostream &os, const StorageStatsSnapshot &stats, string_view indent) {
+    if (!stats.enabled) {
+        os << indent << "Operation statistics are not compiled in"
+           << " (build with LIBRARY_INSTRUMENTATION).\n";
+        return;
+    }
+    bool any = false;
+    for (size_t op = 0; op < NUM_STORAGE_OPS; ++op) {
+        const OpStats &s = stats.ops[op];
+        uint64_t calls = s.calls();
+        if (calls == 0) continue;
+        any = true;
+        const LatencyHistogram &h = s.latency;
+        string name(storageOpName(static_cast<StorageOp>(op)));
+        name.resize(max<size_t>(name.size(), 17), ' ');
+        os << indent << name << " ok " << s.ok << ", failed " << s.failures();
+        if (s.failures() > 0) {
+            os << " (";
+            bool first = true;
+            for (size_t r = 0; r < NUM_STORAGE_ERRORS; ++r) {
+                if (s.failed[r] == 0) continue;
+                os << (first ? "" : ", ") << storageErrorName(static_cast<StorageError>(r)) << " "
+                   << s.failed[r];
+                first = false;
+            }
+            os << ")";
+        }
+        // A bucket's upper edge can lie above the largest value seen.
+        auto q = [&](double p) { return min(h.quantile(p), s.maxNs); };
+        os << "; ns mean " << s.totalNs / calls << " p50 " << q(0.50) << " p90 " << q(0.90)
+           << " p99 " << q(0.99) << " p99.9 " << q(0.999) << " max " << s.maxNs << "\n";
+    }
+    if (!any) os << indent << "No storage operations recorded yet.\n";
+}
@@ -0,0 +1,394 @@
+#include "CatalogLoader.h"
+#include "CommandProcessor.h"
+#include "Journal.h"
+#include "LibraryStorage.h"
+#include "TestCheck.h"
+#include <csignal>
+#include <filesystem>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <sys/resource.h>
+#include <unistd.h>
+
+using namespace std;
+
+/*
+ * File: StorageTest.cpp
+ * ---------------------
+ * LibraryCheckout_storage_test: behaviour checks for LibraryStorage, the
+ * catalog loader and the command interpreter in front of it (run by
+ * ctest). Each test builds a small storage, drives it through the public
+ * operations, a catalog or CommandProcessor::execute as a batch or
+ * network client would, and checks the replies and the state left behind.
+ *
+ * Data Table (identifier | datatype | use)
+ * ----------------------------------------------------------------------
+ * FAR     | size_t      | An index no storage has: 2^32 - 1
+ * CATALOG | const char* | Catalog text mixing good rows with malformed ones
+ * BATCH   | const char* | Command file with comments, a refusal and an open begin
+ *
+ */
+
+namespace {
+
+constexpr size_t FAR = 0xffffffffu;
+
+// Lines 2, 8 and 10 are good; every other data row must be refused.
+const char *CATALOG = "type,shelf,comp,id,name,description,title,author,copyright\n"
+                      "book,0,0,1,Dune,Desert,Dune,Herbert,1965\n"
+                      "book,0,x,2,Emma,Novel,Emma,Austen,1815\n"
+                      "movie,0,1,3,Heat,Heist,Heat,Mann\n"
+                      "# a comment\n"
+                      "scroll,0,2,4,Scroll,Old,Scroll,Anon,100\n"
+                      "magazine,0,0,5,Wired,,Vol. 7,Cover\n"
+                      "book,0,3,\"8\",\"Dune, Messiah\",\"A \"\"sequel\"\"\",Dune,Herbert,1969\n"
+                      "book,9,0,6,Far,Away,Far,Away,2000\n"
+                      "magazine,*,0,7,Wired,,Vol. 8,Cover\n"
+                      "book,0,2,zero,Bad,Id,Bad,Id,2000\n";
+
+const char *BATCH = "# opening the desk\n"
+                    "add book 0 0 1 Dune Desert Dune Herbert 1965\n"
+                    "\n"
+                    "checkout 0 0 Ann 2026-01-01\n"
+                    "checkout 0 0 Bob 2026-01-01\n"
+                    "add book 0 1 2 \"Dune Messiah\" \"\" Messiah Herbert 1969\n"
+                    "find 2\n"
+                    "begin\n"
+                    "add book 0 2 3 Emma Novel Emma Austen 1815\n";
+
+unique_ptr<Item> book(int id, string title = "Title") {
+    return make_unique<Book>("Book " + to_string(id), "", id, move(title), "Author", "2000");
+}
+
+// Run one command line and return its reply.
+string run(CommandProcessor &cmd, string_view line) {
+    string out;
+    cmd.execute(line, out);
+    return out;
+}
+
+// A checkin at a location the storage does not have is refused, whether
+// it is past the shelves or aliases a real compartment in its low bits.
+void testCheckinOutOfRange() {
+    LibraryStorage empty(0);
+    CHECK(empty.checkinItem(FAR, FAR).error() == StorageError::NoSuchShelf);
+    CommandProcessor onEmpty(empty);
+    CHECK(run(onEmpty, "checkin 4294967295 4294967295") == "error: invalid location\n");
+    CHECK(run(onEmpty, "checkin 4294967294 4294967294") == "error: no such shelf\n");
+
+    LibraryStorage lib(1);
+    CommandProcessor cmd(lib);
+    CHECK(run(cmd, "add book 0 1 7 Dune Desert Dune Herbert 1965") == "ok\n");
+    CHECK(run(cmd, "checkout 0 1 Alice 2025-01-01") == "ok\n");
+    CHECK(run(cmd, "checkin 0 4294967297") == "error: invalid location\n");
+    CHECK(run(cmd, "checkin 0 64") == "error: no such compartment\n");
+    CHECK(lib.checkinItem(0, (size_t{1} << 32) + 1).error() == StorageError::NoSuchCompartment);
+    CHECK(lib.checkinItem(FAR + 1, 1).error() == StorageError::NoSuchShelf);
+    CHECK(lib.loanCount("Alice") == 1);
+    CHECK(run(cmd, "checkin 0 1") == "ok\n");
+}
+
+// Indices past 32 bits must not reach a real location through the packed
+// loan-index key, in any operation that takes a location.
+void testLocationKeys() {
+    CHECK(LoanIndex::makeKey(LoanIndex::MAX_INDEX, LoanIndex::MAX_INDEX) != LoanIndex::EMPTY);
+    CHECK(LoanIndex::makeKey(0, 1) != LoanIndex::makeKey(1, 0));
+
+    LibraryStorage lib(1);
+    CHECK(lib.addItem(book(1), 0, 1));
+    CHECK(lib.addItem(book(2), 0, 2));
+    CHECK(lib.checkoutItem(0, 1, "Ann", ""));
+    CHECK(lib.placeHold(0, 1, "Bob"));
+    size_t alias = (size_t{1} << 32) + 1;  // (0, alias) packs like (0, 1) did
+    CHECK(lib.checkoutItem(0, alias, "Cy", "").error() == StorageError::NoSuchCompartment);
+    CHECK(lib.placeHold(0, alias, "Cy").error() == StorageError::NoSuchCompartment);
+    CHECK(lib.cancelHold(0, alias, "Bob").error() == StorageError::NoSuchCompartment);
+    CHECK(!lib.pickupFor(0, alias) && lib.holdCount(0, alias) == 0);
+    CHECK(lib.holdCount(0, 1) == 1);
+    CHECK(lib.moveItem(0, 2, 0, alias).error() == StorageError::NoSuchCompartment);
+    CHECK(lib.swapItems(0, 2, FAR, FAR).error() == StorageError::NoSuchShelf);
+
+    // A step at the alias of a compartment an earlier step touched must not
+    // be checked against that compartment's state.
+    LibraryStorage::Transaction tx;
+    tx.moveItem(0, 2, 0, 3);
+    tx.checkoutItem(0, (size_t{1} << 32) + 3, "Cy", "");
+    CHECK(!lib.commit(tx));
+    tx.clear();
+    tx.checkinItem(FAR + 1, FAR + 1);
+    CHECK(!lib.commit(tx));
+    CHECK(lib.loanCount("Ann") == 1 && lib.findById(2)->comp == 2);
+}
+
+// Malformed rows are reported with their line number and leave nothing
+// behind; the good rows around them load, whatever the batch size.
+void testCatalogRows() {
+    LibraryStorage lib(1);
+    istringstream in(CATALOG);
+    LoadResult r = loadCatalog(in, lib, 65536, 4);
+    CHECK(r.rowsRead == 9 && r.rowsLoaded == 3);
+    vector<size_t> rows;
+    for (const IngestError &e : r.errors) rows.push_back(e.row);
+    CHECK((rows == vector<size_t>{3, 4, 6, 7, 9, 11}));
+    CHECK(r.errors.size() == 6 && r.errors[0].message == "Invalid compartment index \"x\"");
+    CHECK(r.errors[3].message == "Compartment 0 on shelf 0 is used by an earlier row");
+    for (int id : {2, 3, 4, 5, 6}) CHECK(!lib.findById(id));
+    CHECK(lib.numShelves() == 1);
+    CHECK(lib.findById(1)->comp == 0 && lib.findById(8)->comp == 3);
+    CHECK(lib.findById(8)->item->getName() == "Dune, Messiah");
+    CHECK(lib.findById(7) && lib.findById(7)->comp == 1);
+
+    LibraryStorage small(1);
+    istringstream again(CATALOG);
+    LoadResult r2 = loadCatalog(again, small, 2, 4);
+    CHECK(r2.rowsLoaded == 3 && r2.errors.size() == 6);
+    CHECK(dumpStorage(small) == dumpStorage(lib));
+}
+
+// Search finds items holding every query word, best BM25 score first,
+// follows adds, removals and loans, and the block bounds it skips with
+// never drop a result the full ranking keeps.
+void testRankedSearch() {
+    LibraryStorage lib(1);
+    CHECK(lib.addItem(make_unique<Book>("Dune", "", 1, "Dune", "Herbert", "1965"), 0, 0));
+    CHECK(lib.addItem(make_unique<Book>("Messiah", "The Dune sequel: a long journey across "
+                                        "the desert, again",
+                                        2, "Messiah", "Herbert", "1969"),
+                      0, 1));
+    CHECK(lib.addItem(make_unique<Book>("Emma", "", 3, "Emma", "Austen", "1815"), 0, 2));
+    CHECK(lib.search("dune").empty());  // not enabled yet
+
+    lib.enableSearch();
+    vector<SearchResult> hits = lib.search("DUNE herbert");
+    CHECK(hits.size() == 2 && hits[0].location.item->getId() == 1
+          && hits[1].location.item->getId() == 2 && hits[0].score > hits[1].score);
+    CHECK(lib.search("dune austen").empty());
+    CHECK(lib.search("dune", 1).size() == 1);
+
+    CHECK(lib.checkoutItem(0, 1, "Ann", ""));
+    CHECK(lib.addItem(make_unique<Magazine>("Dune", "", 4, "Dune", "Dune"), 0, 3));
+    CHECK(lib.removeItem(0, 0));
+    hits = lib.search("dune");
+    CHECK(hits.size() == 2 && hits[0].location.item->getId() == 4);
+    CHECK(hits[1].location.item->getId() == 2 && hits[1].location.person == "Ann");
+    CommandProcessor cmd(lib);
+    CHECK(run(cmd, "search dune herbert").rfind("ok 1\n  0 1 ", 0) == 0);
+
+    // Enough documents for several posting blocks, with scores spread out.
+    lib.reserveShelves(21);
+    for (int i = 0; i < 300; ++i) {
+        string description;
+        for (int w = 0; w <= i % 7; ++w) description += "common ";
+        for (int w = 0; w < i % 5; ++w) description += "filler ";
+        CHECK(lib.addItem(make_unique<Book>("Item", description, 100 + i, "T", "A", ""),
+                          1 + static_cast<size_t>(i) / 15, static_cast<size_t>(i) % 15));
+    }
+    vector<SearchResult> all = lib.search("common", 1000);
+    vector<SearchResult> best = lib.search("common", 10);
+    CHECK(all.size() == 300 && best.size() == 10);
+    for (size_t i = 1; i < all.size(); ++i) CHECK(all[i - 1].score >= all[i].score);
+    for (size_t i = 0; i < best.size(); ++i) CHECK(best[i].score == all[i].score);
+}
+
+// A checkout that would take a patron past the loan limit is refused and
+// changes nothing; other patrons and returned loans are not affected.
+void testLoanLimit() {
+    LibraryStorage lib(1);
+    for (int id = 1; id <= 5; ++id) CHECK(lib.addItem(book(id), 0, static_cast<size_t>(id - 1)));
+    lib.setLoanLimit(2);
+    CHECK(lib.getLoanLimit() == 2);
+    CHECK(lib.checkoutItem(0, 0, "Ann", ""));
+    CHECK(lib.checkoutItem(0, 1, "Ann", ""));
+    CHECK(lib.checkoutItem(0, 2, "Ann", "").error() == StorageError::LoanLimit);
+    CHECK(lib.loanCount("Ann") == 2 && !lib.findById(3)->checkedOut);
+    CommandProcessor cmd(lib);
+    CHECK(run(cmd, "checkout 0 2 Ann 2026-01-01") == "error: loan limit reached\n");
+    CHECK(run(cmd, "checkout 0 2 Bob 2026-01-01") == "ok\n");
+
+    // In a transaction the limit counts the loans earlier steps return.
+    LibraryStorage::Transaction tx;
+    tx.checkoutItem(0, 3, "Ann", "");
+    CHECK(!lib.commit(tx) && lib.loanCount("Ann") == 2);
+    tx.clear();
+    tx.checkinItem(0, 0).checkoutItem(0, 3, "Ann", "");
+    CHECK(lib.commit(tx) && lib.loanCount("Ann") == 2 && lib.findById(4)->checkedOut);
+
+    // Loans read back from saved state are not checked.
+    CHECK(lib.restoreCheckedOut(book(9), 0, 9, "Ann", ""));
+    CHECK(lib.loanCount("Ann") == 3);
+    CHECK(lib.checkinItem(0, 1));
+    CHECK(lib.checkoutItem(0, 4, "Ann", "").error() == StorageError::LoanLimit);
+    CHECK(lib.checkinItem(0, 9) && lib.checkoutItem(0, 4, "Ann", ""));
+    CHECK(lib.loanCount("Ann") == 2 && lib.loansOf("Ann").size() == 2);
+}
+
+// Steps that would all succeed on their own, each depending on an
+// earlier one. Appended to a failing step, none of them may show.
+void addGoodSteps(LibraryStorage::Transaction &tx) {
+    tx.addItem(book(10), 1, 0)
+        .moveItem(0, 0, 1, 1)
+        .checkoutItem(1, 1, "Cy", "2026-05-01")
+        .removeItem(0, 2)
+        .checkinItem(0, 1);
+}
+
+// A transaction whose last step fails leaves the storage, the journal and
+// its own items as they were; the same steps without it all apply.
+void testTransactionRollback() {
+    string path = (filesystem::temp_directory_path()
+                   / ("storage_test_" + to_string(getpid()) + ".journal"))
+                      .string();
+    LibraryStorage lib(2);
+    for (int id = 1; id <= 3; ++id) CHECK(lib.addItem(book(id), 0, static_cast<size_t>(id - 1)));
+    CHECK(lib.checkoutItem(0, 1, "Ann", ""));
+    CHECK(lib.placeHold(0, 1, "Bob"));
+    Journal journal;
+    CHECK(journal.open(path, 0, 0));
+    lib.attachJournal(&journal);
+    string before = dumpStorage(lib);
+
+    LibraryStorage::Transaction tx;
+    addGoodSteps(tx);
+    tx.moveItem(0, 2, 1, 2);  // removed by step 3
+    Result<void, IngestError> done = lib.commit(tx);
+    CHECK(!done && done.error().row == 5);
+    CHECK(dumpStorage(lib) == before);
+    CHECK(journal.lastSeq() == 0 && journal.pending() == 0);
+    CHECK(tx.size() == 6 && tx.steps()[0].item);
+    CHECK(!lib.findById(10) && lib.loanCount("Cy") == 0 && !lib.pickupFor(0, 1));
+
+    CommandProcessor cmd(lib);
+    CHECK(run(cmd, "begin") == "ok\n");
+    CHECK(run(cmd, "add book 1 0 10 Emma Novel Emma Austen 1815") == "ok\n");
+    CHECK(run(cmd, "checkin 0 1") == "ok\n");
+    CHECK(run(cmd, "checkout 0 1 Cy 2026-05-01") == "ok\n");  // set aside for Bob
+    CHECK(run(cmd, "commit").rfind("error: step 2: ", 0) == 0);
+    CHECK(run(cmd, "commit") == "error: no transaction is open\n");
+    CHECK(dumpStorage(lib) == before && journal.lastSeq() == 0);
+
+    tx.clear();
+    addGoodSteps(tx);
+    CHECK(lib.commit(tx) && tx.empty());
+    CHECK(dumpStorage(lib) != before && journal.lastSeq() == 1);
+    CHECK(lib.findById(10) && lib.loanCount("Cy") == 1 && !lib.findById(3));
+    CHECK(lib.pickupFor(0, 1) == "Bob");
+    lib.attachJournal(nullptr);
+    journal.close();
+    filesystem::remove(path);
+}
+
+// Batch mode answers every command in order whatever the batch size,
+// skips blanks and comments, and abandons a transaction left open.
+void testBatchMode() {
+    string replies;
+    for (size_t batchSize : {size_t{4096}, size_t{2}, size_t{1}}) {
+        LibraryStorage lib(1);
+        CommandProcessor cmd(lib);
+        istringstream in(BATCH);
+        ostringstream out;
+        BatchResult r = cmd.run(in, out, batchSize);
+        CHECK(r.commands == 7 && r.failed == 1 && !r.unsynced);
+        CHECK(out.str().rfind("ok\nok\nerror: compartment is empty\nok\nok\n  0 1 ", 0) == 0);
+        CHECK(out.str().size() > 5 && out.str().substr(out.str().size() - 6) == "ok\nok\n");
+        if (replies.empty()) replies = out.str();
+        CHECK(out.str() == replies);
+        CHECK(lib.findById(2)->item->getName() == "Dune Messiah" && !lib.findById(3));
+        CHECK(lib.loanCount("Ann") == 1 && lib.loanCount("Bob") == 0);
+    }
+}
+
+// A batch whose journal sync fails is not answered, and nothing after it
+// is run.
+void testBatchSyncFailure() {
+    string path = (filesystem::temp_directory_path()
+                   / ("storage_test_" + to_string(getpid()) + ".batch.journal"))
+                      .string();
+    LibraryStorage lib(1);
+    Journal journal;
+    CHECK(journal.open(path, 0, 0));
+    lib.attachJournal(&journal);
+    CommandProcessor cmd(lib, &journal);
+
+    signal(SIGXFSZ, SIG_IGN);
+    rlimit saved{};
+    getrlimit(RLIMIT_FSIZE, &saved);
+    rlimit limit = saved;
+    limit.rlim_cur = 0;  // every journal write fails with EFBIG
+    setrlimit(RLIMIT_FSIZE, &limit);
+    istringstream in("add book 0 0 1 Dune Desert Dune Herbert 1965\n"
+                     "checkout 0 0 Ann 2026-01-01\n"
+                     "add book 0 1 2 Emma Novel Emma Austen 1815\n");
+    ostringstream out;
+    BatchResult r = cmd.run(in, out, 2);
+    setrlimit(RLIMIT_FSIZE, &saved);
+
+    CHECK(r.unsynced && r.commands == 2 && out.str().empty());
+    CHECK(!lib.findById(2));
+    lib.attachJournal(nullptr);
+    journal.close();
+    filesystem::remove(path);
+}
+
+// Who holds the location's item, pickup first, as "name:position" pairs.
+string holdList(const LibraryStorage &lib) {
+    string list;
+    for (const HoldInfo &hold : lib.holds()) {
+        list += string(hold.person) + ":" + to_string(hold.position) + " ";
+    }
+    return list;
+}
+
+// Holds are served first come, first served: a check-in sets the item
+// aside for the first holder, nobody else can take or shift it, and a
+// cancelled pickup passes to the next in line.
+void testHoldQueue() {
+    LibraryStorage lib(1);
+    CHECK(lib.addItem(book(1), 0, 0));
+    CHECK(lib.addItem(book(2), 0, 1));
+    CHECK(lib.placeHold(0, 1, "Bob").error() == StorageError::NotCheckedOut);
+    CHECK(lib.checkoutItem(0, 0, "Ann", ""));
+
+    CommandProcessor cmd(lib);
+    CHECK(run(cmd, "hold 0 0 Bob") == "ok 1\n");
+    CHECK(run(cmd, "hold 0 0 Cy") == "ok 2\n");
+    CHECK(run(cmd, "hold 0 0 Dee") == "ok 3\n");
+    CHECK(lib.placeHold(0, 0, "Bob").error() == StorageError::HoldExists);
+    CHECK(run(cmd, "unhold 0 0 Cy") == "ok\n");
+    CHECK(lib.cancelHold(0, 0, "Cy").error() == StorageError::NoSuchHold);
+    CHECK(lib.holdCount(0, 0) == 2 && holdList(lib) == "Bob:1 Dee:2 ");
+
+    CHECK(run(cmd, "checkin 0 0") == "ok for Bob\n");
+    CHECK(lib.pickupFor(0, 0) == "Bob" && lib.holdCount(0, 0) == 1);
+    CHECK(holdList(lib) == "Bob:0 Dee:1 ");
+    CHECK(run(cmd, "pickups").rfind("ok 1\n  0 0 for Bob ", 0) == 0);
+    CHECK(lib.checkoutItem(0, 0, "Dee", "").error() == StorageError::HeldForOther);
+    CHECK(lib.moveItem(0, 0, 0, 2).error() == StorageError::HeldForOther);
+    CHECK(lib.swapItems(0, 0, 0, 1).error() == StorageError::HeldForOther);
+    CHECK(lib.findById(1)->comp == 0 && !lib.findById(1)->checkedOut);
+
+    CHECK(run(cmd, "checkout 0 0 Bob 2026-02-01") == "ok\n");
+    CHECK(!lib.pickupFor(0, 0) && holdList(lib) == "Dee:1 ");
+    CHECK(run(cmd, "checkin 0 0") == "ok for Dee\n");
+    CHECK(run(cmd, "hold 0 0 Eve") == "ok 1\n");
+    CHECK(run(cmd, "unhold 0 0 Dee") == "ok\n");  // passes to Eve
+    CHECK(lib.pickupFor(0, 0) == "Eve" && lib.holdCount(0, 0) == 0);
+    CHECK(lib.cancelHold(0, 0, "Eve"));
+    CHECK(!lib.pickupFor(0, 0) && lib.holds().empty());
+    CHECK(lib.checkoutItem(0, 0, "Ann", ""));
+}
+
+} // namespace
+
+int main() {
+    testCheckinOutOfRange();
+    testLocationKeys();
+    testCatalogRows();
+    testRankedSearch();
+    testLoanLimit();
+    testTransactionRollback();
+    testBatchMode();
+    testBatchSyncFailure();
+    testHoldQueue();
+    return testSummary("storage");
+}
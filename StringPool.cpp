@@ -0,0 +1,98 @@
+#include "StringPool.h"
+#include <cstring>
+#include <mutex>
+#include <stdexcept>
+
+using namespace std;
+
+/*
+ * File: StringPool.cpp
+ * --------------------
+ * Implements the intern pool declared in StringPool.h. Text is copied
+ * into 64 KiB blocks (longer strings get a block of their own); the id
+ * table is split into chunks of CHUNK_SIZE views.
+ */
+
+string_view Symbol::str() const { return StringPool::global().resolve(*this); }
+
+ostream &operator<<(ostream &os, Symbol s) { return os << s.str(); }
+
+StringPool::StringPool() : chunks(make_unique<unique_ptr<string_view[]>[]>(MAX_CHUNKS)) {
+    chunks[0] = make_unique<string_view[]>(CHUNK_SIZE);
+    chunks[0][0] = string_view();
+    index.emplace(string_view(), 0);
+    count = 1;
+}
+
+string_view StringPool::store(string_view s) {
+    if (s.size() > blockLeft) {
+        size_t size = max(s.size(), BLOCK_BYTES);
+        blocks.push_back(make_unique<char[]>(size));
+        if (s.size() >= BLOCK_BYTES) {
+            // Oversized: keep the current block for the strings after it.
+            memcpy(blocks.back().get(), s.data(), s.size());
+            return string_view(blocks.back().get(), s.size());
+        }
+        blockPos = blocks.back().get();
+        blockLeft = size;
+    }
+    memcpy(blockPos, s.data(), s.size());
+    string_view stored(blockPos, s.size());
+    blockPos += s.size();
+    blockLeft -= s.size();
+    return stored;
+}
+
+Symbol StringPool::intern(string_view s) {
+    {
+        shared_lock lock(mutex);
+        auto it = index.find(s);
+        if (it != index.end()) return Symbol(it->second);
+    }
+
+    unique_lock lock(mutex);
+    auto it = index.find(s);
+    if (it != index.end()) return Symbol(it->second);
+
+    uint32_t id = count;
+    size_t chunk = id >> CHUNK_BITS;
+    if (chunk >= MAX_CHUNKS) throw length_error("StringPool: too many distinct strings");
+    if (!chunks[chunk]) chunks[chunk] = make_unique<string_view[]>(CHUNK_SIZE);
+
+    string_view stored = store(s);
+    chunks[chunk][id & (CHUNK_SIZE - 1)] = stored;
+    index.emplace(stored, id);
+    textBytes += s.size();
+    ++count;
+    return Symbol(id);
+}
+
+optional<Symbol> StringPool::find(string_view s) const {
+    shared_lock lock(mutex);
+    auto it = index.find(s);
+    if (it == index.end()) return nullopt;
+    return Symbol(it->second);
+}
+
+string_view StringPool::resolve(Symbol sym) const {
+    return chunks[sym.id() >> CHUNK_BITS][sym.id() & (CHUNK_SIZE - 1)];
+}
+
+size_t StringPool::size() const {
+    shared_lock lock(mutex);
+    return count;
+}
+
+size_t StringPool::memoryBytes() const {
+    shared_lock lock(mutex);
+    size_t numChunks = (count + CHUNK_SIZE - 1) >> CHUNK_BITS;
+    // Hash node: key view + id + next pointer + cached hash, roughly.
+    size_t indexBytes = index.size() * (sizeof(string_view) + 3 * sizeof(void *))
+                        + index.bucket_count() * sizeof(void *);
+    return textBytes + numChunks * CHUNK_SIZE * sizeof(string_view) + indexBytes;
+}
+
+StringPool &StringPool::global() {
+    static StringPool pool;
+    return pool;
+}
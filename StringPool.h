@@ -0,0 +1,89 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <iostream>
+#include <memory>
+#include <optional>
+#include <shared_mutex>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+/*
+ * File: StringPool.h
+ * ------------------
+ * Intern pool for strings that repeat across many items (authors,
+ * directors, actors). Each distinct string is stored once and named by a
+ * 4-byte Symbol; two symbols are equal exactly when their strings are.
+ *
+ * Interned text is immutable and lives until the pool is destroyed, so
+ * views returned by resolve() never dangle. Items use the process-wide
+ * pool, StringPool::global(). Interning is thread-safe; resolve() takes
+ * no lock.
+ *
+ * Data Table (identifier | datatype | use)
+ * ----------------------------------------------------------------------
+ * Symbol     | class                                   | Id of one interned string (0 = "")
+ * index      | std::unordered_map<string_view, uint32> | Text -> symbol id
+ * chunks     | std::unique_ptr<string_view[]>[]        | Symbol id -> text, fixed-size chunks
+ * blocks     | std::vector<std::unique_ptr<char[]>>    | Backing storage for the text
+ * mutex      | std::shared_mutex                       | Guards index, blocks, new chunks
+ *
+ */
+
+class Symbol {
+    uint32_t value = 0;
+
+public:
+    Symbol() = default;
+    explicit Symbol(uint32_t id) : value(id) {}
+
+    uint32_t id() const { return value; }
+    bool empty() const { return value == 0; }
+
+    // Text in the global pool.
+    std::string_view str() const;
+    operator std::string_view() const { return str(); }
+
+    friend bool operator==(Symbol a, Symbol b) { return a.value == b.value; }
+    friend bool operator!=(Symbol a, Symbol b) { return a.value != b.value; }
+};
+
+std::ostream &operator<<(std::ostream &os, Symbol s);
+
+class StringPool {
+    static constexpr size_t CHUNK_BITS = 12;
+    static constexpr size_t CHUNK_SIZE = size_t{1} << CHUNK_BITS;
+    static constexpr size_t MAX_CHUNKS = size_t{1} << 14;
+    static constexpr size_t BLOCK_BYTES = 64 * 1024;
+
+    mutable std::shared_mutex mutex;
+    std::unordered_map<std::string_view, uint32_t> index;
+    // A chunk is allocated before any id in it is handed out and never
+    // moves, so resolve() can read it without the lock.
+    std::unique_ptr<std::unique_ptr<std::string_view[]>[]> chunks;
+    std::vector<std::unique_ptr<char[]>> blocks;
+    char *blockPos = nullptr;
+    size_t blockLeft = 0;
+    uint32_t count = 0;
+    size_t textBytes = 0;
+
+    std::string_view store(std::string_view s);
+
+public:
+    StringPool();
+    StringPool(const StringPool &) = delete;
+    StringPool &operator=(const StringPool &) = delete;
+
+    // Symbol for s, adding it on first use.
+    Symbol intern(std::string_view s);
+    // Symbol for s if it has been interned; never adds.
+    std::optional<Symbol> find(std::string_view s) const;
+    std::string_view resolve(Symbol sym) const;
+
+    size_t size() const;
+    // Interned text plus table overhead, in bytes.
+    size_t memoryBytes() const;
+
+    static StringPool &global();
+};
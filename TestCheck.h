@@ -0,0 +1,65 @@
+#pragma once
+#include "LibraryStorage.h"
+#include <iostream>
+#include <sstream>
+#include <string>
+
+/*
+ * File: TestCheck.h
+ * -----------------
+ * The few lines every test program shares (see the tests in
+ * CMakeLists.txt). A test is a plain main() that runs its cases,
+ * records each failed CHECK with its file and line, and returns
+ * testSummary(...), which is nonzero once any CHECK has failed, so ctest
+ * sees the failure. dumpStorage turns a storage into text, so two that
+ * should hold the same things compare with ==.
+ *
+ * Data Table (identifier | datatype | use)
+ * ----------------------------------------------------------------------
+ * testFailures | int   | CHECKs that failed so far in this program
+ * CHECK        | macro | Record a failure (and carry on) unless cond holds
+ * dumpStorage  | func  | Text of a storage's shelves, items, loans and holds
+ *
+ */
+
+inline int testFailures = 0;
+
+#define CHECK(cond)                                                                    \
+    do {                                                                               \
+        if (!(cond)) {                                                                 \
+            std::cerr << __FILE__ << ":" << __LINE__ << ": CHECK failed: " #cond "\n";  \
+            ++testFailures;                                                            \
+        }                                                                              \
+    } while (0)
+
+// Everything a snapshot or a journal replay must reproduce, in a stable
+// order: shelves and their capacities, items, loans and holds.
+inline std::string dumpStorage(const LibraryStorage &lib) {
+    std::ostringstream os;
+    os << "shelves " << lib.numShelves() << ":";
+    for (size_t s = 0; s < lib.numShelves(); ++s) os << " " << lib[s].capacity();
+    os << "\n";
+    for (const ItemLocation &loc : lib.items()) {
+        os << "item " << loc.shelf << " " << loc.comp << " " << *loc.item << "\n";
+    }
+    for (const ItemLocation &loc : lib.loans()) {
+        os << "loan " << loc.shelf << " " << loc.comp << " " << loc.person << " "
+           << loc.dueDate << " " << *loc.item << "\n";
+    }
+    for (const HoldInfo &hold : lib.holds()) {
+        os << "hold " << hold.shelf << " " << hold.comp << " " << hold.person << " "
+           << hold.position << "\n";
+    }
+    return os.str();
+}
+
+// Report the run and return the exit status for main: "All <what> tests
+// passed." or the number of failed CHECKs.
+inline int testSummary(const char *what) {
+    if (testFailures) {
+        std::cerr << testFailures << " check(s) failed.\n";
+        return 1;
+    }
+    std::cout << "All " << what << " tests passed.\n";
+    return 0;
+}
@@ -0,0 +1,82 @@
+#include "ThreadPool.h"
+
+using namespace std;
+
+/*
+ * File: ThreadPool.cpp
+ * --------------------
+ * Implements the worker pool declared in ThreadPool.h. Tasks are claimed
+ * with one fetch_add each, so a job with many small tasks balances itself
+ * across threads that run at different speeds.
+ */
+
+ThreadPool::ThreadPool(size_t threads) {
+    if (threads == 0) threads = thread::hardware_concurrency();
+    if (threads == 0) threads = 1;
+    workers.reserve(threads - 1);
+    for (size_t w = 1; w < threads; ++w) {
+        workers.emplace_back([this, w] { workerLoop(w); });
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        lock_guard lock(mutex);
+        stopping = true;
+    }
+    wake.notify_all();
+    for (thread &t : workers) t.join();
+}
+
+size_t ThreadPool::size() const { return workers.size() + 1; }
+
+void ThreadPool::drain(const Task &fn, size_t count, size_t worker) {
+    for (size_t t = next.fetch_add(1, memory_order_relaxed); t < count;
+         t = next.fetch_add(1, memory_order_relaxed)) {
+        fn(t, worker);
+    }
+}
+
+void ThreadPool::run(size_t count, const Task &fn) {
+    if (count == 0) return;
+    if (workers.empty() || count == 1) {
+        for (size_t t = 0; t < count; ++t) fn(t, 0);
+        return;
+    }
+    {
+        lock_guard lock(mutex);
+        job = &fn;
+        tasks = count;
+        next.store(0, memory_order_relaxed);
+        active = workers.size();
+        ++generation;
+    }
+    wake.notify_all();
+    drain(fn, count, 0);
+
+    // Every worker must leave the job before fn goes out of scope.
+    unique_lock lock(mutex);
+    idle.wait(lock, [this] { return active == 0; });
+    job = nullptr;
+}
+
+void ThreadPool::workerLoop(size_t worker) {
+    uint64_t seen = 0;
+    while (true) {
+        const Task *fn;
+        size_t count;
+        {
+            unique_lock lock(mutex);
+            wake.wait(lock, [&] { return stopping || generation != seen; });
+            if (stopping) return;
+            seen = generation;
+            fn = job;
+            count = tasks;
+        }
+        drain(*fn, count, worker);
+        {
+            lock_guard lock(mutex);
+            if (--active == 0) idle.notify_one();
+        }
+    }
+}
@@ -0,0 +1,71 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/*
+ * File: ThreadPool.h
+ * ------------------
+ * Fixed set of worker threads for data-parallel jobs. A job is a number
+ * of independent tasks; run() hands them out one at a time from a shared
+ * counter to the workers and to the calling thread, and returns once all
+ * of them have finished. Each call of the task function is told which
+ * worker runs it, so callers can keep one accumulator per worker and
+ * merge them afterwards without any locking.
+ *
+ * One job runs at a time; run() is not reentrant and must be called from
+ * one thread at a time. Task functions must not throw.
+ *
+ * Data Table (identifier | datatype | use)
+ * ----------------------------------------------------------------------
+ * workers    | std::vector<std::thread>       | Background threads (size() - 1 of them)
+ * mutex      | std::mutex                     | Guards job, generation, active
+ * wake       | std::condition_variable        | Signals a new job or shutdown
+ * idle       | std::condition_variable        | Signals the last worker leaving a job
+ * job        | const function<void(...)>*     | Task function of the current job
+ * tasks      | size_t                         | Number of tasks in the current job
+ * next       | std::atomic<size_t>            | Next task to hand out
+ * generation | uint64_t                       | Bumped for every job, so workers run each once
+ * active     | size_t                         | Background workers still in the current job
+ * stopping   | bool                           | Set by the destructor
+ *
+ */
+
+class ThreadPool {
+public:
+    using Task = std::function<void(size_t task, size_t worker)>;
+
+    // threads counts the calling thread; 0 means hardware_concurrency().
+    explicit ThreadPool(size_t threads = 0);
+    ~ThreadPool();
+    ThreadPool(const ThreadPool &) = delete;
+    ThreadPool &operator=(const ThreadPool &) = delete;
+
+    // Workers, including the thread that calls run(). Worker ids passed
+    // to tasks are 0 .. size() - 1; the calling thread is worker 0.
+    size_t size() const;
+
+    // Call fn(task, worker) once for every task in [0, tasks) and wait
+    // for all of them.
+    void run(size_t tasks, const Task &fn);
+
+private:
+    std::vector<std::thread> workers;
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::condition_variable idle;
+    const Task *job = nullptr;
+    size_t tasks = 0;
+    std::atomic<size_t> next{0};
+    uint64_t generation = 0;
+    size_t active = 0;
+    bool stopping = false;
+
+    void workerLoop(size_t worker);
+    void drain(const Task &fn, size_t count, size_t worker);
+};
@@ -2,8 +2,27 @@
 #include <string>
 #include <memory>
 #include <vector>
+#include <optional>
+#include <algorithm>
 #include "LibraryStorage.h"
 #include "Item.h"
+#include "CatalogLoader.h"
+#include "Snapshot.h"
+#include "Journal.h"
+#include "DueDate.h"
+#include "CommandProcessor.h"
+#include "ReportWriter.h"
+#include "InventoryAudit.h"
+#include "ThreadPool.h"
+#include "StorageStats.h"
+#include "LibraryServer.h"
+#include <chrono>
+#include <cerrno>
+#include <csignal>
+#include <filesystem>
+#include <fstream>
+#include <cstdlib>
+#include <sys/resource.h>
 
 using namespace std;
 
@@ -68,23 +87,50 @@ string readLine(const string &prompt) {
     return line;
 }
 
-size_t getMaxCompartment(const LibraryStorage &lib) {
-    return lib[0].capacity();
+// Parse a whole command-line argument as a non-negative count.
+bool parseCount(const char *text, size_t &value) {
+    char *end = nullptr;
+    errno = 0;
+    unsigned long long n = strtoull(text, &end, 10);
+    if (end == text || *end != '\0' || errno == ERANGE || text[0] == '-') return false;
+    value = static_cast<size_t>(n);
+    return true;
+}
+
+size_t getMaxCompartment(const LibraryStorage &lib, int shelf) {
+    return lib[static_cast<size_t>(shelf)].capacity();
 }
 
 // ===== Menu actions =====
 
 void addItemMenu(LibraryStorage &lib) {
     cout << "\n=== Add Item ===\n";
+    ItemArena::Scope scope(lib.itemArena());
 
     int maxShelfIndex = static_cast<int>(lib.numShelves()) - 1;
-    int shelf = readInt("Shelf index (0-" + to_string(maxShelfIndex) + "): ",
-                        0, maxShelfIndex);
-
-    size_t maxComp = getMaxCompartment(lib);
-    int maxCompIndex = static_cast<int>(maxComp) - 1;
-    int compartment = readInt("Compartment index (0-" + to_string(maxCompIndex) + "): ",
+    int shelf = readInt("Shelf index (0-" + to_string(maxShelfIndex)
+                            + ", -1 = first free compartment): ",
+                        -1, maxShelfIndex);
+
+    int compartment = 0;
+    if (shelf >= 0) {
+        size_t maxComp = getMaxCompartment(lib, shelf);
+        int maxCompIndex = static_cast<int>(maxComp) - 1;
+        compartment = readInt("Compartment index (0-" + to_string(maxCompIndex) + "): ",
                               0, maxCompIndex);
+    }
+
+    // Stores the item at the chosen location, or anywhere for shelf -1.
+    auto store = [&](unique_ptr<Item> item) -> Result<void> {
+        if (shelf >= 0) {
+            return lib.addItem(move(item), static_cast<size_t>(shelf),
+                               static_cast<size_t>(compartment));
+        }
+        Result<ShelfSlot> slot = lib.addItemAnywhere(move(item));
+        if (!slot) return slot.error();
+        cout << "Placed on shelf " << slot->shelf << ", compartment " << slot->comp << ".\n";
+        return {};
+    };
 
     cout << "Item type:\n";
     cout << "  1. Book\n";
@@ -96,7 +142,7 @@ void addItemMenu(LibraryStorage &lib) {
     string name = readLine("Name: ");
     string description = readLine("Description: ");
 
-    bool ok = false;
+    Result<void> added;
 
     if (type == 1) {
         // Book
@@ -104,9 +150,7 @@ void addItemMenu(LibraryStorage &lib) {
         string author = readLine("Author: ");
         string copyright = readLine("Copyright date (e.g. 2013): ");
         auto book = make_unique<Book>(name, description, id, title, author, copyright);
-        ok = lib.addItem(move(book),
-                         static_cast<size_t>(shelf),
-                         static_cast<size_t>(compartment));
+        added = store(move(book));
     } else if (type == 2) {
         // Movie
         string title = readLine("Movie title: ");
@@ -121,23 +165,19 @@ void addItemMenu(LibraryStorage &lib) {
         }
 
         auto movie = make_unique<Movie>(name, description, id, title, director, actors);
-        ok = lib.addItem(move(movie),
-                         static_cast<size_t>(shelf),
-                         static_cast<size_t>(compartment));
+        added = store(move(movie));
     } else {
         // Magazine
         string edition = readLine("Edition (e.g. \"Vol 10\"): ");
         string mainArticle = readLine("Main article title: ");
         auto mag = make_unique<Magazine>(name, description, id, edition, mainArticle);
-        ok = lib.addItem(move(mag),
-                         static_cast<size_t>(shelf),
-                         static_cast<size_t>(compartment));
+        added = store(move(mag));
     }
 
-    if (ok) {
+    if (added) {
         cout << "Item added successfully.\n";
     } else {
-        cout << "Failed to add item (see error above).\n";
+        cout << "Failed to add item: " << storageErrorName(added.error()) << ".\n";
     }
 }
 
@@ -148,16 +188,16 @@ void removeItemMenu(LibraryStorage &lib) {
     int shelf = readInt("Shelf index (0-" + to_string(maxShelfIndex) + "): ",
                         0, maxShelfIndex);
 
-    size_t maxComp = getMaxCompartment(lib);
+    size_t maxComp = getMaxCompartment(lib, shelf);
     int maxCompIndex = static_cast<int>(maxComp) - 1;
     int compartment = readInt("Compartment index (0-" + to_string(maxCompIndex) + "): ",
                               0, maxCompIndex);
 
-    if (lib.removeItem(static_cast<size_t>(shelf),
-                       static_cast<size_t>(compartment))) {
+    if (Result<void> done = lib.removeItem(static_cast<size_t>(shelf),
+                                           static_cast<size_t>(compartment))) {
         cout << "Item removed successfully.\n";
     } else {
-        cout << "Failed to remove item.\n";
+        cout << "Failed to remove item: " << storageErrorName(done.error()) << ".\n";
     }
 }
 
@@ -168,7 +208,7 @@ void checkoutMenu(LibraryStorage &lib) {
     int shelf = readInt("Shelf index (0-" + to_string(maxShelfIndex) + "): ",
                         0, maxShelfIndex);
 
-    size_t maxComp = getMaxCompartment(lib);
+    size_t maxComp = getMaxCompartment(lib, shelf);
     int maxCompIndex = static_cast<int>(maxComp) - 1;
     int compartment = readInt("Compartment index (0-" + to_string(maxCompIndex) + "): ",
                               0, maxCompIndex);
@@ -176,12 +216,12 @@ void checkoutMenu(LibraryStorage &lib) {
     string person = readLine("Person name: ");
     string due = readLine("Due date (YYYY-MM-DD): ");
 
-    if (lib.checkoutItem(static_cast<size_t>(shelf),
-                         static_cast<size_t>(compartment),
-                         person, due)) {
+    if (Result<void> done = lib.checkoutItem(static_cast<size_t>(shelf),
+                                             static_cast<size_t>(compartment),
+                                             person, due)) {
         cout << "Checkout succeeded.\n";
     } else {
-        cout << "Checkout failed.\n";
+        cout << "Checkout failed: " << storageErrorName(done.error()) << ".\n";
     }
 }
 
@@ -192,16 +232,58 @@ void checkinMenu(LibraryStorage &lib) {
     int shelf = readInt("Shelf index (0-" + to_string(maxShelfIndex) + "): ",
                         0, maxShelfIndex);
 
-    size_t maxComp = getMaxCompartment(lib);
+    size_t maxComp = getMaxCompartment(lib, shelf);
     int maxCompIndex = static_cast<int>(maxComp) - 1;
     int compartment = readInt("Compartment index (0-" + to_string(maxCompIndex) + "): ",
                               0, maxCompIndex);
 
-    if (lib.checkinItem(static_cast<size_t>(shelf),
-                        static_cast<size_t>(compartment))) {
+    if (Result<void> done = lib.checkinItem(static_cast<size_t>(shelf),
+                                            static_cast<size_t>(compartment))) {
         cout << "Checkin succeeded.\n";
+        if (optional<string_view> holder = lib.pickupFor(static_cast<size_t>(shelf),
+                                                         static_cast<size_t>(compartment))) {
+            cout << "Set aside for " << *holder << ", who placed a hold.\n";
+        }
     } else {
-        cout << "Checkin failed.\n";
+        cout << "Checkin failed: " << storageErrorName(done.error()) << ".\n";
+    }
+}
+
+void holdMenu(LibraryStorage &lib) {
+    cout << "\n=== Holds ===\n";
+
+    for (const ItemLocation &loc : lib.awaitingPickup()) {
+        cout << "  Waiting for " << loc.person << " at shelf " << loc.shelf
+             << ", compartment " << loc.comp << ": " << *loc.item << "\n";
+    }
+    cout << "1. Place a hold\n";
+    cout << "2. Cancel a hold\n";
+    cout << "0. Back\n";
+    int action = readInt("Select an option: ", 0, 2);
+    if (action == 0) return;
+
+    int maxShelfIndex = static_cast<int>(lib.numShelves()) - 1;
+    int shelf = readInt("Shelf index (0-" + to_string(maxShelfIndex) + "): ",
+                        0, maxShelfIndex);
+    int maxCompIndex = static_cast<int>(getMaxCompartment(lib, shelf)) - 1;
+    int compartment = readInt("Compartment index (0-" + to_string(maxCompIndex) + "): ",
+                              0, maxCompIndex);
+    string person = readLine("Person name: ");
+
+    size_t s = static_cast<size_t>(shelf), c = static_cast<size_t>(compartment);
+    if (action == 1) {
+        if (Result<size_t> position = lib.placeHold(s, c, person)) {
+            cout << "Hold placed; " << person << " is number " << *position << " in line.\n";
+        } else {
+            cout << "Hold failed: " << storageErrorName(position.error()) << ".\n";
+        }
+    } else if (Result<void> done = lib.cancelHold(s, c, person)) {
+        cout << "Hold cancelled.\n";
+        if (optional<string_view> holder = lib.pickupFor(s, c)) {
+            cout << "The item is now set aside for " << *holder << ".\n";
+        }
+    } else {
+        cout << "Cancel failed: " << storageErrorName(done.error()) << ".\n";
     }
 }
 
@@ -209,26 +291,26 @@ void swapMenu(LibraryStorage &lib) {
     cout << "\n=== Swap Items ===\n";
 
     int maxShelfIndex = static_cast<int>(lib.numShelves()) - 1;
-    size_t maxComp = getMaxCompartment(lib);
-    int maxCompIndex = static_cast<int>(maxComp) - 1;
 
     cout << "First location:\n";
     int s1 = readInt("  Shelf index (0-" + to_string(maxShelfIndex) + "): ",
                      0, maxShelfIndex);
+    int maxCompIndex = static_cast<int>(getMaxCompartment(lib, s1)) - 1;
     int c1 = readInt("  Compartment index (0-" + to_string(maxCompIndex) + "): ",
                      0, maxCompIndex);
 
     cout << "Second location:\n";
     int s2 = readInt("  Shelf index (0-" + to_string(maxShelfIndex) + "): ",
                      0, maxShelfIndex);
+    maxCompIndex = static_cast<int>(getMaxCompartment(lib, s2)) - 1;
     int c2 = readInt("  Compartment index (0-" + to_string(maxCompIndex) + "): ",
                      0, maxCompIndex);
 
-    if (lib.swapItems(static_cast<size_t>(s1), static_cast<size_t>(c1),
-                      static_cast<size_t>(s2), static_cast<size_t>(c2))) {
+    if (Result<void> done = lib.swapItems(static_cast<size_t>(s1), static_cast<size_t>(c1),
+                                          static_cast<size_t>(s2), static_cast<size_t>(c2))) {
         cout << "Swap succeeded.\n";
     } else {
-        cout << "Swap failed.\n";
+        cout << "Swap failed: " << storageErrorName(done.error()) << ".\n";
     }
 }
 
@@ -242,6 +324,149 @@ void showCheckedOut(const LibraryStorage &lib) {
     lib.printCheckedOutItems();
 }
 
+void findMenu(const LibraryStorage &lib) {
+    cout << "\n=== Find Item by ID ===\n";
+
+    int id = readInt("Item id (integer): ", 0, 1000000);
+    optional<ItemLocation> loc = lib.findById(id);
+    if (!loc) {
+        cout << "No item with id " << id << " in storage or checked out.\n";
+        return;
+    }
+
+    cout << *loc->item << "\n";
+    if (loc->checkedOut) {
+        cout << "Checked out from shelf " << loc->shelf << ", compartment " << loc->comp
+             << " by " << loc->person << " (due: " << loc->dueDate << ")\n";
+    } else {
+        cout << "On shelf " << loc->shelf << ", compartment " << loc->comp << "\n";
+    }
+}
+
+void searchMenu(const LibraryStorage &lib) {
+    cout << "\n=== Search ===\n";
+
+    string query = readLine("Words to search for: ");
+    auto start = chrono::steady_clock::now();
+    vector<SearchResult> results = lib.search(query, 10);
+    double us = chrono::duration<double, micro>(chrono::steady_clock::now() - start).count();
+
+    if (results.empty()) {
+        cout << "No items match \"" << query << "\".\n";
+        return;
+    }
+    cout << "Top " << results.size() << " matches (" << us << " us):\n";
+    for (const SearchResult &r : results) {
+        const ItemLocation &loc = r.location;
+        cout << "  " << *loc.item << "\n    ";
+        if (loc.checkedOut) {
+            cout << "checked out from shelf " << loc.shelf << ", compartment " << loc.comp;
+        } else {
+            cout << "shelf " << loc.shelf << ", compartment " << loc.comp;
+        }
+        cout << "\n";
+    }
+}
+
+void overdueMenu(const LibraryStorage &lib) {
+    cout << "\n=== Overdue Loans ===\n";
+
+    int32_t day = todayDueDay();
+    string asOf = readLine("As of date (YYYY-MM-DD, blank for today): ");
+    if (!asOf.empty()) {
+        optional<int32_t> parsed = parseDueDay(asOf);
+        if (!parsed) {
+            cout << "Not a date: " << asOf << "\n";
+            return;
+        }
+        day = *parsed;
+    }
+
+    vector<ItemLocation> overdue = lib.overdueLoans(day);
+    cout << overdue.size() << " loans overdue as of " << formatDueDay(day) << ":\n";
+    for (const ItemLocation &loc : overdue) {
+        cout << "  due " << loc.dueDate << ", " << loc.person << ": " << *loc.item
+             << " (shelf " << loc.shelf << ", compartment " << loc.comp << ")\n";
+    }
+}
+
+void patronMenu(const LibraryStorage &lib) {
+    cout << "\n=== Patron Loans ===\n";
+
+    string person = readLine("Person name: ");
+    vector<ItemLocation> loans = lib.loansOf(person);
+    cout << person << " has " << loans.size() << " items checked out";
+    if (lib.getLoanLimit() != SIZE_MAX) cout << " (limit " << lib.getLoanLimit() << ")";
+    cout << ":\n";
+    for (const ItemLocation &loc : loans) {
+        cout << "  " << *loc.item << "\n    from shelf " << loc.shelf << ", compartment "
+             << loc.comp << " (due: " << loc.dueDate << ")\n";
+    }
+}
+
+void addShelfMenu(LibraryStorage &lib) {
+    cout << "\n=== Add Shelf ===\n";
+
+    int maxCap = static_cast<int>(Shelf::MAX_CAPACITY);
+    int capacity = readInt("Compartments on the new shelf (1-" + to_string(maxCap) + "): ",
+                           1, maxCap);
+    // readInt keeps capacity in range, so this cannot be refused.
+    size_t idx = *lib.addShelf(static_cast<size_t>(capacity));
+    cout << "Added shelf " << idx << " with " << capacity << " compartments.\n";
+}
+
+void occupancyMenu(const LibraryStorage &lib) {
+    cout << "\n=== Occupancy ===\n";
+
+    OccupancyStats stats = lib.occupancyStats();
+    cout << "Shelves: " << stats.shelves << " (" << stats.fullShelves << " full, "
+         << stats.emptyShelves << " empty)\n";
+    cout << "Compartments in use: " << stats.used << " of " << stats.compartments << " ("
+         << static_cast<int>(stats.fillRatio() * 100.0 + 0.5) << "%)\n";
+}
+
+void auditMenu(const LibraryStorage &lib) {
+    cout << "\n=== Inventory audit ===\n";
+
+    ThreadPool pool;
+    InventoryAudit audit = auditInventory(lib, pool);
+    cout << "Items: " << audit.items << " (" << audit.storedItems << " stored, " << audit.loans
+         << " checked out)\n";
+    cout << "  Books: " << audit.itemsPerType[static_cast<size_t>(ItemType::Book)]
+         << ", movies: " << audit.itemsPerType[static_cast<size_t>(ItemType::Movie)]
+         << ", magazines: " << audit.itemsPerType[static_cast<size_t>(ItemType::Magazine)] << "\n";
+
+    size_t shown = min<size_t>(audit.itemsPerAuthor.size(), 5);
+    if (shown > 0) cout << "Authors with the most books:\n";
+    for (size_t i = 0; i < shown; ++i) {
+        cout << "  " << audit.itemsPerAuthor[i].first << ": " << audit.itemsPerAuthor[i].second
+             << "\n";
+    }
+
+    if (!audit.loansPerDueMonth.empty() || audit.undatedLoans > 0) cout << "Loans by due month:\n";
+    for (const auto &[month, count] : audit.loansPerDueMonth) {
+        cout << "  " << formatDueMonth(month) << ": " << count << "\n";
+    }
+    if (audit.undatedLoans > 0) cout << "  (no date): " << audit.undatedLoans << "\n";
+
+    if (audit.duplicateIds.empty()) {
+        cout << "No duplicate item ids.\n";
+    } else {
+        cout << audit.duplicateIds.size() << " ids are used by more than one item:";
+        for (size_t i = 0; i < min<size_t>(audit.duplicateIds.size(), 20); ++i) {
+            cout << " " << audit.duplicateIds[i];
+        }
+        cout << (audit.duplicateIds.size() > 20 ? " ...\n" : "\n");
+    }
+}
+
+void operationStatsMenu() {
+    cout << "\n=== Operation statistics ===\n";
+    StorageStatsSnapshot stats = collectStorageStats();
+    if (stats.enabled) cout << "Threads: " << stats.threads << "\n";
+    writeStorageStats(cout, stats);
+}
+
 // ===== original scripted demo moved into a function =====
 
 void runDemo() {
@@ -252,16 +477,16 @@ void runDemo() {
 
     // Add some items
     cout << "Adding items...\n";
-    lib.addItem(make_unique<Book>("The C++ Guide", "Comprehensive guide to C++", 1,
-                                  "C++ Guide", "Bjarne Stroustrup", "2013"),
-                2, 4);
-    lib.addItem(make_unique<Movie>("A Great Movie", "An epic tale", 2,
-                                   "A Great Movie", "Director X",
-                                   vector<string>{"Actor A","Actor B"}),
-                0, 0);
-    lib.addItem(make_unique<Magazine>("Tech Monthly", "Latest in tech", 3,
-                                      "Vol 10", "The Future of AI"),
-                1, 14);
+    (void)lib.addItem(make_unique<Book>("The C++ Guide", "Comprehensive guide to C++", 1,
+                                        "C++ Guide", "Bjarne Stroustrup", "2013"),
+                      2, 4);
+    (void)lib.addItem(make_unique<Movie>("A Great Movie", "An epic tale", 2,
+                                         "A Great Movie", "Director X",
+                                         vector<string>{"Actor A","Actor B"}),
+                      0, 0);
+    (void)lib.addItem(make_unique<Magazine>("Tech Monthly", "Latest in tech", 3,
+                                            "Vol 10", "The Future of AI"),
+                      1, 14);
 
     try {
         cout << "Accessing via operator[]: libraryInventory[2][4] -> ";
@@ -277,10 +502,12 @@ void runDemo() {
     cout << "\n";
 
     cout << "Checking out item at (2,4) by Alice, due 2025-12-01...\n";
-    lib.checkoutItem(2, 4, "Alice", "2025-12-01");
+    (void)lib.checkoutItem(2, 4, "Alice", "2025-12-01");
 
     cout << "Attempting to checkout empty slot (0,1)...\n";
-    lib.checkoutItem(0, 1, "Bob", "2025-11-30");
+    if (Result<void> done = lib.checkoutItem(0, 1, "Bob", "2025-11-30"); !done) {
+        cout << "Checkout failed as expected: " << storageErrorName(done.error()) << ".\n";
+    }
 
     cout << "\nAfter checkout:\n";
     lib.printItemsInStorage();
@@ -319,12 +546,247 @@ void runDemo() {
     cout << "\nDemo complete.\n\n";
 }
 
+// ===== Startup modes =====
+
+void loadAtStartup(LibraryStorage &lib, const string &path, size_t maxShelves) {
+    cout << "Loading catalog from " << path << "...\n";
+    LoadResult result = loadCatalogFile(path, lib, 65536, maxShelves);
+
+    cout << "Loaded " << result.rowsLoaded << " of " << result.rowsRead << " rows in "
+         << result.seconds << " s (" << static_cast<long long>(result.rowsPerSecond())
+         << " rows/sec).\n";
+
+    const size_t maxShown = 10;
+    for (size_t i = 0; i < result.errors.size() && i < maxShown; ++i) {
+        cout << "  line " << result.errors[i].row << ": " << result.errors[i].message
+             << "\n";
+    }
+    if (result.errors.size() > maxShown) {
+        cout << "  ... " << result.errors.size() - maxShown << " more errors\n";
+    }
+
+    struct rusage usage {};
+    getrusage(RUSAGE_SELF, &usage);
+    cout << "Peak RSS: " << usage.ru_maxrss / 1024 << " MiB";
+    if (const ItemArena *arena = lib.itemArena()) {
+        cout << "; item arena: " << arena->upstreamAllocations() << " chunk allocations, "
+             << arena->upstreamBytes() / (1024 * 1024) << " MiB held";
+    }
+    const StringPool &pool = StringPool::global();
+    cout << "\nInterned names: " << pool.size() << " distinct, "
+         << pool.memoryBytes() / 1024 << " KiB\n\n";
+}
+
+// Execute the commands in path ("-" for stdin); see CommandProcessor.h.
+void runBatch(LibraryStorage &lib, Journal &journal, const string &path) {
+    ifstream file;
+    if (path != "-") {
+        file.open(path);
+        if (!file) {
+            cerr << "Error: Could not open command file \"" << path << "\".\n";
+            return;
+        }
+    }
+    CommandProcessor processor(lib, &journal);
+    BatchResult result = processor.run(path == "-" ? cin : file, cout);
+    cerr << "Executed " << result.commands << " commands (" << result.failed << " failed) in "
+         << result.seconds << " s (" << static_cast<long long>(result.commandsPerSecond())
+         << " commands/sec).\n";
+    if (result.unsynced) {
+        cerr << "The journal could not be synced: the last batch went unanswered and the"
+                " commands after it were not run.\n";
+    }
+}
+
+LibraryServer *activeServer = nullptr;
+
+void stopServer(int) {
+    if (activeServer) activeServer->stop();
+}
+
+// Serve the storage on address until SIGINT or SIGTERM; see LibraryServer.h.
+void runServer(LibraryStorage &lib, Journal &journal, const string &address) {
+    LibraryServer server(lib, &journal);
+    if (!server.listen(address)) return;
+    activeServer = &server;
+    signal(SIGINT, stopServer);
+    signal(SIGTERM, stopServer);
+    cerr << "Listening on " << address << " (Ctrl-C to stop).\n";
+    ServerStats stats = server.run();
+    signal(SIGINT, SIG_DFL);
+    signal(SIGTERM, SIG_DFL);
+    activeServer = nullptr;
+    cerr << "Served " << stats.connections << " connections: " << stats.commands
+         << " commands (" << stats.failed << " failed) in " << stats.batches << " batches, "
+         << stats.seconds << " s (" << static_cast<long long>(stats.commandsPerSecond())
+         << " commands/sec).\n";
+    if (stats.unacknowledged) {
+        cerr << stats.unacknowledged
+             << " connection(s) were closed unanswered because the journal could not be"
+                " synced.\n";
+    }
+}
+
+// Write both listings to path, formatted by its extension (.json, .csv,
+// anything else as text).
+bool writeReport(const LibraryStorage &lib, const string &path) {
+    ofstream file(path, ios::binary);
+    if (!file) {
+        cerr << "Error: Could not create report \"" << path << "\".\n";
+        return false;
+    }
+    auto start = chrono::steady_clock::now();
+    ReportWriter out(file, reportFormatFor(path));
+    lib.writeItemsInStorage(out);
+    lib.writeCheckedOutItems(out);
+    out.finish();
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    double mib = static_cast<double>(out.bytesWritten()) / (1024 * 1024);
+    cout << "Wrote " << mib << " MiB to " << path << " in " << seconds << " s ("
+         << (seconds > 0 ? mib / seconds : 0.0) << " MiB/s).\n";
+    return static_cast<bool>(file);
+}
+
+// Sets journalSeq to the last journal sequence number the snapshot covers.
+// Only a missing snapshot means starting empty: one that is there but does
+// not load returns false, so it is neither replayed over nor replaced.
+bool openSnapshot(LibraryStorage &lib, const string &path, uint64_t &journalSeq) {
+    error_code ec;
+    if (!filesystem::exists(path, ec) && !ec) {
+        cout << "No snapshot at " << path << " yet; starting empty.\n\n";
+        return true;
+    }
+    auto start = chrono::steady_clock::now();
+    if (!loadSnapshot(path, lib, &journalSeq)) return false;
+    double ms = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+    cout << "Restored snapshot " << path << " in " << ms << " ms.\n\n";
+    return true;
+}
+
+// A frame that does not apply is fatal unless skipBadFrames (then it is
+// reported and left out).
+bool openJournal(LibraryStorage &lib, Journal &journal, const string &path,
+                 uint64_t afterSeq, bool skipBadFrames) {
+    ReplayResult replay = replayJournal(path, lib, afterSeq, skipBadFrames);
+    if (!replay.ok) {
+        if (replay.failedSeq) {
+            cout << "Journal operation " << replay.failedSeq << " in " << path
+                 << " does not apply to the restored state. The journal and snapshot"
+                    " are left as they are; use --skip-bad-frames to start without it.\n";
+        }
+        return false;
+    }
+    if (replay.applied > 0) {
+        cout << "Replayed " << replay.applied << " journaled operations from " << path
+             << ".\n";
+    }
+    if (replay.skipped > 0) {
+        cout << "Skipped " << replay.skipped << " journaled operations that did not apply.\n";
+    }
+    if (replay.tornTail) {
+        cout << "Discarding incomplete journal tail after byte " << replay.validBytes
+             << ".\n";
+    }
+    if (!journal.open(path, replay.lastSeq, replay.validBytes)) return false;
+    lib.attachJournal(&journal);
+    return true;
+}
+
+void printUsage(const char *prog) {
+    cout << "Usage: " << prog
+         << " [--snapshot <file>] [--journal <file>] [--skip-bad-frames]"
+            " [--load <catalog file>]"
+            " [--max-shelves <n>] [--arena]"
+            " [--loan-limit <n>] [--batch <command file | ->]"
+            " [--serve <host:port | port | unix:path>]"
+            " [--report <file.txt | file.json | file.csv>]\n";
+}
+
 // ===== Main menu =====
 
-int main() {
+int main(int argc, char *argv[]) {
     LibraryStorage lib(3);
+    string snapshotPath;
+    string journalPath;
+    string loadPath;
+    string batchPath;
+    string serveAddress;
+    string reportPath;
+    size_t loanLimit = SIZE_MAX;
+    size_t maxShelves = DEFAULT_MAX_SHELVES;
+    bool skipBadFrames = false;
+    Journal journal;
+
+    for (int i = 1; i < argc; ++i) {
+        string arg = argv[i];
+        if (arg == "--load" && i + 1 < argc) {
+            loadPath = argv[++i];
+        } else if (arg == "--snapshot" && i + 1 < argc) {
+            snapshotPath = argv[++i];
+        } else if (arg == "--journal" && i + 1 < argc) {
+            journalPath = argv[++i];
+        } else if (arg == "--loan-limit" && i + 1 < argc && parseCount(argv[i + 1], loanLimit)) {
+            ++i;
+        } else if (arg == "--max-shelves" && i + 1 < argc && parseCount(argv[i + 1], maxShelves)) {
+            ++i;
+        } else if (arg == "--report" && i + 1 < argc) {
+            reportPath = argv[++i];
+        } else if (arg == "--batch" && i + 1 < argc) {
+            batchPath = argv[++i];
+        } else if (arg == "--serve" && i + 1 < argc) {
+            serveAddress = argv[++i];
+        } else if (arg == "--skip-bad-frames") {
+            skipBadFrames = true;
+        } else if (arg == "--arena") {
+            lib.enableArena();
+        } else {
+            printUsage(argv[0]);
+            return 1;
+        }
+    }
+
+    lib.enableSearch();
+
+    // Restore the saved state first so a catalog load adds to it.
+    uint64_t journalSeq = 0;
+    if (!snapshotPath.empty() && !openSnapshot(lib, snapshotPath, journalSeq)) {
+        cout << "Failed to restore snapshot " << snapshotPath
+             << "; it is left as it is. Fix or move it away, then start again.\n";
+        return 1;
+    }
+    if (!journalPath.empty()
+        && !openJournal(lib, journal, journalPath, journalSeq, skipBadFrames)) {
+        cout << "Failed to open journal " << journalPath << ".\n";
+        return 1;
+    }
+
+    if (!loadPath.empty()) {
+        // A bulk load is persisted as one snapshot rather than one journal
+        // frame per row.
+        lib.attachJournal(nullptr);
+        loadAtStartup(lib, loadPath, maxShelves);
+        if (journal.isOpen()) {
+            lib.attachJournal(&journal);
+            if (snapshotPath.empty()) {
+                cout << "Note: without --snapshot the loaded catalog is not persisted.\n\n";
+            } else if (!compactJournal(lib, journal, snapshotPath)) {
+                cout << "Failed to write snapshot after load.\n\n";
+            }
+        }
+    }
+
+    // Applied after restore and replay, which must reproduce loans as they
+    // were even if the limit has since been lowered.
+    lib.setLoanLimit(loanLimit);
+
+    // A report only reads the storage, so there is nothing to save after it.
+    if (!reportPath.empty()) return writeReport(lib, reportPath) ? 0 : 1;
+
+    // Batch and server mode replace the menu; the snapshot is still saved below.
+    bool running = batchPath.empty() && serveAddress.empty();
+    if (!batchPath.empty()) runBatch(lib, journal, batchPath);
+    if (!serveAddress.empty()) runServer(lib, journal, serveAddress);
 
-    bool running = true;
     while (running) {
         cout << "=============================\n";
         cout << " Library Inventory System\n";
@@ -337,9 +799,18 @@ int main() {
         cout << "6. Show items in storage\n";
         cout << "7. Show checked-out items\n";
         cout << "8. Run scripted demo\n";
+        cout << "9. Find item by id\n";
+        cout << "10. Search by words\n";
+        cout << "11. Show overdue loans\n";
+        cout << "12. Show a patron's loans\n";
+        cout << "13. Add a shelf\n";
+        cout << "14. Show occupancy\n";
+        cout << "15. Run inventory audit\n";
+        cout << "16. Show operation statistics\n";
+        cout << "17. Place or cancel a hold\n";
         cout << "0. Quit\n";
 
-        int choice = readInt("Select an option: ", 0, 8);
+        int choice = readInt("Select an option: ", 0, 17);
         cout << "\n";
 
         switch (choice) {
@@ -367,14 +838,54 @@ int main() {
             case 8:
                 runDemo();
                 break;
+            case 9:
+                findMenu(lib);
+                break;
+            case 10:
+                searchMenu(lib);
+                break;
+            case 11:
+                overdueMenu(lib);
+                break;
+            case 12:
+                patronMenu(lib);
+                break;
+            case 13:
+                addShelfMenu(lib);
+                break;
+            case 14:
+                occupancyMenu(lib);
+                break;
+            case 15:
+                auditMenu(lib);
+                break;
+            case 16:
+                operationStatsMenu();
+                break;
+            case 17:
+                holdMenu(lib);
+                break;
             case 0:
                 running = false;
                 break;
         }
 
+        // Each menu action is one operation, so commit it right away.
+        if (journal.isOpen()) journal.sync();
+
         cout << "\n";
     }
 
+    if (!snapshotPath.empty()) {
+        bool saved = journal.isOpen() ? compactJournal(lib, journal, snapshotPath)
+                                      : saveSnapshot(lib, snapshotPath);
+        if (saved) {
+            cout << "Saved snapshot to " << snapshotPath << ".\n";
+        } else {
+            cout << "Failed to save snapshot.\n";
+        }
+    }
+
     cout << "Goodbye!\n";
     return 0;
 }